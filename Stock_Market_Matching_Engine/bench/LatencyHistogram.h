@@ -0,0 +1,77 @@
+#ifndef LATENCY_HISTOGRAM_H
+#define LATENCY_HISTOGRAM_H
+
+#include <cstdint>
+#include <vector>
+#include <algorithm>
+
+// HDR-style histogram for latencies in nanoseconds.
+//
+// Values are bucketed by their highest set bit, and each power-of-two range
+// is split into SUB_BUCKETS linear slots, so the relative error of any
+// recorded value is below 1/SUB_BUCKETS (<1%) from a few ns up to ~18 min.
+// Recording is a couple of shifts and an increment; no allocation.
+class LatencyHistogram {
+private:
+    static const int SUB_BITS = 7;
+    static const int SUB_BUCKETS = 1 << SUB_BITS;   // 128
+    static const int MAX_BITS = 40;                 // 2^40 ns ~ 18 min
+
+    std::vector<uint64_t> counts;
+    uint64_t total;
+    uint64_t minValue;
+    uint64_t maxValue;
+    long double sum;
+
+    static int indexOf(uint64_t v) {
+        if (v < (uint64_t)SUB_BUCKETS) return (int)v;
+        int msb = 63 - __builtin_clzll(v);
+        int shift = msb - SUB_BITS;
+        int bucket = shift + 1;
+        int sub = (int)(v >> shift) - SUB_BUCKETS;   // 0 .. SUB_BUCKETS-1
+        return bucket * SUB_BUCKETS + sub;
+    }
+
+    // Largest value that lands in this slot
+    static uint64_t upperBound(int idx) {
+        if (idx < SUB_BUCKETS) return idx;
+        int bucket = idx / SUB_BUCKETS;
+        int sub = idx % SUB_BUCKETS;
+        int shift = bucket - 1;
+        return (((uint64_t)(sub + SUB_BUCKETS + 1)) << shift) - 1;
+    }
+
+public:
+    LatencyHistogram()
+        : counts((MAX_BITS - SUB_BITS + 2) * SUB_BUCKETS, 0),
+          total(0), minValue(UINT64_MAX), maxValue(0), sum(0) {}
+
+    void record(uint64_t ns) {
+        uint64_t clamped = std::min<uint64_t>(ns, (1ull << MAX_BITS) - 1);
+        counts[indexOf(clamped)]++;
+        total++;
+        sum += ns;
+        if (ns < minValue) minValue = ns;
+        if (ns > maxValue) maxValue = ns;
+    }
+
+    // q in [0, 100]
+    uint64_t percentile(double q) const {
+        if (total == 0) return 0;
+        uint64_t rank = (uint64_t)((q / 100.0) * total + 0.5);
+        if (rank < 1) rank = 1;
+        uint64_t seen = 0;
+        for (size_t i = 0; i < counts.size(); i++) {
+            seen += counts[i];
+            if (seen >= rank) return std::min(upperBound((int)i), maxValue);
+        }
+        return maxValue;
+    }
+
+    uint64_t count() const { return total; }
+    uint64_t min() const { return total ? minValue : 0; }
+    uint64_t max() const { return maxValue; }
+    double mean() const { return total ? (double)(sum / total) : 0.0; }
+};
+
+#endif
@@ -0,0 +1,304 @@
+#include <iostream>
+#include <iomanip>
+#include <string>
+#include <vector>
+#include <random>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <cmath>
+#include <filesystem>
+#include <atomic>
+#include <new>
+#include <unistd.h>
+#include "../engine/OrderBook.h"
+#include "../storage/OrderStorage.h"
+#include "../core/Log.h"
+#include "LatencyHistogram.h"
+
+using namespace std;
+
+/* ============== ORDER BOOK LATENCY BENCHMARK ==============
+   Builds one OrderBook over an OrderStorage in a temp dir and
+   replays a synthetic flow of passive orders, aggressive orders
+   and cancels, timing every addOrder / cancelOrder call.
+   ========================================================== */
+
+// Every operator new in the process goes through here, so the steady
+// state check below sees real heap traffic (any thread), not just slabs
+static atomic<size_t> heapAllocations{0};
+
+void* operator new(size_t size) {
+    heapAllocations.fetch_add(1, memory_order_relaxed);
+    if (void* p = malloc(size ? size : 1)) return p;
+    throw bad_alloc();
+}
+
+void operator delete(void* p) noexcept { free(p); }
+void operator delete(void* p, size_t) noexcept { free(p); }
+
+struct BenchConfig {
+    int orders = 200000;          // operations after warm-up
+    int warmup = 20000;
+    int depth = 50;               // price levels each side of mid
+    double cancelRatio = 0.30;    // share of operations that are cancels
+    double aggressorRatio = 0.10; // share of new orders that cross the spread
+    string dist = "uniform";      // uniform | normal | exp  (distance from mid)
+    int maxQty = 100;
+    double mid = 100.0;
+    double tick = 0.01;
+    bool resident = true;
+    string index = "ladder";      // ladder | btree
+    unsigned seed = 42;
+};
+
+static void usage() {
+    cout << "\nUsage:\n";
+    cout << "  ./bench_orderbook [--orders N] [--warmup N] [--depth D]\n";
+    cout << "                    [--cancel-ratio R] [--aggressor-ratio R]\n";
+    cout << "                    [--dist uniform|normal|exp] [--max-qty Q]\n";
+    cout << "                    [--mid PRICE] [--tick SIZE] [--index ladder|btree]\n";
+    cout << "                    [--non-resident] [--seed S]\n";
+}
+
+static bool parseArgs(int argc, char* argv[], BenchConfig& cfg) {
+    for (int i = 1; i < argc; i++) {
+        string a = argv[i];
+        auto next = [&]() -> const char* {
+            if (i + 1 >= argc) { cout << "Missing value for " << a << "\n"; exit(1); }
+            return argv[++i];
+        };
+
+        if (a == "--orders") cfg.orders = atoi(next());
+        else if (a == "--warmup") cfg.warmup = atoi(next());
+        else if (a == "--depth") cfg.depth = atoi(next());
+        else if (a == "--cancel-ratio") cfg.cancelRatio = atof(next());
+        else if (a == "--aggressor-ratio") cfg.aggressorRatio = atof(next());
+        else if (a == "--dist") cfg.dist = next();
+        else if (a == "--max-qty") cfg.maxQty = atoi(next());
+        else if (a == "--mid") cfg.mid = atof(next());
+        else if (a == "--tick") cfg.tick = atof(next());
+        else if (a == "--index") cfg.index = next();
+        else if (a == "--non-resident") cfg.resident = false;
+        else if (a == "--seed") cfg.seed = (unsigned)atoi(next());
+        else { usage(); return false; }
+    }
+    if (cfg.depth < 1 || cfg.maxQty < 1 || cfg.orders < 1) {
+        usage();
+        return false;
+    }
+    return true;
+}
+
+// Synthetic order flow; keeps track of which of its orders are resting
+class FlowGenerator {
+private:
+    const BenchConfig& cfg;
+    mt19937_64 rng;
+    uniform_real_distribution<double> unit;
+    normal_distribution<double> normal;
+    exponential_distribution<double> expo;
+
+    Price mid;
+    Price tick;
+
+    vector<int> resting;   // orderIDs we believe are on the book
+
+public:
+    int nextOrderID = 1;
+
+    FlowGenerator(const BenchConfig& c)
+        : cfg(c), rng(c.seed), unit(0.0, 1.0),
+          normal(0.0, c.depth / 3.0), expo(3.0 / c.depth) {
+        tick = toPrice(c.tick);
+        mid = toPrice(c.mid) / tick * tick;
+    }
+
+    bool roll(double p) { return unit(rng) < p; }
+
+    // Levels away from mid (1 = best passive level)
+    int levelsFromMid() {
+        double d;
+        if (cfg.dist == "normal") d = fabs(normal(rng)) + 1;
+        else if (cfg.dist == "exp") d = expo(rng) + 1;
+        else d = 1 + unit(rng) * cfg.depth;
+        int lv = (int)d;
+        return min(max(lv, 1), cfg.depth);
+    }
+
+    Order makeOrder(bool aggressive) {
+        bool buy = roll(0.5);
+        int lv = levelsFromMid();
+        int qty = 1 + (int)(unit(rng) * cfg.maxQty);
+
+        // Passive orders rest on their own side; aggressive ones are priced
+        // through the opposite side and sweep what they can
+        Price px;
+        if (buy) px = aggressive ? mid + lv * tick : mid - lv * tick;
+        else     px = aggressive ? mid - lv * tick : mid + lv * tick;
+        if (px <= 0) px = tick;
+
+        string user = "u" + to_string(nextOrderID % 64);
+        return Order(nextOrderID++, user, "BENCH", buy ? "BUY" : "SELL", px, qty);
+    }
+
+    void rested(int orderID) { resting.push_back(orderID); }
+    bool hasResting() const { return !resting.empty(); }
+    size_t restingCount() const { return resting.size(); }
+    void reserve(size_t n) { resting.reserve(resting.size() + n); }
+
+    // Random resting order, removed from our list
+    int takeResting() {
+        size_t i = (size_t)(unit(rng) * resting.size());
+        if (i >= resting.size()) i = resting.size() - 1;
+        int id = resting[i];
+        resting[i] = resting.back();
+        resting.pop_back();
+        return id;
+    }
+};
+
+static void printRow(const string& name, const LatencyHistogram& h) {
+    cout << "  " << left << setw(10) << name << right
+         << setw(10) << h.count()
+         << setw(10) << h.percentile(50)
+         << setw(10) << h.percentile(99)
+         << setw(10) << h.percentile(99.9)
+         << setw(12) << h.max()
+         << setw(12) << fixed << setprecision(1) << h.mean() << "\n";
+}
+
+int main(int argc, char* argv[]) {
+    BenchConfig cfg;
+    if (!parseArgs(argc, argv, cfg)) return 1;
+
+#if LOG_LEVEL <= LOG_LEVEL_DEBUG
+    cerr << "Warning: built with debug logging; build with -O2 -DNDEBUG for real numbers\n";
+#endif
+
+    // Storage paths are relative to data/, so run inside a scratch dir
+    char tmpl[] = "/tmp/smbench.XXXXXX";
+    char* dir = mkdtemp(tmpl);
+    if (!dir) {
+        cerr << "Could not create temp dir\n";
+        return 1;
+    }
+    string workDir = dir;
+    filesystem::create_directory(workDir + "/data");
+    if (chdir(workDir.c_str()) != 0) {
+        cerr << "Could not enter " << workDir << "\n";
+        return 1;
+    }
+
+    LatencyHistogram addPassive, addAggressive, cancel;
+    size_t trades = 0;
+    double seconds = 0;
+    size_t steadyOps = 0, steadyTrades = 0, steadyAllocs = 0;
+
+    {
+        OrderStorage storage;
+        PriceIndexType type = (cfg.index == "btree") ? PriceIndexType::BTREE : PriceIndexType::LADDER;
+        OrderBook book("BENCH", storage, toPrice(cfg.tick), cfg.resident, type);
+        FlowGenerator flow(cfg);
+        vector<Trade> fills;   // reused by every addOrder
+
+        // Seed both sides so there is something to hit and cancel
+        for (int i = 0; i < cfg.depth * 4; i++) {
+            Order o = flow.makeOrder(false);
+            book.addOrder(&o);
+            flow.rested(o.orderID);
+        }
+
+        auto t0 = chrono::steady_clock::now();
+        int total = cfg.warmup + cfg.orders;
+
+        for (int i = 0; i < total; i++) {
+            bool measure = i >= cfg.warmup;
+            if (i == cfg.warmup) t0 = chrono::steady_clock::now();
+
+            if (flow.hasResting() && flow.roll(cfg.cancelRatio)) {
+                int id = flow.takeResting();
+                auto s = chrono::steady_clock::now();
+                book.cancelOrder(id);
+                auto e = chrono::steady_clock::now();
+                if (measure) cancel.record(chrono::duration_cast<chrono::nanoseconds>(e - s).count());
+                continue;
+            }
+
+            bool aggressive = flow.roll(cfg.aggressorRatio);
+            Order o = flow.makeOrder(aggressive);
+
+            auto s = chrono::steady_clock::now();
+            book.addOrder(&o, fills);
+            auto e = chrono::steady_clock::now();
+
+            if (measure) {
+                uint64_t ns = chrono::duration_cast<chrono::nanoseconds>(e - s).count();
+                (aggressive ? addAggressive : addPassive).record(ns);
+                trades += fills.size();
+            }
+            if (o.getRemainingQuantity() > 0) flow.rested(o.orderID);
+        }
+
+        seconds = chrono::duration<double>(chrono::steady_clock::now() - t0).count();
+
+        // Steady state: the same flow again (passive, crossing, cancels),
+        // with the indexes sized for it up front. Only the book calls are
+        // counted, not the generator building its orders, and none of them
+        // may allocate.
+        int steady = cfg.warmup;
+        storage.reserveOrders(steady);
+        book.reserveOrders(flow.restingCount() + steady);
+        flow.reserve(steady);
+
+        for (int i = 0; i < steady; i++) {
+            if (flow.hasResting() && flow.roll(cfg.cancelRatio)) {
+                int id = flow.takeResting();
+                size_t before = heapAllocations.load();
+                book.cancelOrder(id);
+                steadyAllocs += heapAllocations.load() - before;
+                steadyOps++;
+                continue;
+            }
+
+            Order o = flow.makeOrder(flow.roll(cfg.aggressorRatio));
+            size_t before = heapAllocations.load();
+            book.addOrder(&o, fills);
+            steadyAllocs += heapAllocations.load() - before;
+            steadyOps++;
+            steadyTrades += fills.size();
+            if (o.getRemainingQuantity() > 0) flow.rested(o.orderID);
+        }
+    }
+
+    // Leave /tmp clean
+    if (chdir("/") == 0) filesystem::remove_all(workDir);
+
+    uint64_t ops = addPassive.count() + addAggressive.count() + cancel.count();
+
+    cout << "\nOrderBook benchmark (" << cfg.index << (cfg.resident ? ", resident" : ", disk")
+         << ", depth " << cfg.depth << ", cancel " << cfg.cancelRatio
+         << ", aggressor " << cfg.aggressorRatio << ", dist " << cfg.dist << ")\n";
+    cout << "  " << left << setw(10) << "op" << right
+         << setw(10) << "count" << setw(10) << "p50 ns" << setw(10) << "p99 ns"
+         << setw(10) << "p99.9 ns" << setw(12) << "max ns" << setw(12) << "mean ns" << "\n";
+    printRow("passive", addPassive);
+    printRow("aggress", addAggressive);
+    printRow("cancel", cancel);
+    cout << "  trades: " << trades << "\n";
+    cout << "  throughput: " << fixed << setprecision(0) << (ops / seconds) << " ops/s over "
+         << setprecision(3) << seconds << " s\n";
+    cout << "  steady state: " << steadyAllocs << " heap allocations over " << steadyOps
+         << " ops (" << steadyTrades << " trades)\n";
+
+    if (steadyAllocs != 0) {
+        cout << "FAIL: the book allocated " << steadyAllocs << " times in steady state\n";
+        return 1;
+    }
+    return 0;
+}
+
+//g++ -O2 -DNDEBUG -std=c++17 -pthread \
+    Stock_Market_Matching_Engine/bench/bench_orderbook.cpp \
+    Stock_Market_Matching_Engine/{core,data_structures,engine,storage}/*.cpp \
+    -o bench_orderbook
@@ -5,6 +5,9 @@
 #include <list>
 #include <mutex>
 #include <memory>
+#include <vector>
+#include <functional>
+#include <cstdint>
 using namespace std;
 
 template<typename K, typename V>
@@ -95,4 +98,187 @@ public:
     }
 };
 
+struct CacheShardStats {
+    size_t hits = 0;
+    size_t misses = 0;
+    size_t evictions = 0;
+    size_t size = 0;
+};
+
+// Drop-in replacement for LRUCache (same get / put / remove / clear /
+// getHitRate / size) built for many threads hitting it at once.
+//
+// Keys are spread over independent shards by hash, each with its own
+// mutex, so threads only contend when they land on the same shard. Inside
+// a shard entries sit in a flat slot array managed by the CLOCK policy: a
+// hit just sets the slot's reference bit (no list splicing, no allocation),
+// and on insert the hand sweeps the array, clearing bits until it finds an
+// unreferenced slot to reuse. That approximates LRU at one map node per
+// entry instead of a map node plus a list node.
+template<typename K, typename V>
+class ShardedClockCache {
+private:
+    struct Slot {
+        K key;
+        shared_ptr<V> value;
+        bool referenced = false;
+    };
+
+    struct Shard {
+        mutable mutex lock;
+        vector<Slot> slots;
+        unordered_map<K, uint32_t> index;   // key -> slot
+        vector<uint32_t> freeSlots;         // filled before anything is evicted
+        size_t hand = 0;
+        CacheShardStats stats;
+
+        void reset() {
+            freeSlots.clear();
+            for (size_t i = slots.size(); i > 0; i--) freeSlots.push_back((uint32_t)(i - 1));
+            hand = 0;
+        }
+    };
+
+    static const size_t MIN_SLOTS_PER_SHARD = 16;
+
+    vector<unique_ptr<Shard>> shards;
+    size_t shardMask;
+
+    Shard& shardFor(const K& key) {
+        // Mix so the shard bits don't line up with the shard's own map buckets
+        uint64_t h = (uint64_t)std::hash<K>{}(key) * 0x9E3779B97F4A7C15ull;
+        return *shards[(h >> 32) & shardMask];
+    }
+
+    // Next victim once the shard is full: first slot whose reference bit
+    // is already clear
+    static size_t evictSlot(Shard& sh) {
+        while (true) {
+            Slot& s = sh.slots[sh.hand];
+            size_t at = sh.hand;
+            sh.hand = (sh.hand + 1) % sh.slots.size();
+            if (!s.referenced) return at;
+            s.referenced = false;
+        }
+    }
+
+public:
+    // Capacity is split evenly (rounded up per shard); small caches get
+    // fewer shards so each one still holds a useful number of entries
+    explicit ShardedClockCache(size_t cap, size_t shardCount = 16) {
+        if (cap == 0) cap = 1;
+        size_t n = 1;
+        while (n * 2 <= shardCount && cap / (n * 2) >= MIN_SLOTS_PER_SHARD) n *= 2;
+        shardMask = n - 1;
+
+        size_t perShard = (cap + n - 1) / n;
+        for (size_t i = 0; i < n; i++) {
+            shards.push_back(make_unique<Shard>());
+            shards.back()->slots.resize(perShard);
+            shards.back()->index.reserve(perShard);
+            shards.back()->reset();
+        }
+    }
+
+    shared_ptr<V> get(const K& key) {
+        Shard& sh = shardFor(key);
+        lock_guard<mutex> lock(sh.lock);
+
+        auto it = sh.index.find(key);
+        if (it == sh.index.end()) {
+            sh.stats.misses++;
+            return nullptr;
+        }
+        sh.stats.hits++;
+        Slot& s = sh.slots[it->second];
+        s.referenced = true;
+        return s.value;
+    }
+
+    void put(const K& key, shared_ptr<V> value) {
+        Shard& sh = shardFor(key);
+        lock_guard<mutex> lock(sh.lock);
+
+        auto it = sh.index.find(key);
+        if (it != sh.index.end()) {
+            Slot& s = sh.slots[it->second];
+            s.value = std::move(value);
+            s.referenced = true;
+            return;
+        }
+
+        size_t at;
+        if (!sh.freeSlots.empty()) {
+            at = sh.freeSlots.back();
+            sh.freeSlots.pop_back();
+        } else {
+            at = evictSlot(sh);
+            sh.index.erase(sh.slots[at].key);
+            sh.stats.evictions++;
+        }
+        Slot& s = sh.slots[at];
+        s.key = key;
+        s.value = std::move(value);
+        // Starts referenced: otherwise, when every other slot has been hit,
+        // the hand stops right here and the next insert evicts it
+        s.referenced = true;
+        sh.index[key] = (uint32_t)at;
+    }
+
+    void remove(const K& key) {
+        Shard& sh = shardFor(key);
+        lock_guard<mutex> lock(sh.lock);
+
+        auto it = sh.index.find(key);
+        if (it == sh.index.end()) return;
+        Slot& s = sh.slots[it->second];
+        s.value.reset();
+        s.referenced = false;
+        sh.freeSlots.push_back(it->second);
+        sh.index.erase(it);
+    }
+
+    void clear() {
+        for (auto& sh : shards) {
+            lock_guard<mutex> lock(sh->lock);
+            for (Slot& s : sh->slots) s = Slot();
+            sh->index.clear();
+            sh->reset();
+        }
+    }
+
+    double getHitRate() const {
+        size_t hits = 0, total = 0;
+        for (const auto& sh : shards) {
+            lock_guard<mutex> lock(sh->lock);
+            hits += sh->stats.hits;
+            total += sh->stats.hits + sh->stats.misses;
+        }
+        return total > 0 ? (double)hits / total : 0.0;
+    }
+
+    size_t size() const {
+        size_t n = 0;
+        for (const auto& sh : shards) {
+            lock_guard<mutex> lock(sh->lock);
+            n += sh->index.size();
+        }
+        return n;
+    }
+
+    // Per-shard counters, e.g. to spot a hot shard
+    vector<CacheShardStats> getShardStats() const {
+        vector<CacheShardStats> out;
+        out.reserve(shards.size());
+        for (const auto& sh : shards) {
+            lock_guard<mutex> lock(sh->lock);
+            out.push_back(sh->stats);
+            out.back().size = sh->index.size();
+        }
+        return out;
+    }
+
+    size_t getShardCount() const { return shards.size(); }
+};
+
 #endif // CACHE_H
\ No newline at end of file
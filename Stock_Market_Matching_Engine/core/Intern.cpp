@@ -0,0 +1,166 @@
+#include "Intern.h"
+#include "Log.h"
+#include <cstring>
+#include <stdexcept>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+using namespace std;
+
+// File layout: [u32 magic 'INTN'][u32 version], then one entry per key
+// starting at 1: [u16 len][name bytes]. A torn last entry is cut off.
+namespace {
+
+const uint32_t INTERN_MAGIC = 0x4E544E49;   // "INTN"
+const uint32_t INTERN_VERSION = 1;
+
+bool writeAll(int fd, const char* p, size_t n) {
+    while (n > 0) {
+        ssize_t w = ::write(fd, p, n);
+        if (w <= 0) return false;
+        p += w;
+        n -= w;
+    }
+    return true;
+}
+
+void encodeName(string_view name, vector<char>& out) {
+    uint16_t len = (uint16_t)min<size_t>(name.size(), UINT16_MAX);
+    size_t at = out.size();
+    out.resize(at + sizeof(len) + len);
+    memcpy(out.data() + at, &len, sizeof(len));
+    memcpy(out.data() + at + sizeof(len), name.data(), len);
+}
+
+// Names in file order; good = bytes up to the last complete entry.
+// present = the file exists with at least a header (anything shorter is a
+// creation cut short and gets written from scratch).
+bool readNames(const string& path, vector<string>& saved, size_t& good, bool& present) {
+    saved.clear();
+    good = 0;
+    present = false;
+
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) return false;
+    struct stat st;
+    vector<char> buf;
+    if (::fstat(fd, &st) == 0) buf.resize(st.st_size);
+    size_t done = 0;
+    while (done < buf.size()) {
+        ssize_t n = ::read(fd, buf.data() + done, buf.size() - done);
+        if (n <= 0) break;
+        done += n;
+    }
+    ::close(fd);
+    buf.resize(done);
+
+    uint32_t hdr[2];
+    if (buf.size() < sizeof(hdr)) return false;
+    present = true;
+    memcpy(hdr, buf.data(), sizeof(hdr));
+    if (hdr[0] != INTERN_MAGIC || hdr[1] != INTERN_VERSION) return false;
+
+    size_t pos = sizeof(hdr);
+    while (pos + sizeof(uint16_t) <= buf.size()) {
+        uint16_t len;
+        memcpy(&len, buf.data() + pos, sizeof(len));
+        if (pos + sizeof(len) + len > buf.size()) break;
+        saved.emplace_back(buf.data() + pos + sizeof(len), len);
+        pos += sizeof(len) + len;
+    }
+    good = pos;
+    return true;
+}
+}
+
+InternTable::~InternTable() {
+    if (fd >= 0) ::close(fd);
+}
+
+uint32_t InternTable::add(string_view name) {
+    uint32_t key = (uint32_t)names.size();
+    names.emplace_back(name);
+    keys.emplace(string_view(names.back()), key);
+    return key;
+}
+
+bool InternTable::appendName(string_view name) {
+    if (fd < 0) return false;
+    vector<char> buf;
+    encodeName(name, buf);
+    if (writeAll(fd, buf.data(), buf.size())) return true;
+    LOG_ERROR("InternTable: append failed, keys of new names may change on restart");
+    return false;
+}
+
+bool InternTable::attach(const string& path) {
+    unique_lock<shared_mutex> wr(lock);
+    if (fd >= 0) {
+        ::close(fd);
+        fd = -1;
+    }
+
+    vector<string> saved;
+    size_t good = 0;
+    bool present = false;
+    bool readable = readNames(path, saved, good, present);
+    if (present && !readable) {
+        LOG_ERROR("InternTable: " << path << " is not an intern file this build can read");
+        throw runtime_error("InternTable: unreadable " + path);
+    }
+
+    // The file wins. Keys this process handed out before attaching can't
+    // be taken back, so they must already mean the same names there;
+    // otherwise refuse rather than let persisted keys change meaning.
+    size_t common = min(saved.size(), names.size() - 1);
+    for (size_t i = 0; i < saved.size(); i++) {
+        bool clash = (i < common) ? saved[i] != names[i + 1]
+                                  : keys.find(saved[i]) != keys.end();
+        if (clash) {
+            LOG_ERROR("InternTable: key " << (i + 1) << " is '" << saved[i] << "' in " << path
+                      << " but this process already interned names in another order;"
+                      << " attach before anything is interned");
+            throw runtime_error("InternTable: keys do not match " + path);
+        }
+    }
+    for (size_t i = common; i < saved.size(); i++) add(saved[i]);
+
+    if (!present) {
+        // New file: the names interned so far, written aside and renamed
+        vector<char> buf(sizeof(uint32_t) * 2);
+        uint32_t hdr[2] = {INTERN_MAGIC, INTERN_VERSION};
+        memcpy(buf.data(), hdr, sizeof(hdr));
+        for (size_t k = 1; k < names.size(); k++) encodeName(names[k], buf);
+
+        string tmp = path + ".tmp";
+        int out = ::open(tmp.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        bool ok = out >= 0 && writeAll(out, buf.data(), buf.size()) && ::fsync(out) == 0;
+        if (out >= 0) ::close(out);
+        if (!ok || ::rename(tmp.c_str(), path.c_str()) != 0) {
+            LOG_ERROR("InternTable: cannot write " << path);
+            ::unlink(tmp.c_str());
+            return false;
+        }
+    } else if (::truncate(path.c_str(), good) != 0) {
+        LOG_ERROR("InternTable: cannot trim " << path);
+    }
+
+    fd = ::open(path.c_str(), O_WRONLY | O_APPEND);
+    if (fd < 0) {
+        LOG_ERROR("InternTable: cannot open " << path);
+        return false;
+    }
+
+    // Names this process interned before attaching that the file lacks;
+    // they come after every saved key, so appending keeps both in step
+    if (present) {
+        for (size_t k = saved.size() + 1; k < names.size(); k++) appendName(names[k]);
+    }
+    return true;
+}
+
+void attachInternTables() {
+    if (!symbolTable().isAttached()) symbolTable().attach("data/symbols.intern");
+    if (!userTable().isAttached()) userTable().attach("data/users.intern");
+}
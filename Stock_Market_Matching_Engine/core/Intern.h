@@ -0,0 +1,113 @@
+#ifndef INTERN_H
+#define INTERN_H
+
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <shared_mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+using namespace std;
+
+// Maps strings (symbols, user IDs) to small dense integer keys and back, so
+// hot-path structures can carry a uint32_t instead of a std::string.
+//
+// Keys are handed out in first-seen order starting at 1; key 0 is the empty
+// string. Names live in a deque, which never moves an element, so name()
+// can return a reference that stays valid. Lookups of an already known
+// string take a shared lock and do not allocate.
+//
+// attach() ties the table to a file (data/symbols.intern, ...) holding the
+// names in key order, so keys stay the same across restarts. New names are
+// appended with one write() as they are interned. Keys end up in persisted
+// records, so the file is never rewritten once it exists.
+class InternTable {
+private:
+    mutable shared_mutex lock;
+    deque<string> names;                        // key -> name
+    unordered_map<string_view, uint32_t> keys;  // views into names
+    int fd;                                     // attached file, -1 if none
+
+    uint32_t add(string_view name);             // caller holds lock exclusively
+    bool appendName(string_view name);
+
+public:
+    InternTable() : fd(-1) {
+        names.emplace_back();
+        keys.emplace(string_view(names.back()), 0);
+    }
+    ~InternTable();
+
+    InternTable(const InternTable&) = delete;
+    InternTable& operator=(const InternTable&) = delete;
+
+    // Load the names saved at path (creating it if needed) and keep it up
+    // to date from now on. The saved keys win: names interned before the
+    // call are kept only if they already have the same keys in the file
+    // (or come after all of them, and are appended). Anything else throws
+    // runtime_error and leaves the file alone, as does a file that isn't
+    // an intern file. False if the file cannot be opened.
+    bool attach(const string& path);
+
+    uint32_t intern(string_view name) {
+        {
+            shared_lock<shared_mutex> rd(lock);
+            auto it = keys.find(name);
+            if (it != keys.end()) return it->second;
+        }
+
+        unique_lock<shared_mutex> wr(lock);
+        auto it = keys.find(name);   // someone may have beaten us to it
+        if (it != keys.end()) return it->second;
+
+        uint32_t key = add(name);
+        appendName(name);
+        return key;
+    }
+
+    // Key of a string already interned, or false (never inserts)
+    bool find(string_view name, uint32_t& key) const {
+        shared_lock<shared_mutex> rd(lock);
+        auto it = keys.find(name);
+        if (it == keys.end()) return false;
+        key = it->second;
+        return true;
+    }
+
+    // Unknown keys map to the empty string
+    const string& name(uint32_t key) const {
+        shared_lock<shared_mutex> rd(lock);
+        return key < names.size() ? names[key] : names[0];
+    }
+
+    bool isAttached() const {
+        shared_lock<shared_mutex> rd(lock);
+        return fd >= 0;
+    }
+
+    size_t size() const {
+        shared_lock<shared_mutex> rd(lock);
+        return names.size();
+    }
+};
+
+// Process-wide tables
+inline InternTable& symbolTable() {
+    static InternTable table;
+    return table;
+}
+
+inline InternTable& userTable() {
+    static InternTable table;
+    return table;
+}
+
+// Attach both tables to their files under data/ unless already attached.
+// Every storage that interns calls this before loading anything, and so
+// must anything that interns before the storages exist (replay_capture).
+void attachInternTables();
+
+#endif
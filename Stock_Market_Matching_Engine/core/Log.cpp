@@ -0,0 +1,62 @@
+#include "Log.h"
+#include <cstdio>
+#include <cstring>
+#include <chrono>
+
+using namespace std;
+
+AsyncLogSink::AsyncLogSink()
+    : ring(CAPACITY), running(true), dropped(0) {
+    worker = thread(&AsyncLogSink::run, this);
+}
+
+AsyncLogSink::~AsyncLogSink() {
+    running = false;
+    if (worker.joinable()) worker.join();
+
+    size_t lost = dropped.load();
+    if (lost > 0) {
+        fprintf(stderr, "[LOG] %zu messages dropped (ring full)\n", lost);
+    }
+}
+
+AsyncLogSink& AsyncLogSink::instance() {
+    static AsyncLogSink sink;
+    return sink;
+}
+
+bool AsyncLogSink::push(int level, const string& message) {
+    LogEntry entry;
+    entry.level = level;
+    entry.length = min(message.size(), (size_t)MAX_MESSAGE);
+    memcpy(entry.text, message.data(), entry.length);
+
+    if (!ring.tryPush(entry)) {
+        dropped.fetch_add(1, memory_order_relaxed);
+        return false;
+    }
+    return true;
+}
+
+bool AsyncLogSink::drainOnce() {
+    static const char* names[] = {"", "DBG", "INFO", "WARN", "ERR"};
+    bool any = false;
+    LogEntry entry;
+
+    while (ring.tryPop(entry)) {
+        int level = (entry.level >= 1 && entry.level <= 4) ? entry.level : 1;
+        fprintf(stderr, "[%s] %.*s\n", names[level], (int)entry.length, entry.text);
+        any = true;
+    }
+    return any;
+}
+
+void AsyncLogSink::run() {
+    while (running.load(memory_order_relaxed)) {
+        if (!drainOnce()) {
+            this_thread::sleep_for(chrono::milliseconds(1));
+        }
+    }
+    drainOnce();
+    fflush(stderr);
+}
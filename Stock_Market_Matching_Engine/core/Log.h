@@ -0,0 +1,107 @@
+#ifndef LOG_H
+#define LOG_H
+
+#include <atomic>
+#include <thread>
+#include <sstream>
+#include <string>
+#include <cstddef>
+#include "../data_structures/MPSCRing.h"
+
+// Logging with compile-time levels.
+//
+//   LOG_DEBUG("addOrder: orderID=" << id << " price=" << px);
+//
+// Calls below LOG_LEVEL expand to an empty statement, so their arguments are
+// never evaluated. Enabled calls format the message on the calling thread
+// and push it into a lock-free ring; a background sink thread writes it to
+// stderr. If the ring is full the message is dropped (and counted) rather
+// than blocking the caller.
+//
+// Build with -DNDEBUG (or -DLOG_LEVEL=LOG_LEVEL_INFO) for production; debug
+// builds keep the LOG_DEBUG tracing.
+
+#define LOG_LEVEL_DEBUG 1
+#define LOG_LEVEL_INFO  2
+#define LOG_LEVEL_WARN  3
+#define LOG_LEVEL_ERROR 4
+#define LOG_LEVEL_NONE  5
+
+#ifndef LOG_LEVEL
+#ifdef NDEBUG
+#define LOG_LEVEL LOG_LEVEL_INFO
+#else
+#define LOG_LEVEL LOG_LEVEL_DEBUG
+#endif
+#endif
+
+// One formatted message as it sits in the ring
+struct LogEntry {
+    static const size_t MAX_MESSAGE = 240;
+
+    int level = 0;
+    size_t length = 0;
+    char text[MAX_MESSAGE];
+};
+
+class AsyncLogSink {
+public:
+    static const size_t CAPACITY = 4096;
+    static const size_t MAX_MESSAGE = LogEntry::MAX_MESSAGE;
+
+private:
+    MPSCRing<LogEntry> ring;
+    std::atomic<bool> running;
+    std::atomic<size_t> dropped;
+    std::thread worker;
+
+    AsyncLogSink();
+    ~AsyncLogSink();
+
+    bool drainOnce();
+    void run();
+
+public:
+    AsyncLogSink(const AsyncLogSink&) = delete;
+    AsyncLogSink& operator=(const AsyncLogSink&) = delete;
+
+    static AsyncLogSink& instance();
+
+    // Multi-producer, wait-free unless the ring is full
+    bool push(int level, const std::string& message);
+
+    size_t getDropped() const { return dropped.load(std::memory_order_relaxed); }
+};
+
+#define LOG_AT(lvl, expr)                                   \
+    do {                                                    \
+        std::ostringstream log_oss_;                        \
+        log_oss_ << expr;                                   \
+        AsyncLogSink::instance().push(lvl, log_oss_.str()); \
+    } while (0)
+
+#if LOG_LEVEL <= LOG_LEVEL_DEBUG
+#define LOG_DEBUG(expr) LOG_AT(LOG_LEVEL_DEBUG, expr)
+#else
+#define LOG_DEBUG(expr) do {} while (0)
+#endif
+
+#if LOG_LEVEL <= LOG_LEVEL_INFO
+#define LOG_INFO(expr) LOG_AT(LOG_LEVEL_INFO, expr)
+#else
+#define LOG_INFO(expr) do {} while (0)
+#endif
+
+#if LOG_LEVEL <= LOG_LEVEL_WARN
+#define LOG_WARN(expr) LOG_AT(LOG_LEVEL_WARN, expr)
+#else
+#define LOG_WARN(expr) do {} while (0)
+#endif
+
+#if LOG_LEVEL <= LOG_LEVEL_ERROR
+#define LOG_ERROR(expr) LOG_AT(LOG_LEVEL_ERROR, expr)
+#else
+#define LOG_ERROR(expr) do {} while (0)
+#endif
+
+#endif
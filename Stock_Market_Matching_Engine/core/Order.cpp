@@ -6,7 +6,7 @@ Order::Order()
 }
 
 Order::Order(int id, const string &uID, const string &sym, const string &sd,
-             double prc, int qty)
+             Price prc, int qty)
     : orderID(id), userID(uID), symbol(sym), side(sd),
       price(prc), quantity(qty), remainingQty(qty), status("ACTIVE")
 {
@@ -82,7 +82,7 @@ string Order::toString() const {
         << ", User: " << userID
         << ", Symbol: " << symbol
         << ", Side: " << side
-        << ", Price: $" << fixed << setprecision(2) << price
+        << ", Price: $" << fixed << setprecision(2) << toDouble(price)
         << ", Qty: " << quantity
         << ", Remaining: " << remainingQty
         << ", Status: " << status
@@ -98,7 +98,7 @@ int Order::getRemainingQuantity() const {
     return remainingQty;
 }
 
-double Order::getPrice() const {
+Price Order::getPrice() const {
     return price;
 }
 
@@ -119,3 +119,65 @@ void Order::reduceRemainingQty(int qty) {
         status = "PARTIAL_FILL";
     }
 }
+
+void HotOrder::reduceRemainingQty(int qty) {
+    remainingQty -= qty;
+    if (remainingQty <= 0) {
+        remainingQty = 0;
+        status = OrderStatus::FILLED;
+    } else {
+        status = OrderStatus::PARTIAL_FILL;
+    }
+}
+
+void HotOrder::cancel() {
+    if (!isFilled()) {
+        status = OrderStatus::CANCELLED;
+        remainingQty = 0;
+    }
+}
+
+OrderRecord HotOrder::toRecord() const {
+    OrderRecord rec{};
+    rec.orderID = orderID;
+
+    const string& user = userTable().name(userKey);
+    const string& sym = symbolTable().name(symbolKey);
+    strncpy(rec.userID, user.c_str(), sizeof(rec.userID) - 1);
+    strncpy(rec.symbol, sym.c_str(), sizeof(rec.symbol) - 1);
+
+    rec.side = (char)side;
+    rec.price = price;
+    rec.quantity = quantity;
+    rec.remainingQty = remainingQty;
+    rec.status = (char)status;
+    rec.timestamp = timestamp;
+    return rec;
+}
+
+HotOrder HotOrder::fromRecord(const OrderRecord& rec) {
+    HotOrder o;
+    o.price = rec.price;
+    o.timestamp = rec.timestamp;
+    o.orderID = rec.orderID;
+    o.userKey = userTable().intern(string_view(rec.userID, strnlen(rec.userID, sizeof(rec.userID))));
+    o.symbolKey = symbolTable().intern(string_view(rec.symbol, strnlen(rec.symbol, sizeof(rec.symbol))));
+    o.quantity = rec.quantity;
+    o.remainingQty = rec.remainingQty;
+    o.side = (rec.side == 'B') ? OrderSide::BUY : OrderSide::SELL;
+    switch (rec.status) {
+    case 'A': o.status = OrderStatus::ACTIVE; break;
+    case 'F': o.status = OrderStatus::FILLED; break;
+    case 'P': o.status = OrderStatus::PARTIAL_FILL; break;
+    default:  o.status = OrderStatus::CANCELLED; break;
+    }
+    return o;
+}
+
+HotOrder HotOrder::fromOrder(const Order& order) {
+    return fromRecord(order.toRecord());
+}
+
+Order HotOrder::toOrder() const {
+    return Order::fromRecord(toRecord());
+}
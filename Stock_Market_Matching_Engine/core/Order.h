@@ -7,6 +7,9 @@
 #include <ctime>
 #include <cstdint>
 #include <cstring>
+#include <type_traits>
+#include "Price.h"
+#include "Intern.h"
 
 using namespace std;
 
@@ -16,7 +19,7 @@ struct OrderRecord {
     char userID[32];
     char symbol[8];
     char side;        // 'B' or 'S'
-    double price;
+    int64_t price;    // fixed-point, see Price.h
     int32_t quantity;
     int32_t remainingQty;
     char status;      // 'A','F','P','C'
@@ -30,7 +33,7 @@ public:
     string userID;
     string symbol;
     string side;        // "BUY" or "SELL"
-    double price;
+    Price price;        // fixed-point ticks (Price.h)
     int quantity;
     int remainingQty;
     string status;      // "ACTIVE", "FILLED", "PARTIAL_FILL", "CANCELLED"
@@ -39,7 +42,7 @@ public:
     // Constructor
     Order();
     Order(int id, const string& uID, const string& sym, const string& sd,
-          double prc, int qty);
+          Price prc, int qty);
         Order(const Order& other) = default;
     Order& operator=(const Order& other) = default;
     Order(Order&&) = default;
@@ -59,10 +62,57 @@ public:
     // Getters
     bool getSide() const;
     int getRemainingQuantity() const;
-    double getPrice() const;
+    Price getPrice() const;
     string getSymbol() const;
     int getOrderID() const;
     void reduceRemainingQty(int qty);
 };
 
+enum class OrderSide : char { BUY = 'B', SELL = 'S' };   // OrderRecord codes
+enum class OrderStatus : char { ACTIVE = 'A', FILLED = 'F', PARTIAL_FILL = 'P', CANCELLED = 'C' };
+
+// Fixed-size order for the matching path: symbol and user are interned keys
+// (Intern.h), side and status are one-byte codes, so copying, storing and
+// updating one never touches the heap. Order (strings) stays the API type;
+// conversion happens when an order enters or leaves a book.
+struct HotOrder {
+    Price price;
+    int64_t timestamp;
+    int32_t orderID;
+    uint32_t userKey;     // userTable()
+    uint32_t symbolKey;   // symbolTable()
+    int32_t quantity;
+    int32_t remainingQty;
+    OrderSide side;
+    OrderStatus status;
+
+    bool isBuy() const { return side == OrderSide::BUY; }
+    bool isFilled() const { return remainingQty <= 0; }
+    void reduceRemainingQty(int qty);   // same rules as Order
+    void cancel();
+
+    OrderRecord toRecord() const;
+    static HotOrder fromRecord(const OrderRecord& rec);
+    static HotOrder fromOrder(const Order& order);
+    Order toOrder() const;
+};
+
+static_assert(sizeof(HotOrder) <= 64, "HotOrder should fit in a cache line");
+static_assert(std::is_trivially_copyable<HotOrder>::value, "HotOrder must stay POD");
+
+// One entry of a batch call (MatchingEngine::placeOrders / cancelOrders);
+// same arguments as the single-order calls
+struct OrderRequest {
+    string userID;
+    string symbol;
+    string side;      // "BUY" / "SELL"
+    double price = 0;
+    int quantity = 0;
+};
+
+struct CancelRequest {
+    int orderID = 0;
+    string userID;
+};
+
 #endif
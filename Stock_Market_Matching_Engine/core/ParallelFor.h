@@ -0,0 +1,53 @@
+#ifndef PARALLELFOR_H
+#define PARALLELFOR_H
+
+#include <thread>
+#include <atomic>
+#include <mutex>
+#include <vector>
+#include <exception>
+#include <algorithm>
+
+using namespace std;
+
+// Run task(i) for every i in [0, n) on a small pool of worker threads.
+// Workers pull the next index from a shared counter, so one slow task
+// (a big symbol) doesn't hold up the rest. threads = 0 means one per core.
+// The first exception thrown by a task is rethrown after all workers join.
+template <typename Task>
+void parallelFor(size_t n, Task task, unsigned threads = 0) {
+    if (n == 0) return;
+    if (threads == 0) threads = max(1u, thread::hardware_concurrency());
+    threads = (unsigned)min<size_t>(threads, n);
+
+    if (threads == 1) {
+        for (size_t i = 0; i < n; i++) task(i);
+        return;
+    }
+
+    atomic<size_t> next(0);
+    exception_ptr failure;
+    mutex failureMutex;
+
+    auto worker = [&]() {
+        size_t i;
+        while ((i = next.fetch_add(1)) < n) {
+            try {
+                task(i);
+            } catch (...) {
+                lock_guard<mutex> lk(failureMutex);
+                if (!failure) failure = current_exception();
+            }
+        }
+    };
+
+    vector<thread> pool;
+    pool.reserve(threads - 1);
+    for (unsigned t = 1; t < threads; t++) pool.emplace_back(worker);
+    worker();   // the calling thread works too
+    for (thread& t : pool) t.join();
+
+    if (failure) rethrow_exception(failure);
+}
+
+#endif
@@ -0,0 +1,36 @@
+#ifndef PRICE_H
+#define PRICE_H
+
+#include <cstdint>
+#include <cmath>
+
+// Fixed-point prices and cash: PRICE_SCALE units per dollar.
+// Doubles only appear at the API edge (toPrice / toDouble).
+using Price = int64_t;
+using Money = int64_t;   // same scale as Price, so price * qty is exact
+
+const int64_t PRICE_SCALE = 10000;
+const Price DEFAULT_TICK_SIZE = 100;   // $0.01
+const Price NO_PRICE = -1;             // "no such level"
+
+inline Price toPrice(double value) {
+    return llround(value * PRICE_SCALE);
+}
+
+inline Money toMoney(double value) {
+    return llround(value * PRICE_SCALE);
+}
+
+inline double toDouble(int64_t fixed) {
+    return (double)fixed / PRICE_SCALE;
+}
+
+inline Money notional(Price price, int quantity) {
+    return price * quantity;
+}
+
+inline bool isOnTick(Price price, Price tickSize) {
+    return tickSize > 0 && price > 0 && price % tickSize == 0;
+}
+
+#endif
@@ -2,29 +2,29 @@
 #include <stdexcept>
 #include <iostream>
 Trade::Trade()
+    : buyUserKey(0), sellUserKey(0), symbolKey(0)
 {
 }
 
-Trade::Trade(int tid, const Order& o1, const Order& o2, int qty, double prc)
+Trade::Trade(int tid, const HotOrder& o1, const HotOrder& o2, int qty, Price prc)
 {
-    std::cout << "Reached Here!";
-    if (o1.symbol != o2.symbol)
+    if (o1.symbolKey != o2.symbolKey)
         throw runtime_error("Cannot trade orders with different symbols");
 
-    if (o1.side == "BUY") {
+    if (o1.isBuy()) {
         buyOrderID  = o1.orderID;
-        buyUserID   = o1.userID;
+        buyUserKey  = o1.userKey;
         sellOrderID = o2.orderID;
-        sellUserID  = o2.userID;
+        sellUserKey = o2.userKey;
     } else {
         buyOrderID  = o2.orderID;
-        buyUserID   = o2.userID;
+        buyUserKey  = o2.userKey;
         sellOrderID = o1.orderID;
-        sellUserID  = o1.userID;
+        sellUserKey = o1.userKey;
     }
 
     tradeID   = tid;
-    symbol    = o1.symbol;
+    symbolKey = o1.symbolKey;
     price     = prc;
     quantity  = qty;
     timestamp = std::time(nullptr);
@@ -34,11 +34,11 @@ Trade::Trade(int tid, const Order& o1, const Order& o2, int qty, double prc)
 string Trade:: toString() const {
     std::ostringstream oss;
     oss << "TradeID: " << tradeID
-        << " , Symbol: " << symbol
+        << " , Symbol: " << getSymbol()
         << " , Qty: " << quantity
-        << " , Price: $" << std::fixed << std::setprecision(2) << price
-        << " , BuyOrder: " << buyOrderID << " (" << buyUserID << ")"
-        << " , SellOrder: " << sellOrderID << " (" << sellUserID << ")"
+        << " , Price: $" << std::fixed << std::setprecision(2) << toDouble(price)
+        << " , BuyOrder: " << buyOrderID << " (" << getBuyUserID() << ")"
+        << " , SellOrder: " << sellOrderID << " (" << getSellUserID() << ")"
         << " , Timestamp: " << timestamp;
     return oss.str();
 }
@@ -52,9 +52,9 @@ TradeRecord Trade::toRecord() const {
     rec.buyOrderID = buyOrderID;
     rec.sellOrderID = sellOrderID;
     
-    strncpy(rec.buyUserID, buyUserID.c_str(), 63);
-    strncpy(rec.sellUserID, sellUserID.c_str(), 63);
-    strncpy(rec.symbol, symbol.c_str(), 31);
+    strncpy(rec.buyUserID, getBuyUserID().c_str(), 63);
+    strncpy(rec.sellUserID, getSellUserID().c_str(), 63);
+    strncpy(rec.symbol, getSymbol().c_str(), 31);
     
     rec.price = price;
     rec.quantity = quantity;
@@ -69,9 +69,9 @@ Trade Trade::fromRecord(const TradeRecord& rec) {
     trade.tradeID = rec.tradeID;
     trade.buyOrderID = rec.buyOrderID;
     trade.sellOrderID = rec.sellOrderID;
-    trade.buyUserID = string(rec.buyUserID);
-    trade.sellUserID = string(rec.sellUserID);
-    trade.symbol = string(rec.symbol);
+    trade.buyUserKey = userTable().intern(string_view(rec.buyUserID, strnlen(rec.buyUserID, sizeof(rec.buyUserID))));
+    trade.sellUserKey = userTable().intern(string_view(rec.sellUserID, strnlen(rec.sellUserID, sizeof(rec.sellUserID))));
+    trade.symbolKey = symbolTable().intern(string_view(rec.symbol, strnlen(rec.symbol, sizeof(rec.symbol))));
     trade.price = rec.price;
     trade.quantity = rec.quantity;
     trade.timestamp = rec.timestamp;
@@ -14,7 +14,7 @@ struct TradeRecord {
     char buyUserID[64];
     char sellUserID[64];
     char symbol[32];
-    double price;
+    int64_t price;    // fixed-point, see Price.h
     int quantity;
     time_t timestamp;
     
@@ -26,16 +26,23 @@ public:
     int tradeID;            // Unique ID of trade
     int buyOrderID;         // Order ID of BUY order
     int sellOrderID;        // Order ID of SELL order
-    string buyUserID;       // User who bought
-    string sellUserID;      // User who sold
-    string symbol;          // Stock symbol
-    double price;           // Traded price per unit
+    uint32_t buyUserKey;    // User who bought (userTable key)
+    uint32_t sellUserKey;   // User who sold
+    uint32_t symbolKey;     // Stock symbol (symbolTable key)
+    Price price;            // Traded price per unit (fixed-point)
     int quantity;           // Trade quantity
     time_t timestamp;       // Trade execution time
 
     // Constructor
     Trade();
-    Trade(int tid,const Order &o1,const Order &o2, int qty, double prc);
+    Trade(int tid, const HotOrder& o1, const HotOrder& o2, int qty, Price prc);
+
+    const string& getBuyUserID() const { return userTable().name(buyUserKey); }
+    const string& getSellUserID() const { return userTable().name(sellUserKey); }
+    const string& getSymbol() const { return symbolTable().name(symbolKey); }
+    bool involves(const string& userID) const {
+        return getBuyUserID() == userID || getSellUserID() == userID;
+    }
 
     // Displayable format
     string toString() const;
@@ -1,39 +1,90 @@
 #include "User.h"
+#include "Log.h"
+#include "Intern.h"
+#include "Varint.h"
 #include <iostream>
+#include <algorithm>
 
 
 User:: User()
 {}
 User::User(const std::string& uid, double cash)
-    : userID(uid), cashBalance(cash) {
+    : userID(uid), cashBalance(toMoney(cash)) {
     // Vectors start empty, will grow dynamically
 }
 
+User::User(const User& other)
+    : userID(other.userID), cashBalance(other.cashBalance),
+      symbolKeys(other.symbolKeys), quantities(other.quantities),
+      activeOrders(other.activeOrders), dirty(other.dirty) {
+    reindex();
+}
+
+User& User::operator=(const User& other) {
+    if (this == &other) return *this;
+    userID = other.userID;
+    cashBalance = other.cashBalance;
+    symbolKeys = other.symbolKeys;
+    quantities = other.quantities;
+    activeOrders = other.activeOrders;
+    dirty = other.dirty;
+    reindex();
+    return *this;
+}
+
+void User::reindex() {
+    holdingAt.clear((int)symbolKeys.size());
+    for (size_t i = 0; i < symbolKeys.size(); i++) holdingAt.insert(symbolKeys[i], (uint32_t)i);
+    activeOrderAt.clear((int)activeOrders.size());
+    for (size_t i = 0; i < activeOrders.size(); i++) activeOrderAt.insert(activeOrders[i], (uint32_t)i);
+}
+
 // Cash management
-bool User::deductCash(double amount) {
+bool User::deductCash(Money amount) {
     if (cashBalance < amount) {
-        cout << " - INSUFFICIENT FUNDS\n";
+        LOG_DEBUG("deductCash user=" << userID << ": insufficient funds");
         return false;
     }
     cashBalance -= amount;
-    cout << " - SUCCESS, new balance=$" << cashBalance << "\n";
+    LOG_DEBUG("deductCash user=" << userID << ": new balance=$" << toDouble(cashBalance));
     return true;
 }
 
-void User::addCash(double amount) {
+void User::addCash(Money amount) {
     cashBalance += amount;
 }
 
-double User::getCashBalance() const {
+Money User::getCash() const {
     return cashBalance;
 }
 
+double User::getCashBalance() const {
+    return toDouble(cashBalance);
+}
+
 // Stock management
 void User::addStock(const string& symbol, int qty) {
-    int idx = findSymbol(symbol);
+    addStock(symbolTable().intern(symbol), qty);
+}
+
+bool User::removeStock(const string& symbol, int qty) {
+    uint32_t key;
+    if (!symbolTable().find(symbol, key)) return false;
+    return removeStock(key, qty);
+}
+
+int User::getStockQuantity(const string& symbol) const {
+    uint32_t key;
+    if (!symbolTable().find(symbol, key)) return 0;
+    return getStockQuantity(key);
+}
+
+void User::addStock(uint32_t symbolKey, int qty) {
+    int idx = findSymbol(symbolKey);
     if (idx == -1) {
         // New stock - add to vectors
-        symbols.push_back(symbol);
+        holdingAt.insert(symbolKey, (uint32_t)symbolKeys.size());
+        symbolKeys.push_back(symbolKey);
         quantities.push_back(qty);
     } else {
         // Existing stock - increase quantity
@@ -41,8 +92,8 @@ void User::addStock(const string& symbol, int qty) {
     }
 }
 
-bool User::removeStock(const string& symbol, int qty) {
-    int idx = findSymbol(symbol);
+bool User::removeStock(uint32_t symbolKey, int qty) {
+    int idx = findSymbol(symbolKey);
     if (idx == -1) return false;
     if (quantities[idx] < qty) return false;
     
@@ -50,25 +101,34 @@ bool User::removeStock(const string& symbol, int qty) {
     return true;
 }
 
-int User::getStockQuantity(const string& symbol) const {
-    int idx = findSymbol(symbol);
+int User::getStockQuantity(uint32_t symbolKey) const {
+    int idx = findSymbol(symbolKey);
     if (idx == -1) return 0;
     return quantities[idx];
 }
 
 // Order management
 void User::addActiveOrder(int orderID) {
+    if (activeOrderAt.contains(orderID)) return;
+    activeOrderAt.insert(orderID, (uint32_t)activeOrders.size());
     activeOrders.push_back(orderID);
 }
 
 void User::removeActiveOrder(int orderID) {
-    for (size_t i = 0; i < activeOrders.size(); i++) {
-        if (activeOrders[i] == orderID) {
-            activeOrders[i] = activeOrders.back();
-            activeOrders.pop_back();
-            return;
-        }
-    }
+    const uint32_t* at = activeOrderAt.find(orderID);
+    if (!at) return;
+
+    uint32_t i = *at;
+    int last = activeOrders.back();
+    activeOrders[i] = last;
+    activeOrders.pop_back();
+    activeOrderAt.remove(orderID);
+    if (last != orderID) activeOrderAt.insert(last, i);
+}
+
+void User::clearActiveOrders() {
+    activeOrders.clear();
+    activeOrderAt.clear();
 }
 
 // Getters
@@ -78,20 +138,24 @@ string User::getUserID() const {
 
 // Helper methods
 int User::findSymbol(const string& symbol) const {
-    for (size_t i = 0; i < symbols.size(); i++) {
-        if (symbols[i] == symbol) return i;
-    }
-    return -1;
+    uint32_t key;
+    if (!symbolTable().find(symbol, key)) return -1;
+    return findSymbol(key);
+}
+
+int User::findSymbol(uint32_t symbolKey) const {
+    const uint32_t* at = holdingAt.find(symbolKey);
+    return at ? (int)*at : -1;
 }
 
 // Display
 string User::toString() const {
     std::ostringstream oss;
-    oss << "User: " << userID << ", Cash: $" << cashBalance;
+    oss << "User: " << userID << ", Cash: $" << toDouble(cashBalance);
     
     oss << ", Holdings: ";
-    for (size_t i = 0; i < symbols.size(); i++) {
-        oss << "[" << symbols[i] << ":" << quantities[i] << "] ";
+    for (size_t i = 0; i < symbolKeys.size(); i++) {
+        oss << "[" << symbolTable().name(symbolKeys[i]) << ":" << quantities[i] << "] ";
     }
     
     oss << ", Active Orders: ";
@@ -110,10 +174,10 @@ vector<int> User:: getActiveOrderIDs() const
 
 vector<StockHolding> User:: getAllHoldings() const {
     vector<StockHolding> holdings;
-    for (size_t i = 0; i < symbols.size(); i++) {
+    for (size_t i = 0; i < symbolKeys.size(); i++) {
         if (quantities[i] > 0) {
             StockHolding h;
-            h.symbol = symbols[i];
+            h.symbol = symbolTable().name(symbolKeys[i]);
             h.quantity = quantities[i];
             holdings.push_back(h);
         }
@@ -130,9 +194,9 @@ UserRecord User::toRecord() const {
     rec.cashBalance = cashBalance;
     
     // Convert holdings
-    rec.numHoldings = min((int)symbols.size(), 50);
+    rec.numHoldings = min((int)symbolKeys.size(), 50);
     for (int i = 0; i < rec.numHoldings; i++) {
-        strncpy(rec.holdings[i].symbol, symbols[i].c_str(), 31);
+        strncpy(rec.holdings[i].symbol, symbolTable().name(symbolKeys[i]).c_str(), 31);
         rec.holdings[i].quantity = quantities[i];
     }
     
@@ -146,13 +210,98 @@ UserRecord User::toRecord() const {
 }
 
 User User::fromRecord(const UserRecord& rec) {
-    User user(string(rec.userID), rec.cashBalance);
+    User user(string(rec.userID), 0);
+    user.cashBalance = rec.cashBalance;
     
     // Restore holdings
     for (int i = 0; i < rec.numHoldings; i++) {
-        user.symbols.push_back(string(rec.holdings[i].symbol));
-        user.quantities.push_back(rec.holdings[i].quantity);
+        string symbol(rec.holdings[i].symbol, strnlen(rec.holdings[i].symbol, sizeof(rec.holdings[i].symbol)));
+        user.addStock(symbol, rec.holdings[i].quantity);
     }
     
     return user;
-}
\ No newline at end of file
+}
+
+void User::toCompact(vector<char>& out) const {
+    out.clear();
+    out.push_back((char)COMPACT_VERSION);
+    // createUser rejects longer IDs, so this never cuts one short
+    uint8_t idLen = (uint8_t)min<size_t>(userID.size(), MAX_ID_LENGTH);
+    out.push_back((char)idLen);
+    out.insert(out.end(), userID.data(), userID.data() + idLen);
+
+    int64_t cash = cashBalance;
+    const char* c = reinterpret_cast<const char*>(&cash);
+    out.insert(out.end(), c, c + sizeof(cash));
+
+    // Sold-out holdings stay in place and quantities are fixed width, so
+    // a trade never moves the holdings after the one it touched
+    putVarint(out, symbolKeys.size());
+    for (size_t i = 0; i < symbolKeys.size(); i++) {
+        putVarint(out, symbolKeys[i]);
+        int32_t qty = quantities[i];
+        const char* q = reinterpret_cast<const char*>(&qty);
+        out.insert(out.end(), q, q + sizeof(qty));
+    }
+
+    // activeOrders is in swap-remove order; encode it sorted so a new
+    // order (highest ID) only adds bytes at the end
+    vector<int> ids = activeOrders;
+    sort(ids.begin(), ids.end());
+    putVarint(out, ids.size());
+    int64_t prev = 0;
+    for (int id : ids) {
+        putSignedVarint(out, (int64_t)id - prev);
+        prev = id;
+    }
+}
+
+bool User::fromCompact(const char* p, size_t n, User& out) {
+    // Version 1 stored quantities as zigzag varints
+    uint8_t version = n > 0 ? (uint8_t)p[0] : 0;
+    if (n < 2 || version < 1 || version > COMPACT_VERSION) return false;
+    size_t idLen = (uint8_t)p[1];
+    size_t pos = 2 + idLen;
+    if (pos + sizeof(int64_t) > n) return false;
+
+    User user(string(p + 2, idLen), 0);
+    int64_t cash;
+    memcpy(&cash, p + pos, sizeof(cash));
+    user.cashBalance = cash;
+    pos += sizeof(cash);
+
+    uint64_t count;
+    if (!getVarint(p, n, pos, count)) return false;
+    for (uint64_t i = 0; i < count; i++) {
+        uint64_t key;
+        int64_t qty;
+        if (!getVarint(p, n, pos, key)) return false;
+        if (version == 1) {
+            if (!getSignedVarint(p, n, pos, qty)) return false;
+        } else {
+            int32_t q;
+            if (pos + sizeof(q) > n) return false;
+            memcpy(&q, p + pos, sizeof(q));
+            pos += sizeof(q);
+            qty = q;
+        }
+        const string& symbol = symbolTable().name((uint32_t)key);
+        if (symbol.empty()) {
+            LOG_WARN("User " << user.userID << ": holding with unknown symbol key " << key << " dropped");
+            continue;
+        }
+        user.addStock((uint32_t)key, (int)qty);
+    }
+
+    if (!getVarint(p, n, pos, count)) return false;
+    int64_t id = 0;
+    for (uint64_t i = 0; i < count; i++) {
+        int64_t delta;
+        if (!getSignedVarint(p, n, pos, delta)) return false;
+        id += delta;
+        user.addActiveOrder((int)id);
+    }
+
+    out = std::move(user);
+    return true;
+}
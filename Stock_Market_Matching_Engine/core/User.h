@@ -4,17 +4,22 @@
 #include <string>
 #include <sstream>
 #include <vector>
+#include <cstdint>
 #include <iostream>
 #include "Order.h"
+#include "Intern.h"
+#include "../data_structures/MyHashMap.h"
 
 using namespace std;
 struct StockHolding {
     string symbol;
     int quantity;
 };
+// Fixed layout of the original data/users.dat; now only read to migrate
+// an old file (see UserStorage). Holds at most 50 holdings / 100 orders.
 struct UserRecord {
     char userID[64];
-    double cashBalance;
+    int64_t cashBalance;   // fixed-point Money
     
     // Holdings
     int numHoldings;
@@ -34,45 +39,87 @@ struct UserRecord {
 class User {
 private:
     string userID;
-    double cashBalance;
-    vector<string> symbols;
+    Money cashBalance;
+    // Holdings as parallel arrays, found through symbol key -> position
+    // instead of comparing names; a market maker can hold thousands
+    vector<uint32_t> symbolKeys;   // symbolTable() keys
     vector<int> quantities;
+    MyHashMap<uint32_t, uint32_t> holdingAt{0};
+
+    // Active orders in no particular order; orderID -> position lets
+    // removal swap with the last one instead of searching
     vector<int> activeOrders;
+    MyHashMap<int, uint32_t> activeOrderAt{0};
+
+    // Changed since it was last written to UserStorage; the engine's user
+    // flusher uses it to write each user once per interval
+    bool dirty = false;
+
+    void reindex();   // rebuild holdingAt / activeOrderAt from the arrays
     
 public:
     User();
     User(const string& uid, double cash);
+    // MyHashMap does not copy; copies rebuild the indexes instead
+    User(const User& other);
+    User& operator=(const User& other);
     
-    // Cash management
-    bool deductCash(double amount);
-    void addCash(double amount);
+    // Cash management (fixed-point Money; getCashBalance() is for display)
+    bool deductCash(Money amount);
+    void addCash(Money amount);
+    Money getCash() const;
     double getCashBalance() const;
     
     // Stock management
     void addStock(const string& symbol, int qty);
     bool removeStock(const string& symbol, int qty);
     int getStockQuantity(const string& symbol) const;
+
+    // Same by symbolTable() key, for callers that already have one
+    void addStock(uint32_t symbolKey, int qty);
+    bool removeStock(uint32_t symbolKey, int qty);
+    int getStockQuantity(uint32_t symbolKey) const;
     
     // Order management
     void addActiveOrder(int orderID);
     void removeActiveOrder(int orderID);
+    void clearActiveOrders();
     
     // Getters
     string getUserID() const;
     vector<int> getActiveOrderIDs() const;
     vector<StockHolding> getAllHoldings() const ;
     
-    // Helper
+    // Helper: position of a holding, -1 if none
     int findSymbol(const string& symbol) const;
+    int findSymbol(uint32_t symbolKey) const;
     
     // Display
     string toString() const;
 
+    bool isDirty() const { return dirty; }
+    void setDirty(bool d) { dirty = d; }
+
     User clone() const { return *this; }
 
     static User fromRecord(const UserRecord& rec);
     UserRecord toRecord() const;
 
+    // Compact encoding stored by UserStorage:
+    //   [u8 version][u8 idLen][id][i64 cash]
+    //   [varint n]{[varint symbolKey][i32 quantity]}      holdings, incl. zero
+    //   [varint n]{[zigzag delta from previous ID]}        active orders, sorted
+    // Cash and quantities are fixed width and holdings keep their order
+    // (sold-out ones included), so a balance or quantity change only
+    // rewrites its own bytes. Active orders come last: a new order adds
+    // bytes at the end, removing one shifts the orders after it. Version 1
+    // (still readable) had zigzag varint quantities. Symbols are
+    // symbolTable() keys.
+    static constexpr uint8_t COMPACT_VERSION = 2;
+    static constexpr size_t MAX_ID_LENGTH = UINT8_MAX;   // idLen is one byte
+    void toCompact(vector<char>& out) const;
+    static bool fromCompact(const char* p, size_t n, User& out);
+
 
     
 };
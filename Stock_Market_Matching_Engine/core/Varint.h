@@ -0,0 +1,52 @@
+#ifndef VARINT_H
+#define VARINT_H
+
+#include <cstdint>
+#include <cstddef>
+#include <vector>
+
+using namespace std;
+
+// LEB128 varints: 7 bits per byte, high bit = more bytes follow. Signed
+// values go through zigzag first so small negatives stay short.
+
+inline uint64_t zigzag(int64_t v) {
+    return ((uint64_t)v << 1) ^ (uint64_t)(v >> 63);
+}
+
+inline int64_t unzigzag(uint64_t v) {
+    return (int64_t)(v >> 1) ^ -(int64_t)(v & 1);
+}
+
+inline void putVarint(vector<char>& out, uint64_t v) {
+    while (v >= 0x80) {
+        out.push_back((char)(v | 0x80));
+        v >>= 7;
+    }
+    out.push_back((char)v);
+}
+
+inline void putSignedVarint(vector<char>& out, int64_t v) {
+    putVarint(out, zigzag(v));
+}
+
+// Reads one varint at p[pos], advancing pos. False if the input ends
+// mid-value or the value runs past 64 bits.
+inline bool getVarint(const char* p, size_t n, size_t& pos, uint64_t& v) {
+    v = 0;
+    for (int shift = 0; shift < 64 && pos < n; shift += 7) {
+        uint8_t b = (uint8_t)p[pos++];
+        v |= (uint64_t)(b & 0x7F) << shift;
+        if (!(b & 0x80)) return true;
+    }
+    return false;
+}
+
+inline bool getSignedVarint(const char* p, size_t n, size_t& pos, int64_t& v) {
+    uint64_t u;
+    if (!getVarint(p, n, pos, u)) return false;
+    v = unzigzag(u);
+    return true;
+}
+
+#endif
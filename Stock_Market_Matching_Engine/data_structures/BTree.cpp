@@ -1,9 +1,10 @@
 // btree.cpp
 #include "BTree.h"
+#include "../core/Log.h"
 #include <iostream>
 using namespace std;
 
-BTree::BTree(int _t) {
+BTree::BTree(int _t, OrderPools* p) : PriceIndex(p) {
     root = new BTreeNode(true);
     t = _t;
 }
@@ -16,7 +17,7 @@ void BTree::traverse(BTreeNode* node) {
         
         // Only print if queue has orders
         if (node->queues[i] && node->queues[i]->getSize() > 0) {
-            cout << node->keys[i] << " ";
+            cout << toDouble(node->keys[i]) << " ";
         }
     }
     if (!node->isLeaf) traverse(node->children[i]);
@@ -27,8 +28,7 @@ void BTree::print() {
     cout << endl;
 }
 
-BTreeNode* BTree::search(BTreeNode* node, double key) {
-    cout << "Here in Search Node\n";
+BTreeNode* BTree::search(BTreeNode* node, Price key) {
     if (!node) return nullptr;
     int i = 0;
     while (i < node->numKeys && key > node->keys[i]) i++;
@@ -40,49 +40,51 @@ BTreeNode* BTree::search(BTreeNode* node, double key) {
     return search(node->children[i], key);
 }
 
-OrderQueue* BTree::search(double key) {
-    cout << "Here in Search (key=" << key << ")\n";
+OrderQueue* BTree::search(Price key) {
     
     BTreeNode* node = search(root, key);
     
     if (!node) {
-        cout << "Node not found for key=" << key << "\n";
+        LOG_DEBUG("BTree::search: no node for key=" << key);
         return nullptr;
     }
-    
-    cout << "Back in search, node found, scanning keys\n";
-    
+
     for (int i = 0; i < node->numKeys; i++) {
-        cout << "  checking node->keys[" << i << "]=" << node->keys[i] << "\n";
-        
         if (node->keys[i] == key) {
-            cout << "  key match! queue=" << (void*)node->queues[i] 
-                 << " size=" << (node->queues[i] ? node->queues[i]->getSize() : -1) << "\n";
+            LOG_DEBUG("BTree::search: key=" << key << " queue=" << (void*)node->queues[i]
+                      << " size=" << (node->queues[i] ? node->queues[i]->getSize() : -1));
             return node->queues[i];
         }
     }
-    
-    cout << "Key not found in node keys\n";
+
+    LOG_DEBUG("BTree::search: key=" << key << " not in node keys");
     return nullptr;
 }
 
 // Insert
-void BTree::insert(double key, DiskOffset offset)
+OrderNode* BTree::insert(Price key, DiskOffset offset, int orderID)
 {
+    // Existing level (its key may sit in an internal node): just queue up.
+    // insertNonFull below only ever adds new keys.
+    if (OrderQueue* level = search(key)) {
+        LOG_DEBUG("BTree::insert: enqueuing offset="<<offset<<" at existing key="<<key);
+        return level->enqueue(offset, orderID);
+    }
+
     BTreeNode* r = root;
     if (r->numKeys == MAX_KEYS) {
         BTreeNode* s = new BTreeNode(false);
         s->children[0] = r;
         root = s;
         splitChild(s, 0, r);
-        insertNonFull(s, key, offset);
+        return insertNonFull(s, key, offset, orderID);
     } else {
-        insertNonFull(r, key, offset);
+        return insertNonFull(r, key, offset, orderID);
     }
 }
 
 
-void BTree::insertNonFull(BTreeNode* node, double key, DiskOffset offset) {
+OrderNode* BTree::insertNonFull(BTreeNode* node, Price key, DiskOffset offset, int orderID) {
     int i = node->numKeys - 1;
 
     if (node->isLeaf) {
@@ -92,16 +94,11 @@ void BTree::insertNonFull(BTreeNode* node, double key, DiskOffset offset) {
             i--;
         }
 
-           if (i >= 0 && node->keys[i] == key) {
-        std::cerr << "[DBG] BTree::insert: enqueuing offset="<<offset<<" at existing key="<<key<<"\n";
-        node->queues[i]->enqueue(offset);
-    } else {
-            std::cerr << "[DBG] BTree::insert: creating new queue at key="<<key<<" offset="<<offset<<"\n";
-            node->keys[i + 1] = key;
-            node->queues[i + 1] = new OrderQueue();
-            node->queues[i + 1]->enqueue(offset);
-            node->numKeys++;
-        }
+        LOG_DEBUG("BTree::insert: creating new queue at key="<<key<<" offset="<<offset);
+        node->keys[i + 1] = key;
+        node->queues[i + 1] = createQueue(pools);
+        node->numKeys++;
+        return node->queues[i + 1]->enqueue(offset, orderID);
     } else {
         while (i >= 0 && node->keys[i] > key) i--;
         i++;
@@ -110,7 +107,7 @@ void BTree::insertNonFull(BTreeNode* node, double key, DiskOffset offset) {
             splitChild(node, i, node->children[i]);
             if (node->keys[i] < key) i++;
         }
-        insertNonFull(node->children[i], key, offset);
+        return insertNonFull(node->children[i], key, offset, orderID);
     }
 }
 
@@ -160,10 +157,10 @@ void BTree::splitChild(BTreeNode* parent, int i, BTreeNode* y) {
 DiskOffset BTree::getBest() {
     if (!root || root->numKeys == 0) return 0;
 
-    double price = getHighestKey();
-    double lowest = getLowestKey();
+    Price price = getHighestKey();
+    Price lowest = getLowestKey();
 
-    while (price != -1 && price >= lowest) {
+    while (price != NO_PRICE && price >= lowest) {
         OrderQueue* q = search(price);
         if (q && q->getSize() > 0) {
             while (q->getSize() > 0) {
@@ -178,8 +175,8 @@ DiskOffset BTree::getBest() {
 }
 
 
-double BTree::getLowestKey() {
-    if (!root || root->numKeys == 0) return -1;
+Price BTree::getLowestKey() {
+    if (!root || root->numKeys == 0) return NO_PRICE;
 
     BTreeNode* curr = root;
     while (!curr->isLeaf) {
@@ -189,8 +186,8 @@ double BTree::getLowestKey() {
     return curr->keys[0]; // smallest key in leftmost leaf
 }
 
-double BTree::getHighestKey() {
-    if (!root || root->numKeys == 0) return -1;
+Price BTree::getHighestKey() {
+    if (!root || root->numKeys == 0) return NO_PRICE;
 
     BTreeNode* curr = root;
     while (!curr->isLeaf) {
@@ -200,11 +197,11 @@ double BTree::getHighestKey() {
     return curr->keys[curr->numKeys - 1]; // largest key in rightmost leaf
 }
 
-double BTree::nextKey(double price) {
-    if (!root || root->numKeys == 0) return -1;
+Price BTree::nextKey(Price price) {
+    if (!root || root->numKeys == 0) return NO_PRICE;
 
     BTreeNode* curr = root;
-    double successor = -1;
+    Price successor = NO_PRICE;
 
     while (curr != nullptr) {
         int i = 0;
@@ -218,63 +215,63 @@ double BTree::nextKey(double price) {
         curr = curr->children[i];
     }
 
-    // If successor equals price or wasn't found, return -1
-    if (successor <= price) return -1;
+    // If successor equals price or wasn't found, return NO_PRICE
+    if (successor <= price) return NO_PRICE;
     return successor;
 }
 
 DiskOffset BTree::getBestSell() {
     if (!root || root->numKeys == 0) return 0;
 
-    double price = getLowestKey();
-    double highest = getHighestKey();
+    Price price = getLowestKey();
+    Price highest = getHighestKey();
     
-    std::cerr << "[DBG] getBestSell: starting with price=" << price 
-              << " highest=" << highest << "\n";
+    LOG_DEBUG("getBestSell: starting with price=" << price 
+              << " highest=" << highest);
 
-    while (price != -1 && price <= highest) {
-        std::cerr << "[DBG] getBestSell: checking price=" << price << "\n";
+    while (price != NO_PRICE && price <= highest) {
+        LOG_DEBUG("getBestSell: checking price=" << price);
         
         OrderQueue* q = search(price);
         
-        std::cerr << "[DBG] getBestSell: queue=" << (void*)q 
-                  << " size=" << (q ? q->getSize() : -1) << "\n";
+        LOG_DEBUG("getBestSell: queue=" << (void*)q 
+                  << " size=" << (q ? q->getSize() : -1));
         
         if (q && q->getSize() > 0) {
             while (q->getSize() > 0) {
                 DiskOffset off = q->peek();
-                std::cerr << "[DBG] getBestSell: peek=" << off << "\n";
+                LOG_DEBUG("getBestSell: peek=" << off);
                 if (off == 0) { 
-                    std::cerr << "[DBG] getBestSell: offset 0, dequeueing\n";
+                    LOG_DEBUG("getBestSell: offset 0, dequeueing");
                     q->dequeue(); 
                     continue; 
                 }
-                std::cerr << "[DBG] getBestSell: returning offset=" << off << "\n";
+                LOG_DEBUG("getBestSell: returning offset=" << off);
                 return off;
             }
         }
         
-        double oldPrice = price;
+        Price oldPrice = price;
         price = nextKey(price);
         
-        std::cerr << "[DBG] getBestSell: nextKey(" << oldPrice << ") = " << price << "\n";
+        LOG_DEBUG("getBestSell: nextKey(" << oldPrice << ") = " << price);
         
         // ✅ ADD: Prevent infinite loop
         if (price == oldPrice) {
-            std::cerr << "[ERR] getBestSell: nextKey returned same price, breaking\n";
+            LOG_ERROR("getBestSell: nextKey returned same price, breaking");
             break;
         }
     }
     
-    std::cerr << "[DBG] getBestSell: no valid orders found, returning 0\n";
+    LOG_DEBUG("getBestSell: no valid orders found, returning 0");
     return 0;
 }
 
-double BTree::prevKey(double price) {
-    if (!root) return -1;
+Price BTree::prevKey(Price price) {
+    if (!root) return NO_PRICE;
 
     BTreeNode* curr = root;
-    double predecessor = -1;
+    Price predecessor = NO_PRICE;
 
     while (curr != nullptr) {
         int i = curr->numKeys - 1;
@@ -299,12 +296,12 @@ double BTree::prevKey(double price) {
     return predecessor;
 }
 
-static void freeBTreeNode(BTreeNode* node) {
+static void freeBTreeNode(BTreeNode* node, OrderPools* pools) {
     if (!node) return;
     // delete queues owned by this node
     for (int i = 0; i < node->numKeys; ++i) {
         if (node->queues[i]) {
-            delete node->queues[i];
+            destroyQueue(pools, node->queues[i]);
             node->queues[i] = nullptr;
         }
     }
@@ -312,7 +309,7 @@ static void freeBTreeNode(BTreeNode* node) {
     if (!node->isLeaf) {
         for (int i = 0; i <= node->numKeys; ++i) {
             if (node->children[i]) {
-                freeBTreeNode(node->children[i]);
+                freeBTreeNode(node->children[i], pools);
                 node->children[i] = nullptr;
             }
         }
@@ -322,12 +319,12 @@ static void freeBTreeNode(BTreeNode* node) {
 
 BTree::~BTree() {
     if (root) {
-        freeBTreeNode(root);
+        freeBTreeNode(root, pools);
         root = nullptr;
     }
 }
 
-void BTree::removeOrder(double price, DiskOffset offset) {
+void BTree::removeOrder(Price price, DiskOffset offset) {
     OrderQueue* queue = search(price);
     if (queue) {
         queue->remove(offset);
@@ -2,37 +2,38 @@
 #define BTREE_H
 
 #include "BTreeNode.h"
+#include "PriceIndex.h"
 #include "../storage/DiskTypes.h"
 
-class BTree {
+class BTree : public PriceIndex {
 private:
     BTreeNode* root;
     int t;
 
     void traverse(BTreeNode* node);
-    BTreeNode* search(BTreeNode* node, double key);
-    void insertNonFull(BTreeNode* node, double key, DiskOffset offset);
+    BTreeNode* search(BTreeNode* node, Price key);
+    OrderNode* insertNonFull(BTreeNode* node, Price key, DiskOffset offset, int orderID);
     void splitChild(BTreeNode* parent, int i, BTreeNode* child);
 
 public:
-    BTree(int _t);
+    BTree(int _t, OrderPools* p = nullptr);
 
-    void insert(double key, DiskOffset offset);
-    OrderQueue* search(double key);
+    OrderNode* insert(Price key, DiskOffset offset, int orderID = 0) override;
+    OrderQueue* search(Price key) override;
 
-    void print();
+    void print() override;
 
-    DiskOffset getBest();       // BUY side
-    DiskOffset getBestSell();   // SELL side
+    DiskOffset getBest() override;       // BUY side
+    DiskOffset getBestSell() override;   // SELL side
 
-    double getLowestKey();
-    double getHighestKey();
-    double nextKey(double price);
-    double prevKey(double price);
+    Price getLowestKey() override;
+    Price getHighestKey() override;
+    Price nextKey(Price price) override;
+    Price prevKey(Price price) override;
     //static void freeBTreeNode(BTreeNode* node);
     
-    void removeOrder(double price, DiskOffset offset);
-    ~BTree();
+    void removeOrder(Price price, DiskOffset offset) override;
+    ~BTree() override;
 };
 
 #endif
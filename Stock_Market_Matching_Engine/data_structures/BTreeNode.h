@@ -3,12 +3,13 @@
 
 #include "OrderQueue.h"
 #include "../storage/DiskTypes.h"
+#include "../core/Price.h"
 
 const int MAX_KEYS = 5;
 
 struct BTreeNode {
     int numKeys;
-    double keys[MAX_KEYS];
+    Price keys[MAX_KEYS];
     OrderQueue* queues[MAX_KEYS];     // queues of DiskOffset
     BTreeNode* children[MAX_KEYS + 1];
     bool isLeaf;
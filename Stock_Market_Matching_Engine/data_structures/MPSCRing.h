@@ -0,0 +1,88 @@
+#ifndef MPSC_RING_H
+#define MPSC_RING_H
+
+#include <atomic>
+#include <cstddef>
+#include <utility>
+#include <vector>
+
+// Bounded lock-free queue for many producers and one consumer.
+//
+// Each slot carries a sequence number: seq == pos means the slot is free for
+// the producer holding ticket pos, seq == pos + 1 means it holds an item for
+// the consumer. Producers claim tickets with a CAS on tail; the consumer owns
+// head outright. Capacity is rounded up to a power of two.
+template <typename T>
+class MPSCRing {
+private:
+    struct Slot {
+        std::atomic<size_t> sequence;
+        T value;
+    };
+
+    std::vector<Slot> slots;
+    size_t mask;
+
+    alignas(64) std::atomic<size_t> tail;   // next ticket for producers
+    alignas(64) size_t head;                // consumer only
+
+public:
+    explicit MPSCRing(size_t capacity = 1024) : head(0) {
+        size_t cap = 2;
+        while (cap < capacity) cap <<= 1;
+        slots = std::vector<Slot>(cap);
+        mask = cap - 1;
+        for (size_t i = 0; i < cap; i++) {
+            slots[i].sequence.store(i, std::memory_order_relaxed);
+        }
+        tail.store(0, std::memory_order_relaxed);
+    }
+
+    MPSCRing(const MPSCRing&) = delete;
+    MPSCRing& operator=(const MPSCRing&) = delete;
+
+    // Returns false when the ring is full
+    bool tryPush(T item) {
+        size_t pos = tail.load(std::memory_order_relaxed);
+        Slot* slot;
+
+        while (true) {
+            slot = &slots[pos & mask];
+            size_t seq = slot->sequence.load(std::memory_order_acquire);
+            intptr_t diff = (intptr_t)seq - (intptr_t)pos;
+
+            if (diff == 0) {
+                if (tail.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) break;
+            } else if (diff < 0) {
+                return false;
+            } else {
+                pos = tail.load(std::memory_order_relaxed);
+            }
+        }
+
+        slot->value = std::move(item);
+        slot->sequence.store(pos + 1, std::memory_order_release);
+        return true;
+    }
+
+    // Consumer side only
+    bool tryPop(T& out) {
+        Slot* slot = &slots[head & mask];
+        size_t seq = slot->sequence.load(std::memory_order_acquire);
+        if (seq != head + 1) return false;
+
+        out = std::move(slot->value);
+        slot->sequence.store(head + slots.size(), std::memory_order_release);
+        head++;
+        return true;
+    }
+
+    bool empty() const {
+        const Slot& slot = slots[head & mask];
+        return slot.sequence.load(std::memory_order_acquire) != head + 1;
+    }
+
+    size_t capacity() const { return slots.size(); }
+};
+
+#endif
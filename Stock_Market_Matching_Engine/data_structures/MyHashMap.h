@@ -4,302 +4,238 @@
 #include <functional>
 #include <stdexcept>
 #include <cstring>
-#include "HashNode.h"
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <utility>
 #include <vector>
 using namespace std;
-template <typename K, typename V>
+
+// Hashing / equality used by MyHashMap. The string and const char*
+// versions take a string_view so either kind of key can be looked up
+// without building a temporary std::string.
+template <typename K>
+struct MyHashKey {
+    static size_t hash(const K& key) { return std::hash<K>{}(key); }
+    static bool equal(const K& stored, const K& key) { return stored == key; }
+};
+
+template <>
+struct MyHashKey<string> {
+    static size_t hash(string_view key) { return std::hash<string_view>{}(key); }
+    static bool equal(const string& stored, string_view key) { return key == stored; }
+};
+
+template <>
+struct MyHashKey<const char*> {
+    static size_t hash(string_view key) { return std::hash<string_view>{}(key); }
+    static bool equal(const char* stored, string_view key) { return key == stored; }
+};
+
+// Open-addressing hash map with Robin Hood probing.
+//
+// Entries live inline in one array (no node per entry). Each slot records
+// how far it sits from its home bucket; on insert a "poorer" entry (further
+// from home) takes the slot of a richer one, which keeps probe lengths short
+// and lets a lookup stop as soon as it meets a richer slot. Removal shifts the
+// following run back instead of leaving tombstones. The table doubles when
+// it passes 7/8 full.
+//
+// The constructor argument is only an initial size hint.
+template <typename K, typename V, typename Traits = MyHashKey<K>>
 class MyHashMap {
 private:
-    HashNode<K, V>** table;
+    struct Slot {
+        K key;
+        V value;
+    };
+
+    vector<Slot> slots;
+    vector<uint8_t> dist;   // 0 = empty, otherwise probe distance + 1
+    size_t mask;
+    int shift;              // 64 - log2(capacity)
     int capacity;
     int size;
-    
-    // Generic hash function using std::hash
-    size_t hashFunction(const K& key) const {
-        return std::hash<K>{}(key) % capacity;
+
+    static const uint8_t MAX_DIST = 255;
+
+    // Fibonacci hashing spreads identity hashes (e.g. std::hash<int>)
+    size_t homeOf(size_t h) const {
+        return (size_t)(((uint64_t)h * 0x9E3779B97F4A7C15ull) >> shift);
     }
-    
-    // Key comparison - works for any type with == operator
-    bool keysEqual(const K& k1, const K& k2) const {
-        return k1 == k2;
+
+    void allocate(int cap) {
+        int bits = 3;
+        while ((1 << bits) < cap) bits++;
+        capacity = 1 << bits;
+        mask = capacity - 1;
+        shift = 64 - bits;
+        slots.assign(capacity, Slot{});
+        dist.assign(capacity, 0);
+        size = 0;
     }
 
-public:
-    MyHashMap(int cap = 100) : capacity(cap), size(0) {
-        table = new HashNode<K, V>*[capacity];
-        for (int i = 0; i < capacity; i++) {
-            table[i] = nullptr;
+    template <typename Q>
+    long indexOf(const Q& key) const {
+        size_t i = homeOf(Traits::hash(key));
+        unsigned d = 1;
+        while (d <= dist[i]) {
+            if (d == dist[i] && Traits::equal(slots[i].key, key)) return (long)i;
+            i = (i + 1) & mask;
+            d++;
         }
+        return -1;
     }
-    
-    void insert(const K& key, const V& value) {
-        int index = hashFunction(key);
-        
-        // Check if key already exists
-        HashNode<K, V>* current = table[index];
-        while (current != nullptr) {
-            if (keysEqual(current->key, key)) {
-                current->value = value; // Update existing value
-                return;
-            }
-            current = current->next;
+
+    void grow() {
+        vector<Slot> oldSlots;
+        vector<uint8_t> oldDist;
+        oldSlots.swap(slots);
+        oldDist.swap(dist);
+
+        allocate(capacity * 2);
+        for (size_t i = 0; i < oldSlots.size(); i++) {
+            if (oldDist[i]) place(std::move(oldSlots[i]));
         }
-        
-        // Insert new node at the beginning of the chain
-        HashNode<K, V>* node = new HashNode<K, V>(key, value);
-        node->next = table[index];
-        table[index] = node;
-        size++;
     }
-    
-    V get(const K& key) const {
-        int index = hashFunction(key);
-        HashNode<K, V>* head = table[index];
-        
-        while (head != nullptr) {
-            if (keysEqual(head->key, key)) {
-                return head->value;
+
+    // Insert a key known to be absent
+    void place(Slot cur) {
+        size_t i = homeOf(Traits::hash(cur.key));
+        unsigned d = 1;
+
+        while (true) {
+            if (dist[i] == 0) {
+                slots[i] = std::move(cur);
+                dist[i] = (uint8_t)d;
+                size++;
+                return;
             }
-            head = head->next;
-        }
-        
-        // Return default-constructed value (nullptr for pointers)
-        return V();
-    }
-    
-    // Alternative: return pointer or optional-like behavior
-    bool get(const K& key, V& outValue) const {
-        int index = hashFunction(key);
-        HashNode<K, V>* head = table[index];
-        
-        while (head != nullptr) {
-            if (keysEqual(head->key, key)) {
-                outValue = head->value;
-                return true;
+            if (dist[i] < d) {
+                std::swap(cur, slots[i]);
+                unsigned displaced = dist[i];
+                dist[i] = (uint8_t)d;
+                d = displaced;
             }
-            head = head->next;
-        }
-        
-        return false;
-    }
-    
-    void remove(const K& key) {
-        int index = hashFunction(key);
-        HashNode<K, V>* head = table[index];
-        HashNode<K, V>* prev = nullptr;
-        
-        while (head != nullptr) {
-            if (keysEqual(head->key, key)) {
-                if (prev == nullptr) {
-                    table[index] = head->next;
-                } else {
-                    prev->next = head->next;
-                }
-                delete head;
-                size--;
+            i = (i + 1) & mask;
+            d++;
+
+            if (d >= MAX_DIST) {
+                // Pathological run: make room and start this entry over
+                grow();
+                place(std::move(cur));
                 return;
             }
-            prev = head;
-            head = head->next;
         }
     }
-    
-    bool contains(const K& key) const {
-        int index = hashFunction(key);
-        HashNode<K, V>* head = table[index];
-        
-        while (head != nullptr) {
-            if (keysEqual(head->key, key)) {
-                return true;
-            }
-            head = head->next;
-        }
-        
-        return false;
-    }
-    
-    int getSize() const {
-        return size;
-    }
-    
-    bool isEmpty() const {
-        return size == 0;
-    }
-    vector<K> getAllKeys() const {
-        vector<K> keys;
-        keys.reserve(size);
 
-        for (int i = 0; i < capacity; i++) {
-            HashNode<K, V>* curr = table[i];
-            while (curr != nullptr) {
-                keys.push_back(curr->key);
-                curr = curr->next;
-            }
-        }
-        return keys;
+public:
+    MyHashMap(int cap = 100) {
+        allocate(cap + cap / 7 + 1);
     }
 
-    ~MyHashMap() {
-        for (int i = 0; i < capacity; i++) {
-            HashNode<K, V>* head = table[i];
-            while (head != nullptr) {
-                HashNode<K, V>* temp = head;
-                head = head->next;
-                delete temp;
-            }
+    void insert(const K& key, const V& value) {
+        long idx = indexOf(key);
+        if (idx >= 0) {
+            slots[idx].value = value; // Update existing value
+            return;
         }
-        delete[] table;
+
+        if ((size + 1) * 8 > capacity * 7) grow();
+        place(Slot{key, value});
     }
-    
-    // Prevent copying (optional, but recommended for resource management)
-    MyHashMap(const MyHashMap&) = delete;
-    MyHashMap& operator=(const MyHashMap&) = delete;
-};
 
-// Specialization for const char* keys
-template <typename V>
-class MyHashMap<const char*, V> {
-private:
-    HashNode<const char*, V>** table;
-    int capacity;
-    int size;
-    
-    size_t hashFunction(const char* key) const {
-        unsigned long hash = 5381;
-        for (int i = 0; key[i] != '\0'; i++) {
-            hash = ((hash << 5) + hash) + key[i];
-        }
-        return hash % capacity;
+    // Single probe: pointer to the value, or nullptr if absent
+    template <typename Q>
+    V* find(const Q& key) {
+        long idx = indexOf(key);
+        return idx >= 0 ? &slots[idx].value : nullptr;
     }
-    
-    bool keysEqual(const char* k1, const char* k2) const {
-        return strcmp(k1, k2) == 0;
+
+    template <typename Q>
+    const V* find(const Q& key) const {
+        long idx = indexOf(key);
+        return idx >= 0 ? &slots[idx].value : nullptr;
     }
 
-public:
-    MyHashMap(int cap = 100) : capacity(cap), size(0) {
-        table = new HashNode<const char*, V>*[capacity];
-        for (int i = 0; i < capacity; i++) {
-            table[i] = nullptr;
-        }
+    // Returns a default-constructed value (nullptr for pointers) if absent
+    template <typename Q>
+    V get(const Q& key) const {
+        const V* v = find(key);
+        return v ? *v : V();
     }
-    
-    void insert(const char* key, const V& value) {
-        int index = hashFunction(key);
-        
-        HashNode<const char*, V>* current = table[index];
-        while (current != nullptr) {
-            if (keysEqual(current->key, key)) {
-                current->value = value;
-                return;
-            }
-            current = current->next;
-        }
-        
-        HashNode<const char*, V>* node = new HashNode<const char*, V>(key, value);
-        node->next = table[index];
-        table[index] = node;
-        size++;
+
+    template <typename Q>
+    bool get(const Q& key, V& outValue) const {
+        const V* v = find(key);
+        if (!v) return false;
+        outValue = *v;
+        return true;
     }
-    
-    V get(const char* key) const {
-        int index = hashFunction(key);
-        HashNode<const char*, V>* head = table[index];
-        
-        while (head != nullptr) {
-            if (keysEqual(head->key, key)) {
-                return head->value;
+
+    template <typename Q>
+    void remove(const Q& key) {
+        long idx = indexOf(key);
+        if (idx < 0) return;
+
+        // Backward-shift the rest of the run into the hole
+        size_t i = (size_t)idx;
+        while (true) {
+            size_t next = (i + 1) & mask;
+            if (dist[next] <= 1) {
+                slots[i] = Slot{};
+                dist[i] = 0;
+                break;
             }
-            head = head->next;
+            slots[i] = std::move(slots[next]);
+            dist[i] = dist[next] - 1;
+            i = next;
         }
-        
-        // Return default-constructed value (nullptr for pointers)
-        return V();
+        size--;
     }
-    
-    bool get(const char* key, V& outValue) const {
-        int index = hashFunction(key);
-        HashNode<const char*, V>* head = table[index];
-        
-        while (head != nullptr) {
-            if (keysEqual(head->key, key)) {
-                outValue = head->value;
-                return true;
-            }
-            head = head->next;
-        }
-        
-        return false;
+
+    template <typename Q>
+    bool contains(const Q& key) const {
+        return indexOf(key) >= 0;
     }
-    
-    void remove(const char* key) {
-        int index = hashFunction(key);
-        HashNode<const char*, V>* head = table[index];
-        HashNode<const char*, V>* prev = nullptr;
-        
-        while (head != nullptr) {
-            if (keysEqual(head->key, key)) {
-                if (prev == nullptr) {
-                    table[index] = head->next;
-                } else {
-                    prev->next = head->next;
-                }
-                delete head;
-                size--;
-                return;
-            }
-            prev = head;
-            head = head->next;
-        }
+
+    void reserve(int n) {
+        while (n * 8 > capacity * 7) grow();
     }
-    
-    bool contains(const char* key) const {
-        int index = hashFunction(key);
-        HashNode<const char*, V>* head = table[index];
-        
-        while (head != nullptr) {
-            if (keysEqual(head->key, key)) {
-                return true;
-            }
-            head = head->next;
-        }
-        
-        return false;
+
+    // Drop every entry and shrink back to room for about cap of them
+    void clear(int cap = 0) {
+        allocate(cap + cap / 7 + 1);
     }
-    
+
     int getSize() const {
         return size;
     }
-    
+
     bool isEmpty() const {
         return size == 0;
     }
-    vector<const char*> getAllKeys() const {
-        vector<const char*> keys;
+
+    vector<K> getAllKeys() const {
+        vector<K> keys;
         keys.reserve(size);
 
         for (int i = 0; i < capacity; i++) {
-            HashNode<const char*, V>* curr = table[i];
-            while (curr != nullptr) {
-                keys.push_back(curr->key);
-                curr = curr->next;
-            }
+            if (dist[i]) keys.push_back(slots[i].key);
         }
         return keys;
     }
 
-    ~MyHashMap() {
+    template <typename F>
+    void forEach(F&& visit) {
         for (int i = 0; i < capacity; i++) {
-            HashNode<const char*, V>* head = table[i];
-            while (head != nullptr) {
-                HashNode<const char*, V>* temp = head;
-                head = head->next;
-                delete temp;
-            }
+            if (dist[i]) visit(slots[i].key, slots[i].value);
         }
-        delete[] table;
     }
-    
+
+    ~MyHashMap() = default;
+
+    // Prevent copying (optional, but recommended for resource management)
     MyHashMap(const MyHashMap&) = delete;
     MyHashMap& operator=(const MyHashMap&) = delete;
 };
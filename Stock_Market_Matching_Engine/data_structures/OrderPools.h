@@ -0,0 +1,31 @@
+#ifndef ORDER_POOLS_H
+#define ORDER_POOLS_H
+
+#include "OrderQueue.h"
+#include "SlabPool.h"
+
+// Per-book pools for queue nodes and price-level queues
+struct OrderPools {
+    SlabPool<OrderNode> nodes;
+    SlabPool<OrderQueue> queues;
+
+    OrderPools() : nodes(1024), queues(64) {}
+
+    size_t getSlabCount() const {
+        return nodes.getSlabCount() + queues.getSlabCount();
+    }
+};
+
+// Queue creation helpers; without pools they fall back to new/delete
+inline OrderQueue* createQueue(OrderPools* pools) {
+    if (pools) return pools->queues.create(&pools->nodes);
+    return new OrderQueue();
+}
+
+inline void destroyQueue(OrderPools* pools, OrderQueue* queue) {
+    if (!queue) return;
+    if (pools) pools->queues.destroy(queue);
+    else delete queue;
+}
+
+#endif
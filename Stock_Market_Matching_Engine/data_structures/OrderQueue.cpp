@@ -1,21 +1,33 @@
 #include "OrderQueue.h"
 #include "../storage/OrderStorage.h"
+#include "../core/Log.h"
 #include <iostream>
 
 using namespace std;
 
-OrderQueue::OrderQueue() : front(nullptr), rear(nullptr), size(0) {}
+OrderQueue::OrderQueue(SlabPool<OrderNode>* pool)
+    : front(nullptr), rear(nullptr), size(0), volume(0), nodePool(pool) {}
 
 OrderQueue::~OrderQueue() {
     while (front) {
         OrderNode* temp = front;
         front = front->next;
-        delete temp;
+        freeNode(temp);
     }
 }
 
-void OrderQueue::enqueue(DiskOffset orderOffset) {
-    OrderNode* node = new OrderNode{orderOffset, nullptr};
+OrderNode* OrderQueue::newNode(DiskOffset orderOffset, int orderID) {
+    if (nodePool) return nodePool->create(orderOffset, orderID, rear, nullptr);
+    return new OrderNode{orderOffset, orderID, rear, nullptr};
+}
+
+void OrderQueue::freeNode(OrderNode* node) {
+    if (nodePool) nodePool->destroy(node);
+    else delete node;
+}
+
+OrderNode* OrderQueue::enqueue(DiskOffset orderOffset, int orderID) {
+    OrderNode* node = newNode(orderOffset, orderID);
 
     if (!rear) {
         front = rear = node;
@@ -24,20 +36,14 @@ void OrderQueue::enqueue(DiskOffset orderOffset) {
         rear = node;
     }
     size++;
+    return node;
 }
 
 DiskOffset OrderQueue::dequeue() {
-    cout <<"Here in Dequeue\n";
     if (!front) return 0;  // Empty queue
 
-    OrderNode* temp = front;
-    DiskOffset offset = temp->orderOffset;
-
-    front = front->next;
-    if (!front) rear = nullptr;
-
-    delete temp;
-    size--;
+    DiskOffset offset = front->orderOffset;
+    unlink(front);
     return offset;
 }
 
@@ -50,25 +56,31 @@ int OrderQueue::getSize() const {
     return size;
 }
 
+void OrderQueue::unlink(OrderNode* node) {
+    if (!node) return;
+
+    if (node->prev) node->prev->next = node->next;
+    else front = node->next;
+
+    if (node->next) node->next->prev = node->prev;
+    else rear = node->prev;
+
+    freeNode(node);
+    size--;
+}
+
 DiskOffset OrderQueue::removeOrder(int orderID, OrderStorage& storage) {
-    OrderNode* prev = nullptr;
     OrderNode* curr = front;
 
     while (curr) {
-        Order order = storage.load(curr->orderOffset);
-        if (order.getOrderID() == orderID) {
+        // Nodes enqueued with their ID need no disk read to compare
+        int id = curr->orderID ? curr->orderID
+                               : storage.load(curr->orderOffset).getOrderID();
+        if (id == orderID) {
             DiskOffset removedOffset = curr->orderOffset;
-
-            if (!prev) front = curr->next;
-            else prev->next = curr->next;
-
-            if (curr == rear) rear = prev;
-
-            delete curr;
-            size--;
+            unlink(curr);
             return removedOffset;
         }
-        prev = curr;
         curr = curr->next;
     }
     return 0;  // Not found
@@ -90,7 +102,7 @@ void OrderQueue::printDetailedQueue(OrderStorage& storage) const {
         cout << "OrderID: " << o.getOrderID()
              << " , User: " << o.userID
              << " , Qty: " << o.getRemainingQuantity()
-             << " , Price: $" << o.getPrice()
+             << " , Price: $" << toDouble(o.getPrice())
              << " , Status: " << o.status << "\n";
         current = current->next;
     }
@@ -98,36 +110,12 @@ void OrderQueue::printDetailedQueue(OrderStorage& storage) const {
 
 
 void OrderQueue::remove(DiskOffset offset) {
-    if (!front) return;
-    
-    // Special case: removing head
-    if (front->orderOffset == offset) {
-        OrderNode* temp = front;
-        front = front->next;
-        if (front == nullptr) {
-            rear = nullptr;
-        }
-        delete temp;
-        size--;
-        std::cerr << "[DBG] OrderQueue::remove removed head offset=" << offset << "\n";
-        return;
-    }
-    
-    // General case: find and remove
-    OrderNode* curr = front;
-    while (curr->next != nullptr) {
-        if (curr->next->orderOffset == offset) {
-            OrderNode* temp = curr->next;
-            curr->next = temp->next;
-            if (temp == rear) {
-                rear = curr;
-            }
-            delete temp;
-            size--;
-            std::cerr << "[DBG] OrderQueue::remove removed offset=" << offset << "\n";
+    for (OrderNode* curr = front; curr; curr = curr->next) {
+        if (curr->orderOffset == offset) {
+            unlink(curr);
+            LOG_DEBUG("OrderQueue::remove removed offset=" << offset);
             return;
         }
-        curr = curr->next;
     }
-    std::cerr << "[DBG] OrderQueue::remove offset not found=" << offset << "\n";
-}
\ No newline at end of file
+    LOG_DEBUG("OrderQueue::remove offset not found=" << offset);
+}
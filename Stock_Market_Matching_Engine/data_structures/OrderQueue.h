@@ -2,10 +2,14 @@
 #define ORDER_QUEUE_H
 
 #include "../storage/DiskTypes.h"  // DiskOffset type
+#include "SlabPool.h"
 #include <cstddef>
 
+// Intrusive doubly-linked node: a book can hold on to it and unlink it in O(1)
 struct OrderNode {
     DiskOffset orderOffset;  // Disk offset of Order
+    int orderID;             // 0 if the caller did not provide it
+    OrderNode* prev;
     OrderNode* next;
 };
 
@@ -16,16 +20,30 @@ private:
     OrderNode* front;
     OrderNode* rear;
     int size;
+    int64_t volume;     // resting quantity at this level, kept by the book
+    SlabPool<OrderNode>* nodePool;   // nullptr: nodes use new/delete
+
+    OrderNode* newNode(DiskOffset orderOffset, int orderID);
+    void freeNode(OrderNode* node);
 
 public:
-    OrderQueue();
+    OrderQueue(SlabPool<OrderNode>* pool = nullptr);
     ~OrderQueue();
 
+    OrderQueue(const OrderQueue&) = delete;
+    OrderQueue& operator=(const OrderQueue&) = delete;
+
     // Core queue operations
-    void enqueue(DiskOffset orderOffset);      // Add order offset
+    OrderNode* enqueue(DiskOffset orderOffset, int orderID = 0);  // Add order offset
     DiskOffset dequeue();                       // Remove and return offset
     DiskOffset peek() const;                    // Return front offset
     int getSize() const;
+    const OrderNode* getFront() const { return front; }   // walk via ->next
+
+    // Aggregate quantity for market data. The queue only stores offsets, so
+    // the owning book adjusts it on rest / fill / cancel / reduce.
+    int64_t getVolume() const { return volume; }
+    void addVolume(int64_t delta) { volume += delta; }
 
     // Remove specific order by ID
     DiskOffset removeOrder(int orderID, OrderStorage& storage);
@@ -35,6 +53,7 @@ public:
     void printDetailedQueue(OrderStorage& storage) const;
 
     void remove(DiskOffset offset);
+    void unlink(OrderNode* node);               // O(1) removal of a known node
 };
 
 #endif
@@ -0,0 +1,42 @@
+#ifndef PRICE_INDEX_H
+#define PRICE_INDEX_H
+
+#include "OrderQueue.h"
+#include "OrderPools.h"
+#include "../storage/DiskTypes.h"
+#include "../core/Price.h"
+
+// Price -> OrderQueue container used by one side of an OrderBook.
+// Keys are fixed-point Prices; missing keys are reported as NO_PRICE.
+// Queues are allocated from the owning book's pools when one is given.
+class PriceIndex {
+protected:
+    OrderPools* pools;
+
+public:
+    explicit PriceIndex(OrderPools* p = nullptr) : pools(p) {}
+    virtual ~PriceIndex() {}
+
+    // Returns the queued node so callers can unlink it later in O(1)
+    virtual OrderNode* insert(Price key, DiskOffset offset, int orderID = 0) = 0;
+    virtual OrderQueue* search(Price key) = 0;
+
+    virtual void print() = 0;
+
+    virtual DiskOffset getBest() = 0;       // BUY side (highest price)
+    virtual DiskOffset getBestSell() = 0;   // SELL side (lowest price)
+
+    virtual Price getLowestKey() = 0;
+    virtual Price getHighestKey() = 0;
+    virtual Price nextKey(Price price) = 0;
+    virtual Price prevKey(Price price) = 0;
+
+    virtual void removeOrder(Price price, DiskOffset offset) = 0;
+};
+
+enum class PriceIndexType {
+    BTREE,   // general purpose, any price spacing
+    LADDER   // equity books: flat tick array around the inside
+};
+
+#endif
@@ -0,0 +1,355 @@
+#include "PriceLadder.h"
+#include <iostream>
+#include <climits>
+#include <algorithm>
+
+using namespace std;
+
+const long long PriceLadder::NO_TICK = LLONG_MIN;
+
+PriceLadder::PriceLadder(Price tick, OrderPools* p)
+    : PriceIndex(p), tickSize(tick > 0 ? tick : DEFAULT_TICK_SIZE), baseTick(0), highIdx(-1), lowIdx(-1) {}
+
+PriceLadder::~PriceLadder() {
+    for (OrderQueue* q : levels) destroyQueue(pools, q);
+    for (auto& [tick, q] : overflow) destroyQueue(pools, q);
+}
+
+long long PriceLadder::toTick(Price price) const {
+    return price / tickSize;
+}
+
+Price PriceLadder::toPrice(long long tick) const {
+    return tick * tickSize;
+}
+
+bool PriceLadder::inWindow(long long tick) const {
+    return tick >= baseTick && tick < baseTick + windowSize();
+}
+
+// ---------------- Occupancy bitmap ----------------
+
+void PriceLadder::setBit(long long idx) {
+    occupied[idx >> 6] |= (1ULL << (idx & 63));
+    summary[idx >> 12] |= (1ULL << ((idx >> 6) & 63));
+}
+
+void PriceLadder::clearBit(long long idx) {
+    long long w = idx >> 6;
+    occupied[w] &= ~(1ULL << (idx & 63));
+    if (occupied[w] == 0) summary[w >> 6] &= ~(1ULL << (w & 63));
+}
+
+long long PriceLadder::findNext(long long idx) const {
+    if (idx < 0) idx = 0;
+    if (idx >= windowSize()) return -1;
+
+    long long w = idx >> 6;
+    uint64_t bits = occupied[w] & (~0ULL << (idx & 63));
+    if (bits) return (w << 6) + __builtin_ctzll(bits);
+
+    // Jump to the next non-empty word through the summary
+    long long nw = w + 1;
+    long long words = (long long)occupied.size();
+    while (nw < words) {
+        long long s = nw >> 6;
+        uint64_t sbits = summary[s] & (~0ULL << (nw & 63));
+        if (sbits) {
+            long long word = (s << 6) + __builtin_ctzll(sbits);
+            return (word << 6) + __builtin_ctzll(occupied[word]);
+        }
+        nw = (s + 1) << 6;
+    }
+    return -1;
+}
+
+long long PriceLadder::findPrev(long long idx) const {
+    if (idx >= windowSize()) idx = windowSize() - 1;
+    if (idx < 0) return -1;
+
+    long long w = idx >> 6;
+    int bit = idx & 63;
+    uint64_t mask = (bit == 63) ? ~0ULL : ((1ULL << (bit + 1)) - 1);
+    uint64_t bits = occupied[w] & mask;
+    if (bits) return (w << 6) + 63 - __builtin_clzll(bits);
+
+    long long pw = w - 1;
+    while (pw >= 0) {
+        long long s = pw >> 6;
+        int sbit = pw & 63;
+        uint64_t smask = (sbit == 63) ? ~0ULL : ((1ULL << (sbit + 1)) - 1);
+        uint64_t sbits = summary[s] & smask;
+        if (sbits) {
+            long long word = (s << 6) + 63 - __builtin_clzll(sbits);
+            return (word << 6) + 63 - __builtin_clzll(occupied[word]);
+        }
+        pw = (s << 6) - 1;
+    }
+    return -1;
+}
+
+bool PriceLadder::levelEmpty(long long idx) const {
+    return !levels[idx] || levels[idx]->getSize() == 0;
+}
+
+// Grow the window so that tick fits. Returns false when the span would
+// exceed MAX_LEVELS; such levels live in the overflow map instead.
+bool PriceLadder::ensureWindow(long long tick) {
+    if (levels.empty()) {
+        baseTick = tick - INITIAL_LEVELS / 2;
+        levels.assign(INITIAL_LEVELS, nullptr);
+        occupied.assign(INITIAL_LEVELS / 64, 0);
+        summary.assign((occupied.size() + 63) / 64, 0);
+        return true;
+    }
+    if (inWindow(tick)) return true;
+
+    long long lo = min(baseTick, tick);
+    long long hi = max(baseTick + windowSize() - 1, tick);
+    long long span = hi - lo + 1;
+    if (span > MAX_LEVELS) return false;
+
+    long long newSize = windowSize();
+    while (newSize < span) newSize *= 2;
+    newSize = min(newSize * 2, (long long)MAX_LEVELS);  // headroom for drift
+
+    // Keep the existing levels and extend towards the new tick
+    long long newBase = (tick < baseTick) ? hi - newSize + 1 : lo;
+
+    vector<OrderQueue*> grown(newSize, nullptr);
+    for (long long i = 0; i < windowSize(); i++) {
+        grown[baseTick - newBase + i] = levels[i];
+    }
+    levels.swap(grown);
+    baseTick = newBase;
+
+    // Pull overflow levels that now fall inside the window
+    for (auto it = overflow.begin(); it != overflow.end();) {
+        if (inWindow(it->first) && !levels[it->first - baseTick]) {
+            levels[it->first - baseTick] = it->second;
+            it = overflow.erase(it);
+        } else {
+            ++it;
+        }
+    }
+
+    rebuildBitmaps();
+    return true;
+}
+
+void PriceLadder::rebuildBitmaps() {
+    occupied.assign((windowSize() + 63) / 64, 0);
+    summary.assign((occupied.size() + 63) / 64, 0);
+    for (long long i = 0; i < windowSize(); i++) {
+        if (!levelEmpty(i)) setBit(i);
+    }
+    highIdx = findPrev(windowSize() - 1);
+    lowIdx = findNext(0);
+}
+
+// ---------------- Level navigation ----------------
+// Bits may be stale (a queue drained through search()->dequeue()), so every
+// lookup verifies the queue and clears bits it finds empty. Overflow levels
+// found empty are freed on the spot, so a book that once traded far from
+// its window does not keep walking them.
+
+map<long long, OrderQueue*>::iterator PriceLadder::dropOverflow(map<long long, OrderQueue*>::iterator it) {
+    destroyQueue(pools, it->second);
+    return overflow.erase(it);
+}
+
+long long PriceLadder::highestTick() {
+    // Overflow levels above the window
+    for (auto it = overflow.rbegin(); it != overflow.rend() && it->first >= baseTick;) {
+        if (it->second->getSize() > 0) return it->first;
+        it = map<long long, OrderQueue*>::reverse_iterator(dropOverflow(prev(it.base())));
+    }
+
+    while (highIdx != -1 && levelEmpty(highIdx)) {
+        clearBit(highIdx);
+        highIdx = findPrev(highIdx - 1);
+    }
+    if (highIdx != -1) return baseTick + highIdx;
+
+    // Below it
+    auto it = overflow.lower_bound(baseTick);
+    while (it != overflow.begin()) {
+        --it;
+        if (it->second->getSize() > 0) return it->first;
+        it = dropOverflow(it);
+    }
+    return NO_TICK;
+}
+
+long long PriceLadder::lowestTick() {
+    // Overflow levels below the window
+    for (auto it = overflow.begin(); it != overflow.end() && it->first < baseTick;) {
+        if (it->second->getSize() > 0) return it->first;
+        it = dropOverflow(it);
+    }
+
+    while (lowIdx != -1 && levelEmpty(lowIdx)) {
+        clearBit(lowIdx);
+        lowIdx = findNext(lowIdx + 1);
+    }
+    if (lowIdx != -1) return baseTick + lowIdx;
+
+    // Above it
+    for (auto it = overflow.lower_bound(baseTick); it != overflow.end();) {
+        if (it->second->getSize() > 0) return it->first;
+        it = dropOverflow(it);
+    }
+    return NO_TICK;
+}
+
+long long PriceLadder::nextTick(long long tick) {
+    for (auto it = overflow.upper_bound(tick); it != overflow.end() && it->first < baseTick;) {
+        if (it->second->getSize() > 0) return it->first;
+        it = dropOverflow(it);
+    }
+
+    if (!levels.empty() && tick < baseTick + windowSize() - 1) {
+        long long idx = findNext(max(tick + 1 - baseTick, 0LL));
+        while (idx != -1 && levelEmpty(idx)) {
+            clearBit(idx);
+            idx = findNext(idx + 1);
+        }
+        if (idx != -1) return baseTick + idx;
+    }
+
+    long long from = max(tick, baseTick + windowSize() - 1);
+    for (auto it = overflow.upper_bound(from); it != overflow.end();) {
+        if (it->second->getSize() > 0) return it->first;
+        it = dropOverflow(it);
+    }
+    return NO_TICK;
+}
+
+long long PriceLadder::prevTick(long long tick) {
+    long long top = baseTick + windowSize();
+    auto it = overflow.lower_bound(tick);
+    while (it != overflow.begin()) {
+        --it;
+        if (it->first < top) break;
+        if (it->second->getSize() > 0) return it->first;
+        it = dropOverflow(it);
+    }
+
+    if (!levels.empty() && tick > baseTick) {
+        long long idx = findPrev(min(tick - 1 - baseTick, windowSize() - 1));
+        while (idx != -1 && levelEmpty(idx)) {
+            clearBit(idx);
+            idx = findPrev(idx - 1);
+        }
+        if (idx != -1) return baseTick + idx;
+    }
+
+    it = overflow.lower_bound(min(tick, baseTick));
+    while (it != overflow.begin()) {
+        --it;
+        if (it->second->getSize() > 0) return it->first;
+        it = dropOverflow(it);
+    }
+    return NO_TICK;
+}
+
+DiskOffset PriceLadder::frontOf(long long tick) {
+    if (tick == NO_TICK) return 0;
+
+    OrderQueue* q = nullptr;
+    if (inWindow(tick)) {
+        q = levels[tick - baseTick];
+    } else {
+        auto it = overflow.find(tick);
+        if (it != overflow.end()) q = it->second;
+    }
+    while (q && q->getSize() > 0) {
+        DiskOffset off = q->peek();
+        if (off == 0) { q->dequeue(); continue; }
+        return off;
+    }
+    return 0;
+}
+
+// ---------------- PriceIndex interface ----------------
+
+OrderNode* PriceLadder::insert(Price key, DiskOffset offset, int orderID) {
+    long long tick = toTick(key);
+
+    if (ensureWindow(tick)) {
+        long long idx = tick - baseTick;
+        if (!levels[idx]) levels[idx] = createQueue(pools);
+
+        setBit(idx);
+        if (highIdx < idx) highIdx = idx;
+        if (lowIdx == -1 || lowIdx > idx) lowIdx = idx;
+        return levels[idx]->enqueue(offset, orderID);
+    }
+
+    OrderQueue*& q = overflow[tick];
+    if (!q) q = createQueue(pools);
+    return q->enqueue(offset, orderID);
+}
+
+OrderQueue* PriceLadder::search(Price key) {
+    long long tick = toTick(key);
+    if (inWindow(tick)) return levels[tick - baseTick];
+
+    auto it = overflow.find(tick);
+    return (it != overflow.end()) ? it->second : nullptr;
+}
+
+void PriceLadder::print() {
+    for (long long t = lowestTick(); t != NO_TICK; t = nextTick(t)) {
+        cout << toDouble(toPrice(t)) << " ";
+    }
+    cout << endl;
+}
+
+DiskOffset PriceLadder::getBest() {
+    // Skip levels whose queues only held stale zero offsets
+    long long t = highestTick();
+    while (t != NO_TICK) {
+        DiskOffset off = frontOf(t);
+        if (off) return off;
+        t = prevTick(t);
+    }
+    return 0;
+}
+
+DiskOffset PriceLadder::getBestSell() {
+    long long t = lowestTick();
+    while (t != NO_TICK) {
+        DiskOffset off = frontOf(t);
+        if (off) return off;
+        t = nextTick(t);
+    }
+    return 0;
+}
+
+Price PriceLadder::getLowestKey() {
+    long long t = lowestTick();
+    return (t == NO_TICK) ? NO_PRICE : toPrice(t);
+}
+
+Price PriceLadder::getHighestKey() {
+    long long t = highestTick();
+    return (t == NO_TICK) ? NO_PRICE : toPrice(t);
+}
+
+Price PriceLadder::nextKey(Price price) {
+    long long t = nextTick(toTick(price));
+    return (t == NO_TICK) ? NO_PRICE : toPrice(t);
+}
+
+Price PriceLadder::prevKey(Price price) {
+    long long t = prevTick(toTick(price));
+    return (t == NO_TICK) ? NO_PRICE : toPrice(t);
+}
+
+void PriceLadder::removeOrder(Price price, DiskOffset offset) {
+    OrderQueue* queue = search(price);
+    if (queue) {
+        queue->remove(offset);
+    }
+}
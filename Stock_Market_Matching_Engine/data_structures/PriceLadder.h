@@ -0,0 +1,76 @@
+#ifndef PRICE_LADDER_H
+#define PRICE_LADDER_H
+
+#include "PriceIndex.h"
+#include <vector>
+#include <map>
+#include <cstdint>
+
+// Flat price-level array for equity books. Prices are divided into integer
+// ticks of the symbol's tick size; levels[i] holds the queue for tick (baseTick + i). An occupancy
+// bitmap plus a one-bit-per-word summary finds the next non-empty level
+// without walking the array, and the best high/low level is cached.
+// Levels too far from the inside to fit the window go to an overflow map.
+class PriceLadder : public PriceIndex {
+private:
+    static const long long INITIAL_LEVELS = 1024;
+    static const long long MAX_LEVELS = 1 << 20;
+    static const long long NO_TICK;
+
+    Price tickSize;
+    long long baseTick;                     // tick of levels[0]
+    std::vector<OrderQueue*> levels;        // queues are created once, reused
+    std::vector<uint64_t> occupied;         // bit per level: may be non-empty
+    std::vector<uint64_t> summary;          // bit per non-zero occupied word
+    std::map<long long, OrderQueue*> overflow;
+
+    long long highIdx;                      // cached highest set bit, -1 if none
+    long long lowIdx;                       // cached lowest set bit, -1 if none
+
+    long long toTick(Price price) const;
+    Price toPrice(long long tick) const;
+    long long windowSize() const { return (long long)levels.size(); }
+    bool inWindow(long long tick) const;
+
+    void setBit(long long idx);
+    void clearBit(long long idx);
+    long long findNext(long long idx) const;   // first set bit >= idx
+    long long findPrev(long long idx) const;   // last set bit <= idx
+    bool levelEmpty(long long idx) const;
+
+    // Free an overflow level found empty; returns the entry after it
+    std::map<long long, OrderQueue*>::iterator dropOverflow(std::map<long long, OrderQueue*>::iterator it);
+
+    bool ensureWindow(long long tick);
+    void rebuildBitmaps();
+
+    long long highestTick();
+    long long lowestTick();
+    long long nextTick(long long tick);
+    long long prevTick(long long tick);
+    DiskOffset frontOf(long long tick);
+
+public:
+    explicit PriceLadder(Price tick = DEFAULT_TICK_SIZE, OrderPools* p = nullptr);
+    ~PriceLadder() override;
+
+    PriceLadder(const PriceLadder&) = delete;
+    PriceLadder& operator=(const PriceLadder&) = delete;
+
+    OrderNode* insert(Price key, DiskOffset offset, int orderID = 0) override;
+    OrderQueue* search(Price key) override;
+
+    void print() override;
+
+    DiskOffset getBest() override;
+    DiskOffset getBestSell() override;
+
+    Price getLowestKey() override;
+    Price getHighestKey() override;
+    Price nextKey(Price price) override;
+    Price prevKey(Price price) override;
+
+    void removeOrder(Price price, DiskOffset offset) override;
+};
+
+#endif
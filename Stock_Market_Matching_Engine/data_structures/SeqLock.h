@@ -0,0 +1,65 @@
+#ifndef SEQ_LOCK_H
+#define SEQ_LOCK_H
+
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+
+// Single-writer sequence lock around a small trivially copyable value.
+//
+// The writer bumps the sequence to odd, stores the value, then bumps it to
+// even again. Readers copy the value between two loads of the sequence and
+// retry if it was odd or changed, so they never block the writer and never
+// take a lock. The value is kept as relaxed atomic words so a torn read is
+// just discarded instead of being a data race.
+//
+// Only one thread may call store() at a time (the owner holds bookLock or is
+// the book's shard thread); any number may call load().
+template <typename T>
+class SeqLock {
+    static_assert(std::is_trivially_copyable<T>::value, "SeqLock needs a trivially copyable type");
+
+private:
+    static const size_t WORDS = (sizeof(T) + sizeof(uint64_t) - 1) / sizeof(uint64_t);
+
+    alignas(64) std::atomic<uint64_t> sequence;
+    std::atomic<uint64_t> words[WORDS];
+
+public:
+    SeqLock() : sequence(0) {
+        for (size_t i = 0; i < WORDS; i++) words[i].store(0, std::memory_order_relaxed);
+        store(T{});
+    }
+
+    SeqLock(const SeqLock&) = delete;
+    SeqLock& operator=(const SeqLock&) = delete;
+
+    void store(const T& value) {
+        uint64_t buf[WORDS] = {};
+        memcpy(buf, &value, sizeof(T));
+
+        uint64_t seq = sequence.load(std::memory_order_relaxed);
+        sequence.store(seq + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        for (size_t i = 0; i < WORDS; i++) words[i].store(buf[i], std::memory_order_relaxed);
+        sequence.store(seq + 2, std::memory_order_release);
+    }
+
+    T load() const {
+        uint64_t buf[WORDS];
+        uint64_t before, after;
+        do {
+            before = sequence.load(std::memory_order_acquire);
+            for (size_t i = 0; i < WORDS; i++) buf[i] = words[i].load(std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_acquire);
+            after = sequence.load(std::memory_order_relaxed);
+        } while ((before & 1) || before != after);
+
+        T value;
+        memcpy(&value, buf, sizeof(T));
+        return value;
+    }
+};
+
+#endif
@@ -0,0 +1,87 @@
+#ifndef SLAB_POOL_H
+#define SLAB_POOL_H
+
+#include <vector>
+#include <cstddef>
+#include <utility>
+
+// Fixed-size object pool. Objects are carved out of slabs of SLAB_SIZE slots
+// that are handed out in address order, so objects created one after the
+// other (e.g. orders queued at one price level) sit next to each other.
+// Freed slots go on a free list and are reused before a new slab is taken.
+// Not thread-safe: each OrderBook owns its pools and uses them under bookLock
+// (or from its owning shard thread).
+template <typename T>
+class SlabPool {
+private:
+    union Slot {
+        Slot* nextFree;
+        alignas(T) unsigned char storage[sizeof(T)];
+    };
+
+    size_t slabSize;
+    std::vector<Slot*> slabs;
+    Slot* freeList;
+
+    size_t slabCount;   // slabs taken from the global allocator
+    size_t liveObjects;
+
+    void grow() {
+        Slot* slab = new Slot[slabSize];
+        slabs.push_back(slab);
+        slabCount++;
+
+        // Chain back to front so the first slot is handed out first
+        for (size_t i = slabSize; i > 0; i--) {
+            slab[i - 1].nextFree = freeList;
+            freeList = &slab[i - 1];
+        }
+    }
+
+public:
+    explicit SlabPool(size_t perSlab = 256)
+        : slabSize(perSlab ? perSlab : 1), freeList(nullptr),
+          slabCount(0), liveObjects(0) {}
+
+    // Owners must destroy their objects first; the pool only frees memory
+    ~SlabPool() {
+        for (Slot* slab : slabs) delete[] slab;
+    }
+
+    SlabPool(const SlabPool&) = delete;
+    SlabPool& operator=(const SlabPool&) = delete;
+
+    template <typename... Args>
+    T* create(Args&&... args) {
+        if (!freeList) grow();
+
+        Slot* slot = freeList;
+        freeList = slot->nextFree;
+        liveObjects++;
+        return new (slot->storage) T{std::forward<Args>(args)...};
+    }
+
+    void destroy(T* obj) {
+        if (!obj) return;
+        obj->~T();
+
+        Slot* slot = reinterpret_cast<Slot*>(obj);
+        slot->nextFree = freeList;
+        freeList = slot;
+        liveObjects--;
+    }
+
+    // Make sure n more objects can be created without touching the heap
+    void reserve(size_t n) {
+        size_t available = slabs.size() * slabSize - liveObjects;
+        while (available < n) {
+            grow();
+            available += slabSize;
+        }
+    }
+
+    size_t getSlabCount() const { return slabCount; }
+    size_t getLiveCount() const { return liveObjects; }
+};
+
+#endif
@@ -0,0 +1,237 @@
+#include "MarketDataPublisher.h"
+#include "../core/Log.h"
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+using namespace std;
+
+MarketDataPublisher::MarketDataPublisher(const string& path,
+                                         chrono::milliseconds snapshotEvery,
+                                         size_t ringCapacity)
+    : ring(ringCapacity), socketPath(path), snapshotInterval(snapshotEvery),
+      listenFd(-1), running(true), seq(0), published(0), dropped(0) {
+    if (!openSocket()) {
+        LOG_ERROR("MarketData: cannot listen on " << socketPath << ", events will be discarded");
+    }
+    worker = thread(&MarketDataPublisher::run, this);
+}
+
+MarketDataPublisher::~MarketDataPublisher() {
+    stop();
+}
+
+void MarketDataPublisher::stop() {
+    running.store(false);
+    if (worker.joinable()) worker.join();
+
+    for (int fd : clients) ::close(fd);
+    clients.clear();
+    if (listenFd >= 0) {
+        ::close(listenFd);
+        ::unlink(socketPath.c_str());
+        listenFd = -1;
+    }
+}
+
+bool MarketDataPublisher::openSocket() {
+    sockaddr_un addr{};
+    if (socketPath.size() >= sizeof(addr.sun_path)) return false;
+    addr.sun_family = AF_UNIX;
+    strncpy(addr.sun_path, socketPath.c_str(), sizeof(addr.sun_path) - 1);
+
+    int fd = ::socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (fd < 0) return false;
+
+    ::unlink(socketPath.c_str());   // stale socket from a previous run
+    if (::bind(fd, (sockaddr*)&addr, sizeof(addr)) != 0 || ::listen(fd, 16) != 0) {
+        ::close(fd);
+        return false;
+    }
+    listenFd = fd;
+    return true;
+}
+
+bool MarketDataPublisher::publish(const MarketDataEvent& ev) {
+    if (!ring.tryPush(ev)) {
+        dropped++;
+        return false;
+    }
+    return true;
+}
+
+void MarketDataPublisher::apply(const MarketDataEvent& ev) {
+    string sym(ev.symbol, strnlen(ev.symbol, sizeof(ev.symbol)));
+
+    if (ev.type == MarketDataEvent::CLEAR) {
+        ShadowBook& book = books[sym];
+        book.bids.clear();
+        book.asks.clear();
+        return;
+    }
+    if (ev.type != MarketDataEvent::LEVEL) return;
+
+    ShadowBook& book = books[sym];
+    bool gone = ev.orders <= 0 || ev.quantity <= 0;
+    if (ev.side) {
+        if (gone) book.bids.erase(ev.price);
+        else book.bids[ev.price] = LevelState{ev.quantity, ev.orders};
+    } else {
+        if (gone) book.asks.erase(ev.price);
+        else book.asks[ev.price] = LevelState{ev.quantity, ev.orders};
+    }
+}
+
+void MarketDataPublisher::encode(const MarketDataEvent& ev, uint64_t seq, vector<char>& out) {
+    MarketDataMessage msg{};
+    msg.seq = seq;
+    msg.type = ev.type;
+    msg.side = ev.side;
+    memcpy(msg.symbol, ev.symbol, sizeof(msg.symbol));
+    msg.price = ev.price;
+    msg.quantity = ev.quantity;
+    msg.orders = ev.orders;
+
+    const char* p = reinterpret_cast<const char*>(&msg);
+    out.insert(out.end(), p, p + sizeof(msg));
+}
+
+// BEGIN, every level (bids then asks, best first), END for each symbol
+void MarketDataPublisher::encodeSnapshot(vector<char>& out) const {
+    for (const auto& [sym, book] : books) {
+        MarketDataEvent ev;
+        memcpy(ev.symbol, sym.data(), min(sym.size(), sizeof(ev.symbol)));
+
+        ev.type = MarketDataEvent::SNAPSHOT_BEGIN;
+        ev.orders = (int32_t)(book.bids.size() + book.asks.size());
+        encode(ev, seq, out);
+
+        ev.type = MarketDataEvent::SNAPSHOT_LEVEL;
+        ev.side = 1;
+        for (const auto& [price, level] : book.bids) {
+            ev.price = price;
+            ev.quantity = level.quantity;
+            ev.orders = level.orders;
+            encode(ev, seq, out);
+        }
+        ev.side = 0;
+        for (const auto& [price, level] : book.asks) {
+            ev.price = price;
+            ev.quantity = level.quantity;
+            ev.orders = level.orders;
+            encode(ev, seq, out);
+        }
+
+        ev.type = MarketDataEvent::SNAPSHOT_END;
+        ev.price = 0;
+        ev.quantity = 0;
+        ev.orders = 0;
+        encode(ev, seq, out);
+    }
+}
+
+void MarketDataPublisher::acceptClients(vector<int>& fresh) {
+    if (listenFd < 0) return;
+
+    while (true) {
+        int fd = ::accept4(listenFd, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (fd < 0) break;
+        fresh.push_back(fd);
+    }
+}
+
+// Writes the whole buffer or gives up. A client whose socket stays full for
+// SEND_TIMEOUT_MS is too slow; a half-written message would corrupt its
+// stream anyway, so the caller drops it.
+bool MarketDataPublisher::sendAll(int fd, const vector<char>& buf) {
+    size_t done = 0;
+    while (done < buf.size()) {
+        ssize_t n = ::send(fd, buf.data() + done, buf.size() - done, MSG_NOSIGNAL | MSG_DONTWAIT);
+        if (n > 0) {
+            done += n;
+            continue;
+        }
+        if (n < 0 && errno == EINTR) continue;
+        if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            pollfd p{fd, POLLOUT, 0};
+            if (::poll(&p, 1, SEND_TIMEOUT_MS) > 0 && (p.revents & POLLOUT)) continue;
+        }
+        return false;
+    }
+    return true;
+}
+
+void MarketDataPublisher::broadcast(const vector<char>& buf) {
+    for (size_t i = 0; i < clients.size(); ) {
+        if (sendAll(clients[i], buf)) {
+            i++;
+            continue;
+        }
+        LOG_WARN("MarketData: dropping slow or closed subscriber fd=" << clients[i]);
+        ::close(clients[i]);
+        clients[i] = clients.back();
+        clients.pop_back();
+    }
+}
+
+void MarketDataPublisher::run() {
+    vector<char> out;
+    vector<char> snapshot;
+    vector<int> fresh;
+    MarketDataEvent ev;
+    auto nextSnapshot = chrono::steady_clock::now() + snapshotInterval;
+    int idle = 0;
+
+    while (true) {
+        // Drain a batch: apply to the shadow books and encode
+        out.clear();
+        size_t n = 0;
+        while (n < DRAIN_BATCH && ring.tryPop(ev)) {
+            apply(ev);
+            encode(ev, ++seq, out);
+            n++;
+        }
+        published += n;
+
+        // Updates go out before anyone gets a snapshot that includes them
+        if (!out.empty()) broadcast(out);
+
+        // New subscribers start from a snapshot of the current depth
+        fresh.clear();
+        acceptClients(fresh);
+        if (!fresh.empty()) {
+            snapshot.clear();
+            encodeSnapshot(snapshot);
+            for (int fd : fresh) {
+                if (sendAll(fd, snapshot)) clients.push_back(fd);
+                else ::close(fd);
+            }
+        }
+
+        auto now = chrono::steady_clock::now();
+        if (now >= nextSnapshot) {
+            if (!clients.empty()) {
+                snapshot.clear();
+                encodeSnapshot(snapshot);
+                broadcast(snapshot);
+            }
+            nextSnapshot = now + snapshotInterval;
+        }
+
+        if (n > 0) {
+            idle = 0;
+            continue;
+        }
+        if (!running.load()) break;   // ring is drained
+
+        if (++idle < SPIN_BEFORE_SLEEP) {
+            this_thread::yield();
+        } else {
+            this_thread::sleep_for(chrono::microseconds(500));
+        }
+    }
+}
@@ -0,0 +1,135 @@
+#ifndef MARKETDATAPUBLISHER_H
+#define MARKETDATAPUBLISHER_H
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+#include "../core/Price.h"
+#include "../data_structures/MPSCRing.h"
+
+using namespace std;
+
+// One market data event as the books produce it. Plain data so it can sit
+// in the ring without allocating.
+struct MarketDataEvent {
+    enum Type : uint8_t {
+        LEVEL = 1,        // level changed: qty / orders are the new totals (0 = gone)
+        TRADE,            // trade print: side is the aggressor
+        CLEAR,            // drop every level of the symbol (a full re-send follows)
+        SNAPSHOT_BEGIN,   // publisher only: full depth of one symbol follows
+        SNAPSHOT_LEVEL,
+        SNAPSHOT_END
+    };
+
+    uint8_t type = LEVEL;
+    uint8_t side = 0;        // 1 = bid / buy, 0 = ask / sell
+    char symbol[8] = {};     // same width as OrderRecord::symbol
+    Price price = 0;
+    int64_t quantity = 0;
+    int32_t orders = 0;
+};
+
+// Wire format, one fixed 40-byte little-endian message per event:
+//
+//   [u64 seq][u8 type][u8 side][char symbol[8]][u16 reserved]
+//   [i64 price][i64 quantity][i32 orders]
+//
+// seq increases by one per incremental event (LEVEL / TRADE / CLEAR).
+// Snapshot messages carry the seq of the last event they include, so a
+// client applies a snapshot and then only the events with a higher seq.
+#pragma pack(push, 1)
+struct MarketDataMessage {
+    uint64_t seq;
+    uint8_t type;
+    uint8_t side;
+    char symbol[8];
+    uint16_t reserved;
+    int64_t price;
+    int64_t quantity;
+    int32_t orders;
+};
+#pragma pack(pop)
+static_assert(sizeof(MarketDataMessage) == 40, "market data wire format changed");
+
+// Fans book events out to local subscribers over a Unix domain socket.
+//
+// Books push events into a bounded lock-free ring (never blocking the
+// matching path; a full ring makes publish() return false and the book
+// re-sends its depth later). The publisher thread drains the ring, keeps a
+// shadow copy of every book's depth, and writes the messages to each
+// connected client. New clients get a full-depth snapshot on connect, and
+// everyone gets one every snapshotInterval, taken from the shadow books so
+// bookLock is never touched for it.
+//
+// A client that can't keep up (its socket buffer stays full) is dropped
+// rather than allowed to stall the others.
+class MarketDataPublisher {
+private:
+    struct LevelState {
+        int64_t quantity;
+        int32_t orders;
+    };
+
+    // Both sides keyed best price first
+    struct ShadowBook {
+        map<Price, LevelState, greater<Price>> bids;
+        map<Price, LevelState> asks;
+    };
+
+    MPSCRing<MarketDataEvent> ring;
+    string socketPath;
+    chrono::milliseconds snapshotInterval;
+
+    int listenFd;
+    vector<int> clients;
+    thread worker;
+    atomic<bool> running;
+
+    // Publisher thread only
+    uint64_t seq;
+    unordered_map<string, ShadowBook> books;
+
+    atomic<uint64_t> published;
+    atomic<uint64_t> dropped;
+
+    static const size_t DRAIN_BATCH = 1024;
+    static const int SPIN_BEFORE_SLEEP = 200;
+    static const int SEND_TIMEOUT_MS = 50;
+
+    bool openSocket();
+    void run();
+    void apply(const MarketDataEvent& ev);
+    static void encode(const MarketDataEvent& ev, uint64_t seq, vector<char>& out);
+    void encodeSnapshot(vector<char>& out) const;
+    void acceptClients(vector<int>& fresh);
+    bool sendAll(int fd, const vector<char>& buf);
+    void broadcast(const vector<char>& buf);
+
+public:
+    explicit MarketDataPublisher(const string& path = "data/marketdata.sock",
+                                 chrono::milliseconds snapshotEvery = chrono::milliseconds(1000),
+                                 size_t ringCapacity = 65536);
+    ~MarketDataPublisher();
+
+    MarketDataPublisher(const MarketDataPublisher&) = delete;
+    MarketDataPublisher& operator=(const MarketDataPublisher&) = delete;
+
+    // Any thread; lock-free. False if the ring is full and the event was lost.
+    bool publish(const MarketDataEvent& ev);
+
+    // Stop the thread after sending whatever is still queued
+    void stop();
+
+    bool isListening() const { return listenFd >= 0; }
+    const string& getSocketPath() const { return socketPath; }
+    uint64_t getPublishedCount() const { return published.load(); }
+    uint64_t getDroppedCount() const { return dropped.load(); }
+};
+
+#endif
@@ -3,20 +3,31 @@
 
 #include <thread>
 #include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <chrono>
 #include <vector>
 #include <string>
 #include <iostream>
 #include <iomanip>
+#include <algorithm>
+#include <unordered_map>
 #include "OrderBook.h"
+#include "MatchingShard.h"
+#include "../core/ParallelFor.h"
+#include "../core/Log.h"
 #include "../core/User.h"
 #include "../data_structures/MyHashMap.h"
 #include <memory>
 #include "../storage/OrderStorage.h"
 #include "../storage/StorageManager.h"
+#include "../storage/Journal.h"
 #include "../storage/SymbolStorage.h"
 #include "../storage/UserStorage.h"
 #include "../storage/TradeStorage.h"
 #include "../storage/MetadataStorage.h"
+#include "../storage/CommandCapture.h"
+#include "../storage/BookSnapshot.h"
 
 using namespace std;
 
@@ -25,6 +36,16 @@ private:
     MyHashMap<string, OrderBook*>* orderBooks;
     MyHashMap<int, Order*>* allOrders;
     MyHashMap<string, User*>* users;
+
+    // Same books and users indexed by intern key (symbolTable()/userTable()),
+    // so the order path can skip hashing strings. Slots without an entry are
+    // nullptr. booksByKey is guarded by engineLock, usersByKey by userLock.
+    vector<OrderBook*> booksByKey;
+    vector<User*> usersByKey;
+
+    // orderID -> book for resting orders; the book's own handle index
+    // then resolves the level and queue node
+    MyHashMap<int, OrderBook*>* orderBookIndex;
     
     vector<Trade> tradeHistory;
     SymbolStorage symbolStorage;
@@ -44,12 +65,316 @@ private:
 
     OrderStorage orderStorage;
 
+    // Sharded mode: each symbol is owned by one matching thread and its
+    // book is only touched there. Empty = books run inline under bookLock.
+    vector<MatchingShard*> shards;
+
+    // Optional order-flow capture (not owned); see setCapture
+    CommandCapture* capture;
+
+    // Optional L2 market data feed (not owned); see setMarketData
+    MarketDataPublisher* marketData;
+
+    // Book snapshots: written by snapshotThread every interval once
+    // startSnapshots() is called, and once more at shutdown
+    const string snapshotPath = "data/books.snap";
+    thread snapshotThread;
+    mutex snapshotMutex;        // guards stopSnapshots
+    condition_variable snapshotCv;
+    bool stopSnapshots;
+    mutex snapshotWriteMutex;   // one snapshot at a time
+
+    // User write-back: changes only mark a user dirty (under userLock) and
+    // userFlushThread writes each dirty user once per interval, so a busy
+    // user costs one record write per interval instead of one per event.
+    // What a crash would lose in between is covered by the cash and share
+    // changes logged as they happen (UserStorage::logChange), ahead of the
+    // order and trade writes that depend on them; UserStorage applies the
+    // ones newer than the last flush when it opens. Active orders are not
+    // logged, rebuildAllFromStorage takes them from the live orders. With
+    // JournalConfig::waitForCommit (durable mode) every mutating call also
+    // flushes before it returns.
+    const chrono::milliseconds userFlushInterval{2};
+    vector<User*> dirtyUsers;           // guarded by userLock
+    vector<vector<char>> userFlushBuffer; // guarded by userFlushWriteMutex, reused between flushes
+    bool flushUsersOnReturn;
+    thread userFlushThread;
+    mutex userFlushMutex;               // guards stopUserFlush
+    condition_variable userFlushCv;
+    bool stopUserFlush;
+    mutex userFlushWriteMutex;          // one flush at a time
+
+    MatchingShard* shardFor(const string& symbol) {
+        if (shards.empty()) return nullptr;
+        return shards[std::hash<string>{}(symbol) % shards.size()];
+    }
+
+    OrderBook* bookAt(uint32_t key) const {
+        return key < booksByKey.size() ? booksByKey[key] : nullptr;
+    }
+
+    User* userAt(uint32_t key) const {
+        return key < usersByKey.size() ? usersByKey[key] : nullptr;
+    }
+
+    // Callers hold engineLock / userLock
+    void registerBook(const string& symbol, OrderBook* book) {
+        orderBooks->insert(symbol, book);
+        uint32_t key = symbolTable().intern(symbol);
+        if (key >= booksByKey.size()) booksByKey.resize(key + 1, nullptr);
+        booksByKey[key] = book;
+    }
+
+    void registerUser(User* user) {
+        users->insert(user->getUserID(), user);
+        uint32_t key = userTable().intern(user->getUserID());
+        if (key >= usersByKey.size()) usersByKey.resize(key + 1, nullptr);
+        usersByKey[key] = user;
+    }
+
+    OrderBook* newBook(const string& symbol, Price tick) {
+        OrderBook* book = new OrderBook(symbol, orderStorage, tick);
+        if (!shards.empty()) book->setSingleWriter(true);
+        if (marketData) book->setMarketData(marketData);   // not shared yet
+        return book;
+    }
+
+    // Book operations, run on the owning shard when sharded
+    vector<Trade> bookPlace(OrderBook* book, Order* order) {
+        MatchingShard* shard = shardFor(book->getSymbol());
+        if (!shard) return book->addOrder(order);
+
+        ShardCommand cmd;
+        cmd.type = ShardCommand::PLACE;
+        cmd.book = book;
+        cmd.order = order;
+        return shard->call(cmd).trades;
+    }
+
+    BookSnapshot bookSnapshot(OrderBook* book) {
+        MatchingShard* shard = shardFor(book->getSymbol());
+        if (!shard) return book->captureSnapshot();
+
+        ShardCommand cmd;
+        cmd.type = ShardCommand::SNAPSHOT;
+        cmd.book = book;
+        return shard->call(cmd).snapshot;
+    }
+
+    // Live orders for one book from its snapshot: the snapshot's orders at
+    // their current state, then anything newer from the tail of orders.dat
+    bool restoreFromSnapshot(const BookSnapshot& snap,
+                             const unordered_map<string, vector<pair<DiskOffset, Order>>>& recent,
+                             vector<pair<DiskOffset, Order>>& live) {
+        if (!orderStorage.reloadLiveOrders(snap.bids, live) ||
+            !orderStorage.reloadLiveOrders(snap.asks, live)) {
+            live.clear();
+            return false;
+        }
+
+        auto r = recent.find(snap.symbol);
+        if (r != recent.end()) {
+            for (const auto& entry : r->second) {
+                if (entry.first - 1 >= snap.dataMark) live.push_back(entry);
+            }
+        }
+        return true;
+    }
+
+    bool bookCancel(OrderBook* book, int orderID, Order* cancelled) {
+        MatchingShard* shard = shardFor(book->getSymbol());
+        if (!shard) return book->cancelOrder(orderID, cancelled);
+
+        ShardCommand cmd;
+        cmd.type = ShardCommand::CANCEL;
+        cmd.book = book;
+        cmd.orderID = orderID;
+        ShardResult res = shard->call(cmd);
+        if (cancelled) *cancelled = res.order;
+        return res.ok;
+    }
+
+    int bookReduce(OrderBook* book, int orderID, int reduceBy, bool& stillResting) {
+        MatchingShard* shard = shardFor(book->getSymbol());
+        if (!shard) {
+            int removed = book->reduceOrder(orderID, reduceBy);
+            Order current;
+            stillResting = book->findOrder(orderID, current);
+            return removed;
+        }
+
+        ShardCommand cmd;
+        cmd.type = ShardCommand::REDUCE;
+        cmd.book = book;
+        cmd.orderID = orderID;
+        cmd.quantity = reduceBy;
+        ShardResult res = shard->call(cmd);
+        stillResting = res.ok;
+        return res.removed;
+    }
+
+    // Take the cash (BUY) or shares (SELL) an order needs from its owner.
+    // Caller holds userLock.
+    bool reserveFor(User* user, uint32_t userKey, const string& symbol, uint32_t symbolKey, const string& side, Price px, int quantity) {
+        if (side == "BUY") {
+            Money cost = notional(px, quantity);
+            if (!user->deductCash(cost)) {
+                cout << "Error: Insufficient funds. Need $" << toDouble(cost)
+                     << ", have $" << user->getCashBalance() << "\n";
+                return false;
+            }
+            userStorage.logChange(userKey, *user);
+        } else { // SELL
+            if (user->getStockQuantity(symbolKey) < quantity) {
+                cout << "Error: Insufficient shares of " << symbol << "\n";
+                return false;
+            }
+            user->removeStock(symbolKey, quantity); // lock shares
+            userStorage.logChange(userKey, *user, symbolKey);
+        }
+        return true;
+    }
+
+    // Hand back what an order still had reserved (cancel/reduce). Caller
+    // holds userLock.
+    void refund(User* user, const Order& order, int quantity) {
+        uint32_t userKey = userTable().intern(order.userID);
+        if (order.side == "BUY") {
+            user->addCash(notional(order.price, quantity));
+            userStorage.logChange(userKey, *user);
+        } else { // SELL
+            uint32_t symbolKey = symbolTable().intern(order.symbol);
+            user->addStock(symbolKey, quantity);
+            userStorage.logChange(userKey, *user, symbolKey);
+        }
+        markDirty(user);
+    }
+
+    // Shares to the buyer, cash to the seller. Both changes are logged
+    // here, before the trade itself is persisted. Caller holds userLock.
+    void settle(const Trade& trade, User* buyer, User* seller) {
+        buyer->addStock(trade.symbolKey, trade.quantity);
+        seller->addCash(notional(trade.price, trade.quantity));
+        userStorage.logChange(trade.buyUserKey, *buyer, trade.symbolKey);
+        userStorage.logChange(trade.sellUserKey, *seller);
+        markDirty(buyer);
+        markDirty(seller);
+    }
+
+    // Bring one side of a trade in line with disk; once it is filled it
+    // leaves the handle index and its owner's active orders. Caller holds
+    // engineLock and userLock.
+    void syncMatchedOrder(int orderID, uint32_t ownerKey) {
+        DiskOffset off = orderStorage.getOffsetForOrder(orderID);
+        Order* live = off ? allOrders->get(orderID) : nullptr;
+        if (!live) return;
+
+        *live = orderStorage.load(off);
+        if (!live->isFilled()) return;
+
+        orderBookIndex->remove(orderID);
+        if (User* owner = userAt(ownerKey)) {
+            owner->removeActiveOrder(orderID);
+            markDirty(owner);
+        }
+    }
+
+    // Queue a changed user for the next flush. Caller holds userLock.
+    void markDirty(User* user) {
+        if (user->isDirty()) return;
+        user->setDirty(true);
+        dirtyUsers.push_back(user);
+    }
+
+    // Write every dirty user's current state, then mark the changes logged
+    // up to the copy as applied. Payloads are encoded under userLock (a
+    // copy, no disk I/O) and written after it is released, unless the
+    // change log is full: then the whole flush holds userLock so it covers
+    // every change and the log can start over.
+    void flushDirtyUsers() {
+        lock_guard<mutex> writer(userFlushWriteMutex);
+        unique_lock<mutex> lock(userLock);
+        size_t n = dirtyUsers.size();
+        if (userFlushBuffer.size() < n) userFlushBuffer.resize(n);
+        for (size_t i = 0; i < n; i++) {
+            dirtyUsers[i]->toCompact(userFlushBuffer[i]);
+            dirtyUsers[i]->setDirty(false);
+        }
+        dirtyUsers.clear();
+        uint64_t covered = userStorage.getChangeSeq();
+        if (!userStorage.changeLogFull()) lock.unlock();
+
+        for (size_t i = 0; i < n; i++) userStorage.saveCompact(userFlushBuffer[i]);
+        userStorage.markApplied(covered);
+    }
+
+    // End of a mutating call: in durable mode the caller's changes must be
+    // in the journal before it returns
+    void usersChanged() {
+        if (flushUsersOnReturn) flushDirtyUsers();
+    }
+
+    // The part of a batch call that goes to one book; items are the
+    // positions of its entries in the caller's request list
+    struct BookBatch {
+        OrderBook* book = nullptr;
+        vector<size_t> items;
+        vector<Order*> orders;      // placeOrders
+        vector<int> orderIDs;       // cancelOrders
+        ShardResult result;
+    };
+
+    BookBatch& batchFor(OrderBook* book, vector<BookBatch>& batches,
+                        unordered_map<OrderBook*, size_t>& index) {
+        auto [it, fresh] = index.emplace(book, batches.size());
+        if (fresh) {
+            batches.emplace_back();
+            batches.back().book = book;
+        }
+        return batches[it->second];
+    }
+
+    // One addOrders / cancelOrders call per book. Sharded books are all
+    // submitted before waiting on any, so different shards work on their
+    // part of the batch at the same time.
+    void runBookBatches(vector<BookBatch>& batches, bool place) {
+        vector<future<ShardResult>> pending(batches.size());
+        for (size_t g = 0; g < batches.size(); g++) {
+            BookBatch& b = batches[g];
+            MatchingShard* shard = shardFor(b.book->getSymbol());
+            if (!shard) {
+                if (place) b.result.batchTrades = b.book->addOrders(b.orders);
+                else b.result.batchOk = b.book->cancelOrders(b.orderIDs, b.result.batchOrders);
+                continue;
+            }
+
+            ShardCommand cmd;
+            cmd.type = place ? ShardCommand::PLACE_BATCH : ShardCommand::CANCEL_BATCH;
+            cmd.book = b.book;
+            cmd.orders = &b.orders;
+            cmd.orderIDs = &b.orderIDs;
+            pending[g] = shard->submit(cmd);
+        }
+        for (size_t g = 0; g < batches.size(); g++) {
+            if (pending[g].valid()) batches[g].result = pending[g].get();
+        }
+    }
+
 public:
 
-MatchingEngine() : nextOrderID(1), nextTradeID(1) {
+// matchingThreads > 0 turns on sharded matching with that many threads
+MatchingEngine(int matchingThreads = 0)
+    : nextOrderID(1), nextTradeID(1), capture(nullptr), marketData(nullptr),
+      stopSnapshots(false), flushUsersOnReturn(Journal::instance().waitsForCommit()),
+      stopUserFlush(false) {
+    for (int i = 0; i < matchingThreads; i++) {
+        shards.push_back(new MatchingShard());
+    }
+
     orderBooks = new MyHashMap<string, OrderBook*>(100);
     allOrders = new MyHashMap<int, Order*>(10000);
     users = new MyHashMap<string, User*>(1000);
+    orderBookIndex = new MyHashMap<int, OrderBook*>(10000);
 
     Metadata meta = metadataStorage.loadMetadata();
     nextOrderID = meta.nextOrderID;
@@ -59,10 +384,27 @@ MatchingEngine() : nextOrderID(1), nextTradeID(1) {
          << ", nextTradeID=" << nextTradeID << "\n";
     
     rebuildAllFromStorage();
-    
+
+    userFlushThread = thread([this] {
+        unique_lock<mutex> lk(userFlushMutex);
+        while (!userFlushCv.wait_for(lk, userFlushInterval, [this] { return stopUserFlush; })) {
+            lk.unlock();
+            flushDirtyUsers();
+            lk.lock();
+        }
+    });
 }
 
 ~MatchingEngine() {
+    // Last user write-back before anything else goes away
+    {
+        lock_guard<mutex> lock(userFlushMutex);
+        stopUserFlush = true;
+    }
+    userFlushCv.notify_all();
+    if (userFlushThread.joinable()) userFlushThread.join();
+    flushDirtyUsers();
+
     Metadata meta;
     meta.nextOrderID = nextOrderID;
     meta.nextTradeID = nextTradeID;
@@ -71,32 +413,109 @@ MatchingEngine() : nextOrderID(1), nextTradeID(1) {
     meta.totalTrades = tradeHistory.size();
     meta.lastSaveTime = time(nullptr);
     metadataStorage.saveMetadata(meta);
-    // Delete OrderBook*
-    std::vector<std::string> symbols = orderBooks->getAllKeys();
-    for (const std::string& sym : symbols) {
-        delete orderBooks->get(sym);
-    }
 
-    // Delete Order*
-    std::vector<int> orderIDs = allOrders->getAllKeys();
-    for (int id : orderIDs) {
-        delete allOrders->get(id);
+    // Final snapshot so the next start only replays what comes after it
+    {
+        lock_guard<mutex> lock(snapshotMutex);
+        stopSnapshots = true;
     }
+    snapshotCv.notify_all();
+    if (snapshotThread.joinable()) snapshotThread.join();
+    writeSnapshot();
 
-    // Delete User*
-    std::vector<std::string> userIDs = users->getAllKeys();
-    for (const std::string& uid : userIDs) {
-        delete users->get(uid);
-    }
+    // Stop the matching threads before their books go away
+    for (MatchingShard* shard : shards) delete shard;
+    shards.clear();
+
+    // Delete OrderBook*, Order* and User*
+    orderBooks->forEach([](const string&, OrderBook*& book) { delete book; });
+    allOrders->forEach([](int, Order*& order) { delete order; });
+    users->forEach([](const string&, User*& user) { delete user; });
 
     // Delete the hashmaps themselves
     delete orderBooks;
     delete allOrders;
     delete users;
+    delete orderBookIndex;
+}
+
+
+// Record every inbound command (and the trades it produces) to a capture
+// file for tools/replay_capture. nullptr turns capturing off.
+void setCapture(CommandCapture* c) {
+    capture = c;
+}
+
+// Stream every book's depth changes and trades to pub; each book sends its
+// current depth first. Books added later are attached as they are created.
+// nullptr detaches. The publisher must outlive the engine or be detached.
+void setMarketData(MarketDataPublisher* pub) {
+    vector<OrderBook*> books;
+    {
+        lock_guard<mutex> lock(engineLock);
+        marketData = pub;
+        orderBooks->forEach([&](const string&, OrderBook*& book) { books.push_back(book); });
+    }
+
+    for (OrderBook* book : books) {
+        MatchingShard* shard = shardFor(book->getSymbol());
+        if (!shard) {
+            book->setMarketData(pub);
+            continue;
+        }
+        ShardCommand cmd;
+        cmd.type = ShardCommand::MARKET_DATA;
+        cmd.book = book;
+        cmd.feed = pub;
+        shard->call(cmd);
+    }
 }
 
+// Snapshot every book's live state to data/books.snap. Each book is
+// copied at a consistent point under its own lock (on its shard when
+// sharded); encoding and the fsync happen on the calling thread.
+bool writeSnapshot() {
+    lock_guard<mutex> writer(snapshotWriteMutex);
+
+    vector<OrderBook*> books;
+    {
+        lock_guard<mutex> lock(engineLock);
+        orderBooks->forEach([&](const string&, OrderBook*& book) { books.push_back(book); });
+    }
+
+    vector<BookSnapshot> snaps;
+    snaps.reserve(books.size());
+    size_t resting = 0;
+    for (OrderBook* book : books) {
+        snaps.push_back(bookSnapshot(book));
+        resting += snaps.back().bids.size() + snaps.back().asks.size();
+    }
+
+    bool ok = BookSnapshotFile::write(snapshotPath, snaps);
+    if (ok) LOG_DEBUG("Snapshot: " << snaps.size() << " books, " << resting << " resting orders");
+    return ok;
+}
+
+// Take a snapshot on a background thread every interval
+void startSnapshots(chrono::milliseconds interval) {
+    if (snapshotThread.joinable()) return;
+
+    snapshotThread = thread([this, interval] {
+        unique_lock<mutex> lk(snapshotMutex);
+        while (!snapshotCv.wait_for(lk, interval, [this] { return stopSnapshots; })) {
+            lk.unlock();
+            writeSnapshot();
+            lk.lock();
+        }
+    });
+}
 
 void createUser(string userID, double initialCash) {
+    if (capture) capture->createUser(userID, initialCash);
+    if (userID.size() > User::MAX_ID_LENGTH) {
+        cout << "Error: User ID longer than " << User::MAX_ID_LENGTH << " characters\n";
+        return;
+    }
     lock_guard<mutex> lock(userLock);
     
     if (users->contains(userID)) {
@@ -105,7 +524,7 @@ void createUser(string userID, double initialCash) {
     }
     
     User* user = new User(userID, initialCash);
-    users->insert(userID, user);
+    registerUser(user);
     
     // PERSIST USER IMMEDIATELY
     userStorage.persist(*user);
@@ -115,25 +534,57 @@ void createUser(string userID, double initialCash) {
 
 User* getUser(string userID) {
     lock_guard<mutex> lock(userLock);
-    
-    if (!users->contains(userID)) {
-        return nullptr;
+    return users->get(userID);   // nullptr if unknown
+}
+
+// Credit shares to a user (funding a seller), persisted like any other
+// user change. Goes through the engine so it shows up in captures.
+bool depositStock(const string& userID, const string& symbol, int quantity) {
+    if (capture) capture->depositStock(userID, symbol, quantity);
+    if (quantity <= 0) return false;
+
+    {
+        lock_guard<mutex> lock(userLock);
+        User* user = users->get(userID);
+        if (!user) {
+            cout << "Error: User " << userID << " not found\n";
+            return false;
+        }
+        uint32_t symbolKey = symbolTable().intern(symbol);
+        user->addStock(symbolKey, quantity);
+        userStorage.logChange(userTable().intern(userID), *user, symbolKey);
+        markDirty(user);
     }
-    
-    return users->get(userID);
+    usersChanged();
+    return true;
 }
 
 Order* placeOrder(
     string userID, string symbol,
     string side, double price, int quantity
 ) {
-    // Step 0: Validate stock exists
+    if (capture) capture->placeOrder(userID, symbol, side, price, quantity);
+    Price px = toPrice(price);
+
+    // Resolve both names to their intern keys once; unknown ones stay 0,
+    // which is never a registered book or user
+    uint32_t symbolKey = 0, userKey = 0;
+    symbolTable().find(symbol, symbolKey);
+    userTable().find(userID, userKey);
+
+    // Step 0: Validate stock exists and the price is on its tick grid
+    OrderBook* book;
     {
         lock_guard<mutex> lock(engineLock);
-        if (!orderBooks->contains(symbol)) {
+        book = bookAt(symbolKey);
+        if (!book) {
             cout << "NO SUCH STOCK EXISTS\n";
             return nullptr;
         }
+        if (!isOnTick(px, book->getTickSize())) {
+            cout << "Error: Price " << price << " is not a valid tick for " << symbol << "\n";
+            return nullptr;
+        }
     }
 
     // Step 1: Validate user & reserve resources
@@ -141,49 +592,33 @@ Order* placeOrder(
     {
         scoped_lock lock(engineLock, userLock);
 
-        if (!users->contains(userID)) {
+        User* user = userAt(userKey);
+        if (!user) {
             cout << "Error: User " << userID << " not found\n";
             return nullptr;
         }
 
-        User* user = users->get(userID);
-
-        if (side == "BUY") {
-            double cost = price * quantity;
-            if (!user->deductCash(cost)) {
-                cout << "Error: Insufficient funds. Need $" << cost
-                     << ", have $" << user->getCashBalance() << "\n";
-                return nullptr;
-            }
-        } else { // SELL
-            if (user->getStockQuantity(symbol) < quantity) {
-                cout << "Error: Insufficient shares of " << symbol << "\n";
-                return nullptr;
-            }
-            user->removeStock(symbol, quantity); // lock shares
+        if (!reserveFor(user, userKey, symbol, symbolKey, side, px, quantity)) {
+            return nullptr;
         }
 
-        // PERSIST USER AFTER RESOURCE DEDUCTION
-        userStorage.updateUser(*user);
-
         int orderID = nextOrderID++;
-        order = new Order(orderID, userID, symbol, side, price, quantity);
+        order = new Order(orderID, userID, symbol, side, px, quantity);
         allOrders->insert(orderID, order);
         user->addActiveOrder(orderID);
         
-        // PERSIST USER AFTER ADDING ACTIVE ORDER
-        userStorage.updateUser(*user);
+        // User goes to disk with the next flush
+        markDirty(user);
     }
 
-    // Step 2: Get order book
-    OrderBook* book;
+    // Step 2: Index the order under its book (books are never removed)
     {
         lock_guard<mutex> lock(engineLock);
-        book = orderBooks->get(symbol);
+        orderBookIndex->insert(order->getOrderID(), book);
     }
 
     // Step 3: Add to order book (returns trades)
-    vector<Trade> trades = book->addOrder(order);
+    vector<Trade> trades = bookPlace(book, order);
 
     // Step 3.5: Reload the incoming order from disk to get updated status
     {
@@ -191,9 +626,9 @@ Order* placeOrder(
         DiskOffset off = orderStorage.getOffsetForOrder(order->getOrderID());
         if (off) {
             Order diskOrder = orderStorage.load(off);
-            if (allOrders->contains(order->getOrderID())) {
-                *allOrders->get(order->getOrderID()) = diskOrder;
-                order = allOrders->get(order->getOrderID());
+            if (Order* live = allOrders->get(order->getOrderID())) {
+                *live = diskOrder;
+                order = live;
             }
         }
     }
@@ -207,60 +642,22 @@ Order* placeOrder(
 
         {
             lock_guard<mutex> lock(userLock);
-            if (!users->contains(trade.buyUserID) || !users->contains(trade.sellUserID))
+            User* buyer = userAt(trade.buyUserKey);
+            User* seller = userAt(trade.sellUserKey);
+            if (!buyer || !seller)
                 continue;
 
-            User* buyer = users->get(trade.buyUserID);
-            User* seller = users->get(trade.sellUserID);
-
             // transfer assets/cash
-            buyer->addStock(trade.symbol, trade.quantity);
-            seller->addCash(trade.price * trade.quantity);
-
-            // PERSIST BOTH USERS AFTER TRADE EXECUTION
-            userStorage.updateUser(*buyer);
-            userStorage.updateUser(*seller);
+            settle(trade, buyer, seller);
 
             cout << "Trade executed: " << trade.toString() << "\n";
         }
 
         // Sync matched orders from disk and remove filled active-orders
         {
-            lock_guard<mutex> lock(engineLock);
-            int buyID = trade.buyOrderID;
-            int sellID = trade.sellOrderID;
-
-            // Load and sync buy order from disk
-            DiskOffset buyOff = orderStorage.getOffsetForOrder(buyID);
-            if (buyOff && allOrders->contains(buyID)) {
-                Order diskBuy = orderStorage.load(buyOff);
-                *allOrders->get(buyID) = diskBuy;
-
-                if (diskBuy.isFilled()) {
-                    lock_guard<mutex> ulock(userLock);
-                    if (users->contains(diskBuy.userID)) {
-                        users->get(diskBuy.userID)->removeActiveOrder(buyID);
-                        // PERSIST USER AFTER REMOVING ACTIVE ORDER
-                        userStorage.updateUser(*users->get(diskBuy.userID));
-                    }
-                }
-            }
-
-            // Load and sync sell order from disk
-            DiskOffset sellOff = orderStorage.getOffsetForOrder(sellID);
-            if (sellOff && allOrders->contains(sellID)) {
-                Order diskSell = orderStorage.load(sellOff);
-                *allOrders->get(sellID) = diskSell;
-
-                if (diskSell.isFilled()) {
-                    lock_guard<mutex> ulock(userLock);
-                    if (users->contains(diskSell.userID)) {
-                        users->get(diskSell.userID)->removeActiveOrder(sellID);
-                        // PERSIST USER AFTER REMOVING ACTIVE ORDER
-                        userStorage.updateUser(*users->get(diskSell.userID));
-                    }
-                }
-            }
+            scoped_lock lock(engineLock, userLock);
+            syncMatchedOrder(trade.buyOrderID, trade.buyUserKey);
+            syncMatchedOrder(trade.sellOrderID, trade.sellUserKey);
         }
 
         {
@@ -268,18 +665,23 @@ Order* placeOrder(
             tradeHistory.push_back(trade);
             // PERSIST TRADE IMMEDIATELY
             tradeStorage.persist(trade);
+            if (capture) capture->trade(trade);
         }
     }
 
     // Step 5: Remove incoming order from active-orders if it was filled by matches
     if (order->isFilled()) {
+        {
+            lock_guard<mutex> lock(engineLock);
+            orderBookIndex->remove(order->getOrderID());
+        }
         lock_guard<mutex> lock(userLock);
-        if (users->contains(order->userID)) {
-            users->get(order->userID)->removeActiveOrder(order->getOrderID());
-            // PERSIST USER AFTER REMOVING ACTIVE ORDER
-            userStorage.updateUser(*users->get(order->userID));
+        if (User* owner = userAt(userKey)) {
+            owner->removeActiveOrder(order->getOrderID());
+            markDirty(owner);
         }
     }
+    usersChanged();
 
     // PERSIST METADATA PERIODICALLY (every 10 orders)
     if (nextOrderID % 10 == 0) {
@@ -298,72 +700,307 @@ Order* placeOrder(
 }
 
 void cancelOrder(int orderID, const string& userID) {
+    if (capture) capture->cancelOrder(orderID, userID);
     Order* order = nullptr;
-    int remaining = 0;  // Save this early
-    string side;
-    string symbol;
-    double price;
+    OrderBook* book = nullptr;
     
-    // Step 1: Lock engine and get the order info
+    // Step 1: Find the order's book through the handle index
     {
-        std::scoped_lock lock(engineLock, userLock);
+        lock_guard<mutex> lock(engineLock);
 
-        if (!allOrders->contains(orderID)) {
+        order = allOrders->get(orderID);
+        book = orderBookIndex->get(orderID);
+        if (!order || !book) {
             std::cout << "Error: Order " << orderID << " not found\n";
             return;
         }
 
-        order = allOrders->get(orderID);
-
         if (order->userID != userID) {
             std::cout << "Error: Order " << orderID << " does not belong to " << userID << "\n";
             return;
         }
-        
-        // IMPORTANT: Save values BEFORE cancelling from order book
-        remaining = order->getRemainingQuantity();
-        side = order->side;
-        symbol = order->getSymbol();
-        price = order->price;
     }
 
-    // Step 2: Cancel in order book (this might modify the order object)
-    if (orderBooks->contains(symbol)) {
-        OrderBook* book = orderBooks->get(symbol);
-        book->cancelOrder(orderID);
+    // Step 2: Cancel in order book; it reports the state it cancelled,
+    // so the refund matches what was actually still resting
+    Order cancelled;
+    if (!bookCancel(book, orderID, &cancelled)) {
+        return;
+    }
+    int remaining = cancelled.getRemainingQuantity();
+
+    {
+        lock_guard<mutex> lock(engineLock);
+        orderBookIndex->remove(orderID);
+        order->status = "CANCELLED";
     }
 
-    // Step 3: Refund using saved values
+    // Step 3: Refund the cancelled quantity
     {
         std::scoped_lock lock(userLock);
 
-        if (!users->contains(userID)) return;
-
         User* user = users->get(userID);
+        if (!user) return;
         
-        if (remaining > 0) {
-            if (side == "BUY") {
-                user->addCash(price * remaining);
-            } else { // SELL
-                user->addStock(symbol, remaining);
-            }
-        }
+        if (remaining > 0) refund(user, cancelled, remaining);
 
         // Step 4: Remove from active orders
         user->removeActiveOrder(orderID);
+        markDirty(user);
     }
+    usersChanged();
+
+    std::cout << "Cancelled OrderID " << orderID 
+              << " from " << cancelled.side << " side, Refund processed.\n";
+}
 
-    // After refunding user
+// Batch form of placeOrder for callers that receive orders in bursts.
+// The whole batch is validated and reserved in one engineLock + userLock
+// hold, each symbol's orders then match in one book call (one bookLock
+// hold, or one shard round trip with the shards running side by side),
+// and settlement runs in one pass with the trades written as one batch.
+// Results are in input order; nullptr marks a rejected request.
+//
+// Unlike calling placeOrder in a loop, every order is reserved before any
+// of them matches: an order can't spend cash or shares an earlier order in
+// the same batch only receives by trading. Trade IDs follow input order.
+vector<Order*> placeOrders(const vector<OrderRequest>& requests) {
+    if (capture) capture->placeOrders(requests);
+    vector<Order*> placed(requests.size(), nullptr);
+    vector<BookBatch> batches;
+    unordered_map<OrderBook*, size_t> batchIndex;
+
+    // Step 1: validate and reserve everything, grouping orders by book
     {
-        lock_guard<mutex> lock(userLock);
-        if (users->contains(userID)) {
-            userStorage.updateUser(*users->get(userID));
+        scoped_lock lock(engineLock, userLock);
+
+        for (size_t i = 0; i < requests.size(); i++) {
+            const OrderRequest& req = requests[i];
+            Price px = toPrice(req.price);
+            uint32_t symbolKey = 0, userKey = 0;
+            symbolTable().find(req.symbol, symbolKey);
+            userTable().find(req.userID, userKey);
+
+            OrderBook* book = bookAt(symbolKey);
+            if (!book) {
+                cout << "NO SUCH STOCK EXISTS\n";
+                continue;
+            }
+            if (!isOnTick(px, book->getTickSize())) {
+                cout << "Error: Price " << req.price << " is not a valid tick for " << req.symbol << "\n";
+                continue;
+            }
+            User* user = userAt(userKey);
+            if (!user) {
+                cout << "Error: User " << req.userID << " not found\n";
+                continue;
+            }
+            if (!reserveFor(user, userKey, req.symbol, symbolKey, req.side, px, req.quantity)) continue;
+
+            int orderID = nextOrderID++;
+            Order* order = new Order(orderID, req.userID, req.symbol, req.side, px, req.quantity);
+            allOrders->insert(orderID, order);
+            orderBookIndex->insert(orderID, book);
+            user->addActiveOrder(orderID);
+            markDirty(user);
+            placed[i] = order;
+
+            BookBatch& b = batchFor(book, batches, batchIndex);
+            b.items.push_back(i);
+            b.orders.push_back(order);
         }
     }
-    // Step 5: Mark order as cancelled
-    order->status = "CANCELLED";
-    std::cout << "Cancelled OrderID " << orderID 
-              << " from " << side << " side, Refund processed.\n";
+
+    // Step 2: match, one call per book
+    runBookBatches(batches, true);
+
+    vector<vector<Trade>> tradesOf(requests.size());
+    for (BookBatch& b : batches) {
+        for (size_t k = 0; k < b.items.size() && k < b.result.batchTrades.size(); k++) {
+            tradesOf[b.items[k]] = std::move(b.result.batchTrades[k]);
+        }
+    }
+
+    // Step 3: trade IDs, settlement and order sync for the whole batch
+    vector<Trade> executed;
+    {
+        scoped_lock lock(engineLock, userLock);
+
+        for (size_t i = 0; i < requests.size(); i++) {
+            Order* order = placed[i];
+            if (!order) continue;
+
+            DiskOffset off = orderStorage.getOffsetForOrder(order->getOrderID());
+            if (off) *order = orderStorage.load(off);
+
+            for (Trade& trade : tradesOf[i]) {
+                trade.tradeID = nextTradeID++;
+
+                User* buyer = userAt(trade.buyUserKey);
+                User* seller = userAt(trade.sellUserKey);
+                if (!buyer || !seller)
+                    continue;
+
+                settle(trade, buyer, seller);
+                cout << "Trade executed: " << trade.toString() << "\n";
+
+                syncMatchedOrder(trade.buyOrderID, trade.buyUserKey);
+                syncMatchedOrder(trade.sellOrderID, trade.sellUserKey);
+                executed.push_back(trade);
+            }
+
+            if (order->isFilled()) {
+                orderBookIndex->remove(order->getOrderID());
+                if (User* owner = users->get(order->userID)) {
+                    owner->removeActiveOrder(order->getOrderID());
+                    markDirty(owner);
+                }
+            }
+        }
+    }
+    usersChanged();
+
+    // Step 4: trades go to storage as one batch
+    if (!executed.empty()) {
+        lock_guard<mutex> lock(tradeLock);
+        tradeHistory.insert(tradeHistory.end(), executed.begin(), executed.end());
+        tradeStorage.persistBatch(executed);
+        if (capture) {
+            for (const Trade& trade : executed) capture->trade(trade);
+        }
+    }
+
+    // PERSIST METADATA ONCE PER BATCH
+    Metadata meta;
+    meta.nextOrderID = nextOrderID;
+    meta.nextTradeID = nextTradeID;
+    meta.totalUsers = users->getSize();
+    meta.totalOrders = allOrders->getSize();
+    meta.totalTrades = tradeHistory.size();
+    meta.lastSaveTime = time(nullptr);
+    metadataStorage.saveMetadata(meta);
+
+    for (Order* order : placed) {
+        if (order) cout << "Order Status: " << order->toString() << "\n";
+    }
+    return placed;
+}
+
+// Batch form of cancelOrder: one engineLock hold to find the orders, one
+// book call per symbol, then every refund in one userLock hold. ok[i]
+// says whether request i cancelled anything.
+vector<bool> cancelOrders(const vector<CancelRequest>& requests) {
+    if (capture) capture->cancelOrders(requests);
+    vector<bool> ok(requests.size(), false);
+    vector<Order*> orderOf(requests.size(), nullptr);
+    vector<BookBatch> batches;
+    unordered_map<OrderBook*, size_t> batchIndex;
+
+    // Step 1: find each order's book through the handle index
+    {
+        lock_guard<mutex> lock(engineLock);
+
+        for (size_t i = 0; i < requests.size(); i++) {
+            const CancelRequest& req = requests[i];
+            Order* order = allOrders->get(req.orderID);
+            OrderBook* book = orderBookIndex->get(req.orderID);
+            if (!order || !book) {
+                std::cout << "Error: Order " << req.orderID << " not found\n";
+                continue;
+            }
+            if (order->userID != req.userID) {
+                std::cout << "Error: Order " << req.orderID << " does not belong to " << req.userID << "\n";
+                continue;
+            }
+            orderOf[i] = order;
+
+            BookBatch& b = batchFor(book, batches, batchIndex);
+            b.items.push_back(i);
+            b.orderIDs.push_back(req.orderID);
+        }
+    }
+
+    // Step 2: cancel, one call per book
+    runBookBatches(batches, false);
+
+    // Step 3: refund what was actually still resting
+    vector<Order> cancelledOf(requests.size());
+    {
+        scoped_lock lock(engineLock, userLock);
+
+        for (BookBatch& b : batches) {
+            for (size_t k = 0; k < b.items.size() && k < b.result.batchOk.size(); k++) {
+                if (!b.result.batchOk[k]) continue;
+                size_t i = b.items[k];
+                const Order& cancelled = b.result.batchOrders[k];
+                cancelledOf[i] = cancelled;
+                ok[i] = true;
+
+                orderBookIndex->remove(requests[i].orderID);
+                orderOf[i]->status = "CANCELLED";
+
+                User* user = users->get(requests[i].userID);
+                if (!user) continue;
+
+                int remaining = cancelled.getRemainingQuantity();
+                if (remaining > 0) refund(user, cancelled, remaining);
+                user->removeActiveOrder(requests[i].orderID);
+                markDirty(user);
+            }
+        }
+    }
+    usersChanged();
+
+    for (size_t i = 0; i < requests.size(); i++) {
+        if (!ok[i]) continue;
+        std::cout << "Cancelled OrderID " << requests[i].orderID
+                  << " from " << cancelledOf[i].side << " side, Refund processed.\n";
+    }
+    return ok;
+}
+
+// Reduce a resting order by some quantity, keeping its queue position
+bool reduceOrder(int orderID, const string& userID, int reduceBy) {
+    if (capture) capture->reduceOrder(orderID, userID, reduceBy);
+    Order* order = nullptr;
+    OrderBook* book = nullptr;
+    {
+        lock_guard<mutex> lock(engineLock);
+
+        order = allOrders->get(orderID);
+        book = orderBookIndex->get(orderID);
+        if (!order || !book || order->userID != userID) {
+            std::cout << "Error: Order " << orderID << " cannot be reduced\n";
+            return false;
+        }
+    }
+
+    bool stillResting = false;
+    int removed = bookReduce(book, orderID, reduceBy, stillResting);
+    if (removed == 0) return false;
+
+    bool gone = !stillResting;
+    {
+        lock_guard<mutex> lock(engineLock);
+        if (gone) {
+            orderBookIndex->remove(orderID);
+            order->status = "CANCELLED";
+        }
+    }
+
+    {
+        lock_guard<mutex> lock(userLock);
+        User* user = users->get(userID);
+        if (!user) return true;
+
+        refund(user, *order, removed);
+        if (gone) user->removeActiveOrder(orderID);
+        markDirty(user);
+    }
+    usersChanged();
+
+    std::cout << "Reduced OrderID " << orderID << " by " << removed << "\n";
+    return true;
 }
 
 vector<Trade> getAllTrades() {
@@ -374,54 +1011,83 @@ vector<Trade> getAllTrades() {
 Order* getOrder(int orderID) {
         lock_guard<mutex> lock(engineLock);
         
-        if (!allOrders->contains(orderID)) {
-            return nullptr;
-        }
-        
         return allOrders->get(orderID);
     }
     
 OrderBook* getOrderBook(string symbol) {
         lock_guard<mutex> lock(engineLock);
         
-        if (!orderBooks->contains(symbol)) {
-            return nullptr;
-        }
-        
         return orderBooks->get(symbol);
     }
+
+// Latest BBO of one symbol straight from the book's seqlock: never waits on
+// matching (sharded or not) and never reads disk. False if no such symbol.
+bool getTopOfBook(const string& symbol, TopOfBook& out) {
+    OrderBook* book = getOrderBook(symbol);
+    if (!book) return false;
+    out = book->getTopOfBook();
+    return true;
+}
+
+// BBO of every symbol in one call. engineLock is only held to list the
+// books; each quote is then read lock-free.
+vector<pair<string, TopOfBook>> getAllTopOfBook() {
+    vector<OrderBook*> books;
+    {
+        lock_guard<mutex> lock(engineLock);
+        books.reserve(orderBooks->getSize());
+        orderBooks->forEach([&](const string&, OrderBook*& book) { books.push_back(book); });
+    }
+
+    vector<pair<string, TopOfBook>> quotes;
+    quotes.reserve(books.size());
+    for (OrderBook* book : books) quotes.emplace_back(book->getSymbol(), book->getTopOfBook());
+    return quotes;
+}
     
 void printOrderBook(const string& symbol) {
-        lock_guard<mutex> lock(engineLock);
-        
-        if (!orderBooks->contains(symbol)) {
-            cout << "No order book for symbol: " << symbol << "\n";
+        OrderBook* book;
+        {
+            lock_guard<mutex> lock(engineLock);
+            
+            book = orderBooks->get(symbol);
+            if (!book) {
+                cout << "No order book for symbol: " << symbol << "\n";
+                return;
+            }
+        }
+
+        // A sharded book may only be read on its own thread
+        MatchingShard* shard = shardFor(symbol);
+        if (!shard) {
+            book->printOrderBook();
             return;
         }
-        
-        OrderBook* book = orderBooks->get(symbol);
-        book->printOrderBook();
+        ShardCommand cmd;
+        cmd.type = ShardCommand::PRINT;
+        cmd.book = book;
+        shard->call(cmd);
     }
 
 string getPortfolio(string userID) {
     lock_guard<mutex> lock(userLock);
     
-    if (!users->contains(userID)) {
+    User* user = users->get(userID);
+    if (!user) {
         return "User not found";
     }
-    
-    User* user = users->get(userID);
+
     return user->toString();
 }
     
 double getCashBalance(string userID) {
     lock_guard<mutex> lock(userLock);
     
-    if (!users->contains(userID)) {
+    User* user = users->get(userID);
+    if (!user) {
         return -1;
     }
-    
-    User* user = users->get(userID);
+
     return user->getCashBalance();
 }
     
@@ -430,11 +1096,10 @@ vector<StockHolding> getHoldings(string userID) {
     
     vector<StockHolding> holdings;
     
-    if (!users->contains(userID)) {
+    User* user = users->get(userID);
+    if (!user) {
         return holdings;
     }
-    
-    User* user = users->get(userID);
 
     holdings = user->getAllHoldings();
     
@@ -447,13 +1112,13 @@ vector<Order*> getActiveOrders(string userID) {
     // Acquire engineLock then userLock to follow the global order
     std::scoped_lock lock(engineLock, userLock);
 
-    if (!users->contains(userID)) return orders;
-
     User* user = users->get(userID);
+    if (!user) return orders;
+
     vector<int> ids = user->getActiveOrderIDs();
     for (int id : ids) {
-        if (allOrders->contains(id)) {
-            orders.push_back(allOrders->get(id));
+        if (Order* o = allOrders->get(id)) {
+            orders.push_back(o);
         }
     }
 
@@ -466,7 +1131,7 @@ vector<Trade> getUserTrades(string userID) {
     vector<Trade> userTrades;
     
     for (const Trade& trade : tradeHistory) {
-        if (trade.buyUserID == userID || trade.sellUserID == userID) {
+        if (trade.involves(userID)) {
             userTrades.push_back(trade);
         }
     }
@@ -486,11 +1151,11 @@ void printPortfolio(const string& userID) {
         std::scoped_lock lock(engineLock, userLock);
 
         // get user pointer directly from users hashmap (we hold userLock)
-        if (!users->contains(userID)) {
+        User* user = users->get(userID);
+        if (!user) {
             cout << "User not found\n";
             return;
         }
-        User* user = users->get(userID);
 
         // Copy user state (these return simple copies)
         balance = user->getCashBalance();
@@ -505,7 +1170,7 @@ void printPortfolio(const string& userID) {
     {
         std::lock_guard<std::mutex> tlock(tradeLock);
         for (const Trade &tr : tradeHistory) {
-            if (tr.buyUserID == userID || tr.sellUserID == userID) {
+            if (tr.involves(userID)) {
                 userTrades.push_back(tr);
             }
         }
@@ -553,41 +1218,76 @@ void rebuildAllFromStorage() {
     vector<User> loadedUsers = userStorage.loadAllUsers();
     for (const User& u : loadedUsers) {
         User* userPtr = new User(u);
-        users->insert(userPtr->getUserID(), userPtr);
+        // Stored active orders may be stale; step 4 re-adds the live ones
+        userPtr->clearActiveOrders();
+        registerUser(userPtr);
     }
     cout << "Loaded " << loadedUsers.size() << " users from storage.\n";
     
     // 2️⃣ Rebuild all order books from symbol storage
     vector<string> symbols = symbolStorage.loadAllSymbols();
-    int restoredOrders = 0;
-
-    for (const string& symbol : symbols) {
-        if (!orderBooks->contains(symbol)) {
-            orderBooks->insert(symbol, new OrderBook(symbol, orderStorage));
+    unordered_map<string, Price> ticks = symbolStorage.loadAllTickSizes();
+    vector<OrderBook*> books(symbols.size());
+
+    for (size_t i = 0; i < symbols.size(); i++) {
+        OrderBook* book = orderBooks->get(symbols[i]);
+        if (!book) {
+            auto t = ticks.find(symbols[i]);
+            book = newBook(symbols[i], t != ticks.end() ? t->second : DEFAULT_TICK_SIZE);
+            registerBook(symbols[i], book);
         }
+        books[i] = book;
+    }
 
-        OrderBook* book = orderBooks->get(symbol);
-
-        // 3️⃣ Load orders for this symbol
-        vector<Order> ordersForSymbol = orderStorage.loadAllOrdersForSymbol(symbol);
+    // Latest book snapshot, if it still fits orders.dat
+    vector<BookSnapshot> snaps;
+    unordered_map<string, const BookSnapshot*> snapFor;
+    DiskOffset oldestMark = orderStorage.getDataEnd();
+    if (BookSnapshotFile::read(snapshotPath, snaps)) {
+        for (const BookSnapshot& s : snaps) {
+            if (s.dataMark > orderStorage.getDataEnd()) continue;
+            snapFor[s.symbol] = &s;
+            oldestMark = min(oldestMark, s.dataMark);
+        }
+    }
 
-        for (const Order& order : ordersForSymbol) {
-            if (order.status == "FILLED" || order.status == "CANCELLED") continue;
+    // Orders placed after the snapshot: only the tail of orders.dat is read
+    unordered_map<string, vector<pair<DiskOffset, Order>>> recent;
+    if (!snapFor.empty()) recent = orderStorage.loadLiveOrdersSince(oldestMark);
+
+    // 3️⃣ + 4️⃣ One recovery task per symbol: snapshot + newer orders, or
+    // (no usable snapshot) its live orders from the index. Books are
+    // independent, so no engine lock is needed.
+    vector<vector<pair<DiskOffset, Order>>> live(symbols.size());
+    atomic<int> fromSnapshot(0);
+    parallelFor(symbols.size(), [&](size_t i) {
+        auto s = snapFor.find(symbols[i]);
+        if (s != snapFor.end() && restoreFromSnapshot(*s->second, recent, live[i])) {
+            fromSnapshot++;
+        } else {
+            live[i] = orderStorage.loadLiveOrdersForSymbol(symbols[i]);
+        }
+        books[i]->rebuildFromOrders(live[i]);
+    });
+    if (fromSnapshot > 0) {
+        cout << "Restored " << fromSnapshot << " order books from snapshot.\n";
+    }
 
+    // Engine-wide maps are filled here, on one thread
+    int restoredOrders = 0;
+    for (size_t i = 0; i < symbols.size(); i++) {
+        for (const auto& [offset, order] : live[i]) {
             // Create Order* and add to map
             Order* o = new Order(order);
             allOrders->insert(o->getOrderID(), o);
+            orderBookIndex->insert(o->getOrderID(), books[i]);
             restoredOrders++;
 
             // User should already exist from step 1
-            if (users->contains(order.userID)) {
-                User* u = users->get(order.userID);
+            if (User* u = users->get(order.userID)) {
                 u->addActiveOrder(o->getOrderID());
             }
         }
-
-        // 4️⃣ Rebuild order book tree from storage
-        book->rebuildFromStorage();
     }
 
     // 5️⃣ Load all trades into tradeHistory
@@ -599,7 +1299,14 @@ void rebuildAllFromStorage() {
     cout << "Restored " << restoredOrders << " active orders from storage.\n";
 }
 
-bool addStock(const std::string& symbol, const std::string& userID) {
+bool addStock(const std::string& symbol, const std::string& userID, double tickSize = 0.01) {
+    if (capture) capture->addStock(symbol, userID, tickSize);
+    Price tick = toPrice(tickSize);
+    if (tick <= 0) {
+        std::cout << "Invalid tick size " << tickSize << " for " << symbol << "\n";
+        return false;
+    }
+
     {
         std::scoped_lock lock(engineLock);
 
@@ -613,14 +1320,13 @@ bool addStock(const std::string& symbol, const std::string& userID) {
             return false;
         }
 
-        OrderBook* book = new OrderBook(symbol,orderStorage);
-        orderBooks->insert(symbol, book);
+        registerBook(symbol, newBook(symbol, tick));
 
         std::cout << "Stock " << symbol << " added successfully by " << userID << "\n";
     }
 
     // Persist symbol outside engineLock to avoid deadlock
-    symbolStorage.addSymbol(symbol);
+    symbolStorage.addSymbol(symbol, tick);
 
     return true;
 }
@@ -0,0 +1,180 @@
+#ifndef MATCHINGSHARD_H
+#define MATCHINGSHARD_H
+
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <future>
+#include <atomic>
+#include <vector>
+#include "OrderBook.h"
+#include "../data_structures/MPSCRing.h"
+
+using namespace std;
+
+// What a book command hands back to the submitting thread
+struct ShardResult {
+    vector<Trade> trades;   // PLACE
+    bool ok = false;        // CANCEL: order was resting / REDUCE: order still resting
+    int removed = 0;        // REDUCE: quantity taken off
+    Order order;            // CANCEL: state before the cancel
+    BookSnapshot snapshot;  // SNAPSHOT
+    vector<vector<Trade>> batchTrades;  // PLACE_BATCH, per order
+    vector<bool> batchOk;               // CANCEL_BATCH, per order
+    vector<Order> batchOrders;          // CANCEL_BATCH: states before the cancels
+};
+
+struct ShardCommand {
+    enum Type { PLACE, CANCEL, REDUCE, PRINT, SNAPSHOT, MARKET_DATA,
+                PLACE_BATCH, CANCEL_BATCH, STOP };
+
+    Type type = STOP;
+    OrderBook* book = nullptr;
+    Order* order = nullptr;     // PLACE
+    int orderID = 0;            // CANCEL / REDUCE
+    int quantity = 0;           // REDUCE
+    MarketDataPublisher* feed = nullptr;   // MARKET_DATA
+    const vector<Order*>* orders = nullptr;  // PLACE_BATCH (caller keeps it alive)
+    const vector<int>* orderIDs = nullptr;   // CANCEL_BATCH
+    promise<ShardResult>* result = nullptr;
+    bool ownsResult = false;    // shard deletes the promise once fulfilled
+};
+
+// One matching thread that owns a group of order books.
+//
+// Callers push commands into a bounded lock-free MPSC ring and wait on a
+// future; the shard thread is the only one that ever touches its books, so
+// they run with bookLock switched off (OrderBook::setSingleWriter). Symbols
+// on different shards match fully in parallel.
+//
+// The consumer spins briefly when the ring runs dry and then parks on a
+// condition variable; producers only take the park mutex if it is asleep.
+class MatchingShard {
+private:
+    MPSCRing<ShardCommand> inbound;
+    thread worker;
+
+    mutex parkMutex;
+    condition_variable parkCv;
+    atomic<bool> sleeping;
+
+    atomic<uint64_t> processed;
+
+    static const int SPIN_BEFORE_PARK = 2000;
+
+    void run() {
+        ShardCommand cmd;
+        int idle = 0;
+
+        while (true) {
+            if (!inbound.tryPop(cmd)) {
+                if (++idle < SPIN_BEFORE_PARK) {
+                    this_thread::yield();
+                    continue;
+                }
+                unique_lock<mutex> lk(parkMutex);
+                sleeping.store(true);
+                if (inbound.empty()) {
+                    // Timed so a wakeup racing with the flag can't strand us
+                    parkCv.wait_for(lk, chrono::milliseconds(1));
+                }
+                sleeping.store(false);
+                idle = 0;
+                continue;
+            }
+            idle = 0;
+
+            if (cmd.type == ShardCommand::STOP) break;
+            execute(cmd);
+            processed++;
+        }
+    }
+
+    void execute(ShardCommand& cmd) {
+        ShardResult res;
+
+        switch (cmd.type) {
+        case ShardCommand::PLACE:
+            res.trades = cmd.book->addOrder(cmd.order);
+            res.ok = true;
+            break;
+        case ShardCommand::CANCEL:
+            res.ok = cmd.book->cancelOrder(cmd.orderID, &res.order);
+            break;
+        case ShardCommand::REDUCE: {
+            res.removed = cmd.book->reduceOrder(cmd.orderID, cmd.quantity);
+            Order current;
+            res.ok = cmd.book->findOrder(cmd.orderID, current);
+            break;
+        }
+        case ShardCommand::PRINT:
+            cmd.book->printOrderBook();
+            break;
+        case ShardCommand::SNAPSHOT:
+            res.snapshot = cmd.book->captureSnapshot();
+            break;
+        case ShardCommand::MARKET_DATA:
+            cmd.book->setMarketData(cmd.feed);
+            break;
+        case ShardCommand::PLACE_BATCH:
+            res.batchTrades = cmd.book->addOrders(*cmd.orders);
+            res.ok = true;
+            break;
+        case ShardCommand::CANCEL_BATCH:
+            res.batchOk = cmd.book->cancelOrders(*cmd.orderIDs, res.batchOrders);
+            break;
+        default:
+            break;
+        }
+
+        if (cmd.result) {
+            cmd.result->set_value(std::move(res));
+            if (cmd.ownsResult) delete cmd.result;
+        }
+    }
+
+public:
+    explicit MatchingShard(size_t queueDepth = 4096)
+        : inbound(queueDepth), sleeping(false), processed(0) {
+        worker = thread(&MatchingShard::run, this);
+    }
+
+    ~MatchingShard() {
+        ShardCommand stop;
+        stop.type = ShardCommand::STOP;
+        push(stop);
+        if (worker.joinable()) worker.join();
+    }
+
+    MatchingShard(const MatchingShard&) = delete;
+    MatchingShard& operator=(const MatchingShard&) = delete;
+
+    // Blocks (yielding) while the ring is full: back-pressure on callers
+    void push(const ShardCommand& cmd) {
+        while (!inbound.tryPush(cmd)) {
+            this_thread::yield();
+        }
+        if (sleeping.load()) {
+            lock_guard<mutex> lk(parkMutex);
+            parkCv.notify_one();
+        }
+    }
+
+    future<ShardResult> submit(ShardCommand cmd) {
+        cmd.result = new promise<ShardResult>();
+        cmd.ownsResult = true;
+        future<ShardResult> f = cmd.result->get_future();
+        push(cmd);
+        return f;
+    }
+
+    // Synchronous helper: submit and wait. The promise stays owned by the
+    // shard so it outlives set_value even if the caller wakes up first.
+    ShardResult call(const ShardCommand& cmd) {
+        return submit(cmd).get();
+    }
+
+    uint64_t getProcessedCount() const { return processed.load(); }
+};
+
+#endif
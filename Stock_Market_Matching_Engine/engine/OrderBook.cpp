@@ -1,7 +1,9 @@
 #include "OrderBook.h"
 #include "../storage/OrderStorage.h"
+#include "../core/Log.h"
 #include <iostream>
 #include <algorithm>
+#include <cstring>
 
 using namespace std;
 
@@ -11,9 +13,12 @@ extern OrderStorage orderStorage;
 //OrderStorage orderStorage;
 
 
-OrderBook::OrderBook(std::string sym, OrderStorage& _order ): symbol(sym),orderStorage(_order) {
-    buyTree = new BTree(3);   // degree = 3
-    sellTree = new BTree(3);
+OrderBook::OrderBook(std::string sym, OrderStorage& _order, Price tick,
+                     bool resident, PriceIndexType type)
+    : symbol(sym), tickSize(tick), indexType(type), singleWriter(false),
+      orderStorage(_order), residentMode(resident), marketData(nullptr), mdResync(false) {
+    buyTree = makePriceIndex();
+    sellTree = makePriceIndex();
     pthread_mutex_init(&bookLock, NULL);
 
     //rebuildFromStorage();
@@ -33,371 +38,612 @@ OrderBook::~OrderBook() {
     pthread_mutex_destroy(&bookLock);
 }
 
-// Add order fully persistent
+// Add order fully persistent. Matching works on HotOrder copies (no
+// strings); the caller's Order gets the outcome at the end.
 vector<Trade> OrderBook::addOrder(Order* order) {
-    pthread_mutex_lock(&bookLock);
     vector<Trade> trades;
+    addOrder(order, trades);
+    return trades;
+}
+
+void OrderBook::addOrder(Order* order, vector<Trade>& trades) {
+    trades.clear();
+    lockBook();
+    matchOrder(order, trades);
+    refreshTopOfBook();
+    unlockBook();
+}
+
+vector<vector<Trade>> OrderBook::addOrders(const vector<Order*>& orders) {
+    vector<vector<Trade>> trades(orders.size());
+    lockBook();
+    for (size_t i = 0; i < orders.size(); i++) matchOrder(orders[i], trades[i]);
+    refreshTopOfBook();
+    unlockBook();
+    return trades;
+}
+
+// trades comes in empty (addOrder clears the caller's buffer)
+void OrderBook::matchOrder(Order* order, vector<Trade>& trades) {
 
     // Persist new order first and get its offset
     DiskOffset orderOffset = orderStorage.persist(*order);
-    std::cerr << "[DBG] addOrder: orderID=" << order->orderID
+    LOG_DEBUG("addOrder: orderID=" << order->orderID
               << " side=" << order->side << " price=" << order->price
               << " qty=" << order->getRemainingQuantity()
-              << " offset=" << orderOffset << "\n";
+              << " offset=" << orderOffset);
     
     if (orderOffset == 0) {
-        std::cerr << "[ERR] persist returned 0\n";
-        pthread_mutex_unlock(&bookLock);
-        return trades;
+        LOG_ERROR("persist returned 0");
+        return;
     }
 
-    bool isBuy = order->getSide();
+    HotOrder incoming = HotOrder::fromOrder(*order);
+    bool isBuy = incoming.isBuy();
 
     if (isBuy) {
         // BUY order - match against SELL tree
         DiskOffset bestSellOffset = sellTree->getBestSell();
-        std::cerr << "[DBG] addOrder: initial bestSellOffset=" << bestSellOffset << "\n";
+        LOG_DEBUG("addOrder: initial bestSellOffset=" << bestSellOffset);
         
-        while (bestSellOffset != 0 && order->getRemainingQuantity() > 0) {
-            Order bestSell = orderStorage.load(bestSellOffset);
+        while (bestSellOffset != 0 && incoming.remainingQty > 0) {
+            HotOrder bestSell = loadResting(bestSellOffset);
             
-            std::cerr << "[DBG] compare: incoming(orderID=" << order->orderID 
-                      << ",price=" << order->price << ")"
+            LOG_DEBUG("compare: incoming(orderID=" << incoming.orderID 
+                      << ",price=" << incoming.price << ")"
                       << " vs bestSell(offset=" << bestSellOffset 
                       << ",orderID=" << bestSell.orderID
                       << ",price=" << bestSell.price 
-                      << ",rem=" << bestSell.getRemainingQuantity() << ")\n";
+                      << ",rem=" << bestSell.remainingQty << ")");
 
             // Check if price matches
-            if (bestSell.price > order->price) {
-                std::cerr << "[DBG] Price mismatch, stopping match\n";
+            if (bestSell.price > incoming.price) {
+                LOG_DEBUG("Price mismatch, stopping match");
                 break;
             }
 
             // Self-match prevention
-            if (order->userID == bestSell.userID) {
-                std::cerr << "[DBG] Self-match detected, skipping\n";
-                double nextPrice = sellTree->nextKey(bestSell.price);
-                bestSellOffset = (nextPrice != -1) ? sellTree->search(nextPrice)->peek() : 0;
+            if (incoming.userKey == bestSell.userKey) {
+                LOG_DEBUG("Self-match detected, skipping");
+                Price nextPrice = sellTree->nextKey(bestSell.price);
+                bestSellOffset = (nextPrice != NO_PRICE) ? sellTree->search(nextPrice)->peek() : 0;
                 if (!bestSellOffset) break;
                 continue;
             }
 
             // Calculate matched quantity
-            int matchedQty = std::min(order->getRemainingQuantity(), 
-                                     bestSell.getRemainingQuantity());
+            int matchedQty = std::min(incoming.remainingQty, bestSell.remainingQty);
             
-            std::cerr << "[DBG] matched qty=" << matchedQty 
+            LOG_DEBUG("matched qty=" << matchedQty 
                       << " updating disk offsets order=" << orderOffset 
-                      << " bestSell=" << bestSellOffset << "\n";
-
-            // Create trade (use copies to avoid pointer issues)
-            Order incomingCopy = *order;
-            Order counterCopy = bestSell;
+                      << " bestSell=" << bestSellOffset);
 
             trades.emplace_back(
                 100 + trades.size(),
-                incomingCopy,
-                counterCopy,
+                incoming,
+                bestSell,
                 matchedQty,
-                counterCopy.price
+                bestSell.price
             );
 
             // Update quantities and statuses
-            order->reduceRemainingQty(matchedQty);
+            incoming.reduceRemainingQty(matchedQty);
             bestSell.reduceRemainingQty(matchedQty);
 
-            order->status = (order->getRemainingQuantity() == 0) ? "FILLED" : "PARTIAL_FILL";
-            bestSell.status = (bestSell.getRemainingQuantity() == 0) ? "FILLED" : "PARTIAL_FILL";
-
-            std::cerr << "[DBG] After match: order->rem=" << order->getRemainingQuantity()
-                      << " bestSell.rem=" << bestSell.getRemainingQuantity() << "\n";
+            LOG_DEBUG("After match: incoming.rem=" << incoming.remainingQty
+                      << " bestSell.rem=" << bestSell.remainingQty);
 
             // Save updated orders to disk
-            orderStorage.save(*order, orderOffset);
-            orderStorage.save(bestSell, bestSellOffset);
-
-            // ✅ ALWAYS dequeue the matched order
-            OrderQueue* sellQueue = sellTree->search(bestSell.price);
-            if (sellQueue) {
-                sellQueue->dequeue();
-                std::cerr << "[DBG] Dequeued sell order, queue size now=" 
-                          << sellQueue->getSize() << "\n";
-            }
-
-            // ✅ If counter order still has quantity, re-insert it
-            if (bestSell.getRemainingQuantity() > 0) {
-                std::cerr << "[DBG] Counter order partial fill, re-inserting offset=" 
-                          << bestSellOffset << "\n";
-                sellTree->insert(bestSell.price, bestSellOffset);
+            storeOrder(incoming, orderOffset);
+            storeOrder(bestSell, bestSellOffset);
+            publishTrade(true, bestSell.price, matchedQty);
+
+            // A filled counter order leaves the book; a partial fill keeps
+            // its place at the front of the level
+            restingChanged(bestSell, matchedQty, bestSell.isFilled());
+            if (bestSell.isFilled()) {
+                LOG_DEBUG("Removed filled sell order " << bestSell.orderID);
             }
 
             // Get next best sell order
             bestSellOffset = sellTree->getBestSell();
-            std::cerr << "[DBG] Next bestSellOffset=" << bestSellOffset << "\n";
+            LOG_DEBUG("Next bestSellOffset=" << bestSellOffset);
         }
 
         // If incoming order has remaining quantity, add to buy tree
-        if (order->getRemainingQuantity() > 0) {
-            std::cerr << "[DBG] Incoming order has remaining qty=" 
-                      << order->getRemainingQuantity() << ", adding to buy tree\n";
-            buyTree->insert(order->price, orderOffset);
+        if (incoming.remainingQty > 0) {
+            LOG_DEBUG("Incoming order has remaining qty=" 
+                      << incoming.remainingQty << ", adding to buy tree");
+            OrderNode* node = buyTree->insert(incoming.price, orderOffset, incoming.orderID);
+            trackOrder(incoming, orderOffset, buyTree->search(incoming.price), node);
         }
 
     } else {
         // SELL order - match against BUY tree
         DiskOffset bestBuyOffset = buyTree->getBest();
-        std::cerr << "[DBG] addOrder: initial bestBuyOffset=" << bestBuyOffset << "\n";
+        LOG_DEBUG("addOrder: initial bestBuyOffset=" << bestBuyOffset);
 
-        while (bestBuyOffset != 0 && order->getRemainingQuantity() > 0) {
-            Order bestBuy = orderStorage.load(bestBuyOffset);
+        while (bestBuyOffset != 0 && incoming.remainingQty > 0) {
+            HotOrder bestBuy = loadResting(bestBuyOffset);
             
-            std::cerr << "[DBG] compare: incoming(orderID=" << order->orderID 
-                      << ",price=" << order->price << ")"
+            LOG_DEBUG("compare: incoming(orderID=" << incoming.orderID 
+                      << ",price=" << incoming.price << ")"
                       << " vs bestBuy(offset=" << bestBuyOffset 
                       << ",orderID=" << bestBuy.orderID
                       << ",price=" << bestBuy.price 
-                      << ",rem=" << bestBuy.getRemainingQuantity() << ")\n";
+                      << ",rem=" << bestBuy.remainingQty << ")");
 
             // Check if price matches
-            if (bestBuy.price < order->price) {
-                std::cerr << "[DBG] Price mismatch, stopping match\n";
+            if (bestBuy.price < incoming.price) {
+                LOG_DEBUG("Price mismatch, stopping match");
                 break;
             }
 
             // Self-match prevention
-            if (order->userID == bestBuy.userID) {
-                std::cerr << "[DBG] Self-match detected, skipping\n";
-                double prevPrice = buyTree->prevKey(bestBuy.price);
-                bestBuyOffset = (prevPrice != -1) ? buyTree->search(prevPrice)->peek() : 0;
+            if (incoming.userKey == bestBuy.userKey) {
+                LOG_DEBUG("Self-match detected, skipping");
+                Price prevPrice = buyTree->prevKey(bestBuy.price);
+                bestBuyOffset = (prevPrice != NO_PRICE) ? buyTree->search(prevPrice)->peek() : 0;
                 if (!bestBuyOffset) break;
                 continue;
             }
 
             // Calculate matched quantity
-            int matchedQty = std::min(order->getRemainingQuantity(), 
-                                     bestBuy.getRemainingQuantity());
+            int matchedQty = std::min(incoming.remainingQty, bestBuy.remainingQty);
             
-            std::cerr << "[DBG] matched qty=" << matchedQty 
+            LOG_DEBUG("matched qty=" << matchedQty 
                       << " updating disk offsets order=" << orderOffset 
-                      << " bestBuy=" << bestBuyOffset << "\n";
-
-            // Create trade (use copies)
-            Order incomingCopy = *order;
-            Order counterCopy = bestBuy;
+                      << " bestBuy=" << bestBuyOffset);
 
             trades.emplace_back(
                 200 + trades.size(),
-                counterCopy,
-                incomingCopy,
+                bestBuy,
+                incoming,
                 matchedQty,
-                counterCopy.price
+                bestBuy.price
             );
 
             // Update quantities and statuses
-            order->reduceRemainingQty(matchedQty);
+            incoming.reduceRemainingQty(matchedQty);
             bestBuy.reduceRemainingQty(matchedQty);
 
-            order->status = (order->getRemainingQuantity() == 0) ? "FILLED" : "PARTIAL_FILL";
-            bestBuy.status = (bestBuy.getRemainingQuantity() == 0) ? "FILLED" : "PARTIAL_FILL";
-
-            std::cerr << "[DBG] After match: order->rem=" << order->getRemainingQuantity()
-                      << " bestBuy.rem=" << bestBuy.getRemainingQuantity() << "\n";
+            LOG_DEBUG("After match: incoming.rem=" << incoming.remainingQty
+                      << " bestBuy.rem=" << bestBuy.remainingQty);
 
             // Save updated orders to disk
-            orderStorage.save(*order, orderOffset);
-            orderStorage.save(bestBuy, bestBuyOffset);
-
-            // ✅ ALWAYS dequeue the matched order
-            OrderQueue* buyQueue = buyTree->search(bestBuy.price);
-            if (buyQueue) {
-                buyQueue->dequeue();
-                std::cerr << "[DBG] Dequeued buy order, queue size now=" 
-                          << buyQueue->getSize() << "\n";
-            }
-
-            // ✅ If counter order still has quantity, re-insert it
-            if (bestBuy.getRemainingQuantity() > 0) {
-                std::cerr << "[DBG] Counter order partial fill, re-inserting offset=" 
-                          << bestBuyOffset << "\n";
-                buyTree->insert(bestBuy.price, bestBuyOffset);
+            storeOrder(incoming, orderOffset);
+            storeOrder(bestBuy, bestBuyOffset);
+            publishTrade(false, bestBuy.price, matchedQty);
+
+            // A filled counter order leaves the book; a partial fill keeps
+            // its place at the front of the level
+            restingChanged(bestBuy, matchedQty, bestBuy.isFilled());
+            if (bestBuy.isFilled()) {
+                LOG_DEBUG("Removed filled buy order " << bestBuy.orderID);
             }
 
             // Get next best buy order
             bestBuyOffset = buyTree->getBest();
-            std::cerr << "[DBG] Next bestBuyOffset=" << bestBuyOffset << "\n";
+            LOG_DEBUG("Next bestBuyOffset=" << bestBuyOffset);
         }
 
         // If incoming order has remaining quantity, add to sell tree
-        if (order->getRemainingQuantity() > 0) {
-            std::cerr << "[DBG] Incoming order has remaining qty=" 
-                      << order->getRemainingQuantity() << ", adding to sell tree\n";
-            sellTree->insert(order->price, orderOffset);
+        if (incoming.remainingQty > 0) {
+            LOG_DEBUG("Incoming order has remaining qty=" 
+                      << incoming.remainingQty << ", adding to sell tree");
+            OrderNode* node = sellTree->insert(incoming.price, orderOffset, incoming.orderID);
+            trackOrder(incoming, orderOffset, sellTree->search(incoming.price), node);
         }
     }
-std::cerr << "[DBG] addOrder: about to unlock bookLock\n";
-    pthread_mutex_unlock(&bookLock);
-    
-    std::cerr << "[DBG] addOrder: unlocked successfully\n";
-    std::cerr << "[DBG] addOrder complete: " << trades.size() << " trades executed\n";
-    return trades;
-    cout << "Still here!";
+
+    // Hand the outcome back to the caller's Order
+    order->remainingQty = incoming.remainingQty;
+    if (!trades.empty()) {
+        order->status = incoming.isFilled() ? "FILLED" : "PARTIAL_FILL";
+        topWork.lastPrice = trades.back().price;
+        topWork.lastQuantity = trades.back().quantity;
+    }
+
+    LOG_DEBUG("addOrder complete: " << trades.size() << " trades executed");
 }
 
-// Cancel order fully persistent
-void OrderBook::cancelOrder(int orderID) {
-    pthread_mutex_lock(&bookLock);
-    bool found = false;
+// Cancel order fully persistent: O(1) through the handle index
+bool OrderBook::cancelOrder(int orderID, Order* cancelled) {
+    lockBook();
+    bool ok = cancelResting(orderID, cancelled);
+    if (ok) refreshTopOfBook();
+    unlockBook();
+    return ok;
+}
 
-    // Check BUY tree
-    double price = buyTree->getLowestKey();
-    double highest = buyTree->getHighestKey();
-    while (price != -1 && price <= highest) {
-        OrderQueue* q = buyTree->search(price);
-        if (q && q->getSize() > 0) {
-            DiskOffset off = q->removeOrder(orderID, orderStorage);
-            if (off != 0) {
-                Order o = orderStorage.load(off);
-                o.cancel();
-                orderStorage.save(o, off);
-                cout << "Cancelled OrderID " << orderID << " from BUY side\n";
-                found = true;
-                break;
-            }
-        }
-        double next = buyTree->nextKey(price);
-        if (next == -1 || next == price) break;
-        price = next;
+// cancelled[i] is the state order i had before its cancel
+vector<bool> OrderBook::cancelOrders(const vector<int>& orderIDs, vector<Order>& cancelled) {
+    vector<bool> ok(orderIDs.size(), false);
+    cancelled.assign(orderIDs.size(), Order());
+    lockBook();
+    for (size_t i = 0; i < orderIDs.size(); i++) ok[i] = cancelResting(orderIDs[i], &cancelled[i]);
+    refreshTopOfBook();
+    unlockBook();
+    return ok;
+}
+
+bool OrderBook::cancelResting(int orderID, Order* cancelled) {
+    const OrderHandle* h = handles.find(orderID);
+    if (!h) {
+        LOG_DEBUG("cancelOrder: orderID " << orderID << " not resting in " << symbol);
+        return false;
     }
 
-    // Check SELL tree
-    if (!found) {
-        price = sellTree->getLowestKey();
-        highest = sellTree->getHighestKey();
-        while (price != -1 && price <= highest) {
-            OrderQueue* q = sellTree->search(price);
-            if (q && q->getSize() > 0) {
-                DiskOffset off = q->removeOrder(orderID, orderStorage);
-                if (off != 0) {
-                    Order o = orderStorage.load(off);
-                    o.cancel();
-                    orderStorage.save(o, off);
-                    cout << "Cancelled OrderID " << orderID << " from SELL side\n";
-                    found = true;
-                    break;
-                }
-            }
-            double next = sellTree->nextKey(price);
-            if (next == -1 || next == price) break;
-            price = next;
-        }
+    DiskOffset off = h->offset;
+    HotOrder o = loadResting(off);
+    if (cancelled) *cancelled = o.toOrder();   // state before the cancel (remaining qty)
+
+    restingChanged(o, o.remainingQty, true);
+    o.cancel();
+    storeOrder(o, off);
+    LOG_DEBUG("Cancelled OrderID " << orderID << " from " << (o.isBuy() ? "BUY" : "SELL") << " side");
+    return true;
+}
+
+// Reduce a resting order's remaining quantity without losing time priority.
+// Reducing by the whole remaining quantity cancels the order.
+int OrderBook::reduceOrder(int orderID, int reduceBy) {
+    if (reduceBy <= 0) return 0;
+
+    lockBook();
+
+    const OrderHandle* h = handles.find(orderID);
+    if (!h) {
+        unlockBook();
+        return 0;
     }
 
-    if (!found)
-        cout << "OrderID " << orderID << " not found. Cancel failed.\n";
+    DiskOffset off = h->offset;
+    HotOrder o = loadResting(off);
+    int removed = std::min(reduceBy, o.remainingQty);
+    bool leaves = (removed == o.remainingQty);
+    restingChanged(o, removed, leaves);
+    if (leaves) {
+        o.cancel();
+    } else {
+        o.remainingQty -= removed;
+    }
+    storeOrder(o, off);
 
-    pthread_mutex_unlock(&bookLock);
+    refreshTopOfBook();
+    unlockBook();
+    return removed;
+}
+
+bool OrderBook::findOrder(int orderID, Order& out) {
+    lockBook();
+
+    const OrderHandle* h = handles.find(orderID);
+    bool found = (h != nullptr);
+    if (found) out = loadResting(h->offset).toOrder();
+
+    unlockBook();
+    return found;
 }
 
 // Get best bid fully persistent
 Order OrderBook::getBestBid() {
-    pthread_mutex_lock(&bookLock);
+    lockBook();
     DiskOffset off = buyTree->getBest();
     Order o;
-    if (off != 0) o = orderStorage.load(off);
-    pthread_mutex_unlock(&bookLock);
+    if (off != 0) o = loadResting(off).toOrder();
+    unlockBook();
     return o;
 }
 
 // Get best ask fully persistent
 Order OrderBook::getBestAsk() {
-    pthread_mutex_lock(&bookLock);
+    lockBook();
     DiskOffset off = sellTree->getBestSell();
     Order o;
-    if (off != 0) o = orderStorage.load(off);
-    pthread_mutex_unlock(&bookLock);
+    if (off != 0) o = loadResting(off).toOrder();
+    unlockBook();
     return o;
 }
 
 // Print order book fully persistent
 void OrderBook::printOrderBook() {
-    pthread_mutex_lock(&bookLock);
+    lockBook();
 
     cout << "\nORDER BOOK (" << symbol << ")\n";
 
     // BUY SIDE
     cout << "BUY SIDE\n";
-    double price = buyTree->getHighestKey();
-    double lowest = buyTree->getLowestKey();
-    while (price != -1 && price >= lowest) {
+    Price price = buyTree->getHighestKey();
+    Price lowest = buyTree->getLowestKey();
+    while (price != NO_PRICE && price >= lowest) {
         OrderQueue* q = buyTree->search(price);
         if (q && q->getSize() > 0) q->printQueue(orderStorage);
-        double prev = buyTree->prevKey(price);
-        if (prev == price || prev == -1) break;
+        Price prev = buyTree->prevKey(price);
+        if (prev == price || prev == NO_PRICE) break;
         price = prev;
     }
 
     // SELL SIDE
     cout << "SELL SIDE\n";
     price = sellTree->getLowestKey();
-    double highest = sellTree->getHighestKey();
-    while (price != -1 && price <= highest) {
+    Price highest = sellTree->getHighestKey();
+    while (price != NO_PRICE && price <= highest) {
         OrderQueue* q = sellTree->search(price);
         if (q && q->getSize() > 0) q->printQueue(orderStorage);
-        double next = sellTree->nextKey(price);
-        if (next == price || next == -1) break;
+        Price next = sellTree->nextKey(price);
+        if (next == price || next == NO_PRICE) break;
         price = next;
     }
 
-    pthread_mutex_unlock(&bookLock);
+    unlockBook();
 }
 
 string OrderBook::getSymbol() const {
     return symbol;
 }
 
+Price OrderBook::getTickSize() const {
+    return tickSize;
+}
+
+size_t OrderBook::getPoolSlabCount() const {
+    return pools.getSlabCount();
+}
+
+void OrderBook::reserveOrders(size_t n) {
+    lockBook();
+    pools.nodes.reserve(n);
+    handles.reserve(handles.getSize() + (int)n);
+    if (residentMode) residentOrders.reserve(residentOrders.getSize() + (int)n);
+    unlockBook();
+}
+
 void OrderBook::rebuildFromStorage() {
-    pthread_mutex_lock(&bookLock);
-    
-    vector<Order> allOrders = orderStorage.loadAllOrdersForSymbol(symbol);
-    
+    rebuildFromOrders(orderStorage.loadLiveOrdersForSymbol(symbol));
+}
+
+void OrderBook::rebuildFromOrders(const vector<pair<DiskOffset, Order>>& live) {
     // ✅ ADD: Don't rebuild if no orders
-    if (allOrders.empty()) {
-        pthread_mutex_unlock(&bookLock);
+    if (live.empty()) {
         return;  // Don't print anything, just skip
     }
+
+    lockBook();
     
     delete buyTree;
     delete sellTree;
-    buyTree = new BTree(3);
-    sellTree = new BTree(3);
+    buyTree = makePriceIndex();
+    sellTree = makePriceIndex();
+    residentOrders.clear(residentMode ? (int)live.size() : 0);
+    handles.clear((int)live.size());
+    pools.nodes.reserve(live.size());
+
+    // Subscribers get the rebuilt book in one go rather than per order
+    MarketDataPublisher* feed = marketData;
+    marketData = nullptr;
+    for (const auto& [offset, o] : live) {
+        PriceIndex* tree = o.getSide() ? buyTree : sellTree;
+        OrderNode* node = tree->insert(o.price, offset, o.orderID);
+        trackOrder(HotOrder::fromOrder(o), offset, tree->search(o.price), node);
+    }
+    marketData = feed;
+    if (marketData) mdResync = !publishDepth();
+    refreshTopOfBook();
 
-    for (const Order& o : allOrders) {
-        if (o.status != "ACTIVE" && o.status != "PARTIAL_FILL") {
-            continue;
-        }
-        
-        if (o.getRemainingQuantity() <= 0) {
-            continue;
-        }
+    unlockBook();
+    
+    // One insertion so lines from parallel rebuilds don't interleave
+    cout << ("Rebuilt order book for " + symbol + " with "
+             + to_string(live.size()) + " orders from storage.\n");
+}
 
-        DiskOffset offset = orderStorage.getOffsetForOrder(o.orderID);
-        if (offset == 0) continue;
+BookSnapshot OrderBook::captureSnapshot() {
+    lockBook();
+
+    BookSnapshot snap;
+    snap.symbol = symbol;
+    snap.tickSize = tickSize;
+    // Our own orders are persisted under bookLock, so nothing of ours
+    // can land between this mark and the copy below
+    snap.dataMark = orderStorage.getDataEnd();
+    snap.bids.reserve(handles.getSize());
+    snapshotSide(buyTree, true, snap.bids);
+    snapshotSide(sellTree, false, snap.asks);
+
+    unlockBook();
+    return snap;
+}
 
-        if (o.getSide()) {
-            buyTree->insert(o.price, offset);
-        } else {
-            sellTree->insert(o.price, offset);
+// Best price first, FIFO within each level
+void OrderBook::snapshotSide(PriceIndex* tree, bool bids, vector<SnapshotOrder>& out) {
+    Price price = bids ? tree->getHighestKey() : tree->getLowestKey();
+    while (price != NO_PRICE) {
+        if (OrderQueue* q = tree->search(price)) {
+            for (const OrderNode* n = q->getFront(); n; n = n->next) {
+                out.push_back({n->orderOffset, loadResting(n->orderOffset).toRecord()});
+            }
         }
+        Price next = bids ? tree->prevKey(price) : tree->nextKey(price);
+        if (next == price) break;
+        price = next;
     }
-
-    pthread_mutex_unlock(&bookLock);
-    
-    cout << "Rebuilt order book for " << symbol << " with " 
-         << allOrders.size() << " orders from storage.\n";
 }
 
 Order OrderBook::loadOrderFromStorage(int orderID) {
     return orderStorage.loadOrder(orderID);
 }
 
+HotOrder OrderBook::loadResting(DiskOffset offset) {
+    if (residentMode) {
+        if (const HotOrder* o = residentOrders.find(offset)) return *o;
+    }
+    OrderRecord rec{};
+    orderStorage.loadRecord(offset, rec);
+    return HotOrder::fromRecord(rec);
+}
+
+void OrderBook::storeOrder(const HotOrder& order, DiskOffset offset) {
+    if (!residentMode) {
+        orderStorage.saveRecord(order.toRecord(), offset);
+        return;
+    }
+
+    if (HotOrder* resident = residentOrders.find(offset)) {
+        if (order.remainingQty > 0 && order.status != OrderStatus::CANCELLED)
+            *resident = order;
+        else
+            residentOrders.remove(offset);  // filled or cancelled, leaves the book
+    }
+    orderStorage.saveRecordAsync(order.toRecord(), offset);
+}
+
+void OrderBook::makeResident(const HotOrder& order, DiskOffset offset) {
+    if (residentMode) residentOrders.insert(offset, order);
+}
+
+PriceIndex* OrderBook::makePriceIndex() {
+    if (indexType == PriceIndexType::BTREE) {
+        return new BTree(3, &pools);   // degree = 3
+    }
+    return new PriceLadder(tickSize, &pools);
+}
+
+void OrderBook::trackOrder(const HotOrder& order, DiskOffset offset,
+                           OrderQueue* level, OrderNode* node) {
+    handles.insert(order.orderID, OrderHandle{level, node, offset});
+    makeResident(order, offset);
+
+    level->addVolume(order.remainingQty);
+    publishLevel(order.isBuy(), order.price, level);
+}
+
+bool OrderBook::unlinkOrder(int orderID) {
+    const OrderHandle* h = handles.find(orderID);
+    if (!h) return false;
+
+    h->level->unlink(h->node);
+    handles.remove(orderID);
+    return true;
+}
+
+
+// qtyRemoved came off a resting order (fill, cancel, reduce); leaves = it
+// is gone from the book. Keeps the level total and publishes it.
+void OrderBook::restingChanged(const HotOrder& order, int qtyRemoved, bool leaves) {
+    const OrderHandle* h = handles.find(order.orderID);
+    if (!h) return;
+
+    OrderQueue* level = h->level;   // levels outlive their orders
+    level->addVolume(-qtyRemoved);
+    if (leaves) unlinkOrder(order.orderID);
+    publishLevel(order.isBuy(), order.price, level);
+}
+
+void OrderBook::setMarketData(MarketDataPublisher* pub) {
+    lockBook();
+    marketData = pub;
+    mdResync = false;
+    if (marketData && !publishDepth()) mdResync = true;
+    unlockBook();
+}
+
+void OrderBook::publishLevel(bool buy, Price price, const OrderQueue* level) {
+    if (!marketData) return;
+
+    MarketDataEvent ev;
+    ev.type = MarketDataEvent::LEVEL;
+    ev.side = buy ? 1 : 0;
+    ev.price = price;
+    ev.quantity = level->getVolume();
+    ev.orders = level->getSize();
+    publishEvent(ev);
+}
+
+void OrderBook::publishTrade(bool aggressorBuy, Price price, int quantity) {
+    if (!marketData) return;
+
+    MarketDataEvent ev;
+    ev.type = MarketDataEvent::TRADE;
+    ev.side = aggressorBuy ? 1 : 0;
+    ev.price = price;
+    ev.quantity = quantity;
+    publishEvent(ev);
+}
+
+// A lost level update would leave subscribers with a wrong book, so after
+// a drop we stop sending deltas and re-send the depth once there is room
+void OrderBook::publishEvent(MarketDataEvent& ev) {
+    if (mdResync) {
+        if (!publishDepth()) return;   // still full; try again next change
+        mdResync = false;
+        if (ev.type == MarketDataEvent::LEVEL) return;   // depth covers it
+    }
+
+    memcpy(ev.symbol, symbol.data(), min(symbol.size(), sizeof(ev.symbol)));
+    if (!marketData->publish(ev)) mdResync = true;
+}
+
+// CLEAR, then every non-empty level. False if the ring filled up part way.
+bool OrderBook::publishDepth() {
+    MarketDataEvent ev;
+    ev.type = MarketDataEvent::CLEAR;
+    memcpy(ev.symbol, symbol.data(), min(symbol.size(), sizeof(ev.symbol)));
+    if (!marketData->publish(ev)) return false;
+
+    return publishSide(buyTree, true) && publishSide(sellTree, false);
+}
+
+bool OrderBook::publishSide(PriceIndex* tree, bool bids) {
+    MarketDataEvent ev;
+    ev.type = MarketDataEvent::LEVEL;
+    ev.side = bids ? 1 : 0;
+    memcpy(ev.symbol, symbol.data(), min(symbol.size(), sizeof(ev.symbol)));
+
+    Price price = bids ? tree->getHighestKey() : tree->getLowestKey();
+    while (price != NO_PRICE) {
+        OrderQueue* q = tree->search(price);
+        if (q && q->getSize() > 0) {
+            ev.price = price;
+            ev.quantity = q->getVolume();
+            ev.orders = q->getSize();
+            if (!marketData->publish(ev)) return false;
+        }
+        Price next = bids ? tree->prevKey(price) : tree->nextKey(price);
+        if (next == price) break;
+        price = next;
+    }
+    return true;
+}
+
+// Best non-empty level of one side (BTree levels can linger empty)
+OrderQueue* OrderBook::bestLevel(PriceIndex* tree, bool bids, Price& price) {
+    price = bids ? tree->getHighestKey() : tree->getLowestKey();
+    while (price != NO_PRICE) {
+        OrderQueue* q = tree->search(price);
+        if (q && q->getSize() > 0) return q;
+        Price next = bids ? tree->prevKey(price) : tree->nextKey(price);
+        if (next == price) break;
+        price = next;
+    }
+    price = NO_PRICE;
+    return nullptr;
+}
+
+// Recompute the BBO from the level totals and publish it. Two key lookups
+// in the common case; no order is loaded.
+void OrderBook::refreshTopOfBook() {
+    Price price;
+    OrderQueue* bid = bestLevel(buyTree, true, price);
+    topWork.bidPrice = price;
+    topWork.bidQuantity = bid ? bid->getVolume() : 0;
+    topWork.bidOrders = bid ? bid->getSize() : 0;
+
+    OrderQueue* ask = bestLevel(sellTree, false, price);
+    topWork.askPrice = price;
+    topWork.askQuantity = ask ? ask->getVolume() : 0;
+    topWork.askOrders = ask ? ask->getSize() : 0;
+
+    topWork.sequence++;
+    topOfBook.store(topWork);
+}
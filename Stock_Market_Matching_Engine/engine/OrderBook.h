@@ -5,42 +5,157 @@
 #include <vector>
 #include <pthread.h>  
 #include "../data_structures/BTree.h"
+#include "../data_structures/PriceLadder.h"
 #include "../core/Order.h"
 #include "../core/Trade.h"
+#include "../storage/BookSnapshot.h"
+#include "../data_structures/SeqLock.h"
+#include "../data_structures/MyHashMap.h"
+#include "MarketDataPublisher.h"
 #include <algorithm>  
 
 using namespace std;
 
+// Where a resting order lives: its price level, its queue node and its record
+struct OrderHandle {
+    OrderQueue* level;
+    OrderNode* node;
+    DiskOffset offset;
+};
+
+// Best bid / ask with their level totals and the last trade. Prices are
+// NO_PRICE for an empty side or before the first trade. sequence counts
+// updates, so a reader can tell whether anything moved since its last look.
+struct TopOfBook {
+    Price bidPrice = NO_PRICE;
+    int64_t bidQuantity = 0;
+    int32_t bidOrders = 0;
+    int32_t askOrders = 0;
+    Price askPrice = NO_PRICE;
+    int64_t askQuantity = 0;
+    Price lastPrice = NO_PRICE;
+    int64_t lastQuantity = 0;
+    uint64_t sequence = 0;
+};
+
 class OrderBook {
 private:
     string symbol;
-    BTree* buyTree;   // Max heap for bids
-    BTree* sellTree;  // Min heap for asks
+    Price tickSize;
+    PriceIndexType indexType;
+    OrderPools pools;      // queue nodes and levels for both sides
+    PriceIndex* buyTree;   // Max heap for bids
+    PriceIndex* sellTree;  // Min heap for asks
     pthread_mutex_t bookLock;  
+    bool singleWriter;     // owned by one matching thread: skip bookLock
     OrderStorage& orderStorage;  // Reference to storage (disk-first)
 
+    // Resident mode: live resting orders are kept here, keyed by their
+    // DiskOffset, and disk is only written behind (OrderStorage::saveAsync)
+    bool residentMode;
+    MyHashMap<DiskOffset, HotOrder> residentOrders;
+
+    // orderID -> handle for every resting order (O(1) cancel / reduce).
+    // Open addressing, so resting an order doesn't allocate a node.
+    MyHashMap<int, OrderHandle> handles;
+
+    // Optional L2 feed (not owned). mdResync is set when the publisher's
+    // ring was full: the next change re-sends the whole depth instead.
+    MarketDataPublisher* marketData;
+    bool mdResync;
+
+    // Published after every change for lock-free readers (getTopOfBook);
+    // topWork is the writer's copy, only touched under bookLock
+    SeqLock<TopOfBook> topOfBook;
+    TopOfBook topWork;
+
 public:
-    OrderBook(std::string sym, OrderStorage& _order);
+    OrderBook(std::string sym, OrderStorage& _order,
+              Price tick = DEFAULT_TICK_SIZE, bool resident = true,
+              PriceIndexType type = PriceIndexType::LADDER);
     ~OrderBook();
     
     // Core operations (thread-safe)
     vector<Trade> addOrder(Order* order);
-    void cancelOrder(int orderID);
+
+    // Same, but the trades go into the caller's buffer (cleared first), so
+    // a caller that keeps one around matches without touching the heap
+    void addOrder(Order* order, vector<Trade>& trades);
+    bool cancelOrder(int orderID, Order* cancelled = nullptr);
+    int reduceOrder(int orderID, int reduceBy);   // returns quantity removed
+    bool findOrder(int orderID, Order& out);
+
+    // Batch forms: the whole lot runs in one bookLock hold with one BBO
+    // refresh at the end. Results are per input entry, in input order.
+    vector<vector<Trade>> addOrders(const vector<Order*>& orders);
+    vector<bool> cancelOrders(const vector<int>& orderIDs, vector<Order>& cancelled);
     
     // Query operations (thread-safe)
     Order getBestBid();
     Order getBestAsk();
+
+    // Any thread, no lock and no disk access: copy of the latest BBO
+    TopOfBook getTopOfBook() const { return topOfBook.load(); }
     void printOrderBook();
     string getOrderBookJSON();
     string getSymbol() const; 
+    size_t getPoolSlabCount() const;   // pool slabs taken so far
+    void reserveOrders(size_t n);   // room for n more resting orders
+    Price getTickSize() const;
+
+    // Hand the book to a single owning thread (see MatchingShard). From then
+    // on every call must come from that thread, and bookLock is not taken.
+    void setSingleWriter(bool owned) { singleWriter = owned; }
+    bool isSingleWriter() const { return singleWriter; }
     
     // NEW: Rebuild from disk on startup
     void rebuildFromStorage();
+
+    // Rebuild from an already loaded set of resting orders (offset, order),
+    // in time priority. Safe to run for different books in parallel.
+    void rebuildFromOrders(const vector<pair<DiskOffset, Order>>& live);
+
+    // Copy of the resting orders in priority order, taken under bookLock
+    // (so from the owning shard thread in sharded mode). O(live orders).
+    BookSnapshot captureSnapshot();
+
+    // Stream level changes and trade prints to pub (nullptr stops it).
+    // Sends the current depth first; call on the owning shard when sharded.
+    void setMarketData(MarketDataPublisher* pub);
     
     
 private:
     // NEW: Load order from storage (uses cache in MatchingEngine)
     Order loadOrderFromStorage(int orderID);
+
+    // addOrder / cancelOrder bodies; caller holds bookLock and refreshes
+    // the BBO afterwards
+    void matchOrder(Order* order, vector<Trade>& trades);
+    bool cancelResting(int orderID, Order* cancelled);
+
+    // Resting-order access (memory in resident mode, disk otherwise)
+    HotOrder loadResting(DiskOffset offset);
+    void storeOrder(const HotOrder& order, DiskOffset offset);
+    void snapshotSide(PriceIndex* tree, bool bids, vector<SnapshotOrder>& out);
+    void makeResident(const HotOrder& order, DiskOffset offset);
+    void trackOrder(const HotOrder& order, DiskOffset offset, OrderQueue* level, OrderNode* node);
+    bool unlinkOrder(int orderID);
+    void restingChanged(const HotOrder& order, int qtyRemoved, bool leaves);
+
+    // Market data, all under bookLock
+    void publishLevel(bool buy, Price price, const OrderQueue* level);
+    void publishTrade(bool aggressorBuy, Price price, int quantity);
+    void publishEvent(MarketDataEvent& ev);
+    bool publishDepth();
+    bool publishSide(PriceIndex* tree, bool bids);
+
+    void refreshTopOfBook();
+    OrderQueue* bestLevel(PriceIndex* tree, bool bids, Price& price);
+
+    PriceIndex* makePriceIndex();
+
+    void lockBook() { if (!singleWriter) pthread_mutex_lock(&bookLock); }
+    void unlockBook() { if (!singleWriter) pthread_mutex_unlock(&bookLock); }
 };
 
 #endif
\ No newline at end of file
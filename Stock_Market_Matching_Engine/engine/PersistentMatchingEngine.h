@@ -15,6 +15,9 @@
 #include "../storage/TradeStorage.h"
 #include "../storage/MetadataStorage.h"
 #include "../storage/SymbolStorage.h"
+#include "../storage/CommandCapture.h"
+#include "../core/Log.h"
+#include "../core/ParallelFor.h"
 #include "OrderBook.h"
 
 using namespace std;
@@ -22,15 +25,17 @@ using namespace std;
 class PersistentMatchingEngine {
 private:
     // STORAGE MANAGERS (disk = source of truth)
-    OrderStorage orderStorage;
+    // Symbol and user storage first: they load the intern tables that
+    // OrderStorage's index is keyed by
+    SymbolStorage symbolStorage;
     UserStorage userStorage;
+    OrderStorage orderStorage;
     TradeStorage tradeStorage;
     MetadataStorage metadataStorage;
-    SymbolStorage symbolStorage;
 
     // IN-MEMORY CACHES (for performance)
-    LRUCache<int, Order> orderCache;           // Cache 1000 recent orders
-    LRUCache<string, User> userCache;     // Cache 100 active users
+    ShardedClockCache<int, Order> orderCache;      // Cache 1000 recent orders
+    ShardedClockCache<string, User> userCache;     // Cache 100 active users
     LRUCache<string, OrderBook> bookCache; // Cache 10 active order books
 
     // LOCKS
@@ -43,9 +48,12 @@ private:
     int nextOrderID;
     int nextTradeID;
 
+    // Optional order-flow capture (not owned)
+    CommandCapture* capture;
+
 public:
     PersistentMatchingEngine() 
-        : orderCache(1000), userCache(100), bookCache(10) {
+        : orderCache(1000), userCache(100), bookCache(10), capture(nullptr) {
         
         // Load metadata from disk
         Metadata meta = metadataStorage.loadMetadata();
@@ -73,7 +81,17 @@ public:
         cout << "  Books: " << (bookCache.getHitRate() * 100) << "%\n";
     }
 
+    // Record inbound commands and resulting trades; nullptr turns it off
+    void setCapture(CommandCapture* c) {
+        capture = c;
+    }
+
     void createUser(const std::string& userID, double initialCash) {
+        if (capture) capture->createUser(userID, initialCash);
+        if (userID.size() > User::MAX_ID_LENGTH) {
+            std::cout << "Error: User ID longer than " << User::MAX_ID_LENGTH << " characters\n";
+            return;
+        }
         lock_guard<std::mutex> lock(userLock);
         
         // Check if user already exists ON DISK
@@ -92,13 +110,13 @@ public:
         std::cout << "Created user " << userID << " with $" << initialCash << "\n";
     }
 
-    User* getUser(const std::string& userID) {
+    std::shared_ptr<User> getUser(const std::string& userID) {
         std::lock_guard<std::mutex> lock(userLock);
         
         // Try cache first
         auto cached = userCache.get(userID);
         if (cached) {
-            return cached.get();
+            return cached;
         }
         
         // Cache miss - load from disk
@@ -110,20 +128,45 @@ public:
         // Put in cache and return
         auto ptr = std::make_shared<User>(user);
         userCache.put(userID, ptr);
-        return ptr.get();
+        return ptr;
+    }
+
+    // Credit shares to a user through the engine (so captures see it)
+    bool depositStock(const std::string& userID, const std::string& symbol, int quantity) {
+        if (capture) capture->depositStock(userID, symbol, quantity);
+        if (quantity <= 0) return false;
+
+        std::shared_ptr<User> user = getUser(userID);
+        if (!user) {
+            std::cout << "Error: User " << userID << " not found\n";
+            return false;
+        }
+
+        std::lock_guard<std::mutex> lock(userLock);
+        user->addStock(symbol, quantity);
+        userStorage.updateUser(*user);
+        return true;
     }
 
     Order* placeOrder(const std::string& userID, const std::string& symbol,
                      const std::string& side, double price, int quantity) {
-        
-        // Step 1: Validate stock exists
+        if (capture) capture->placeOrder(userID, symbol, side, price, quantity);
+
+        // Step 1: Validate stock exists and the price is on its tick grid
         if (!symbolExists(symbol)) {
             std::cout << "Error: Stock " << symbol << " does not exist\n";
             return nullptr;
         }
 
+        Price px = toPrice(price);
+        std::shared_ptr<OrderBook> book = getOrCreateOrderBook(symbol);
+        if (!isOnTick(px, book->getTickSize())) {
+            std::cout << "Error: Price " << price << " is not a valid tick for " << symbol << "\n";
+            return nullptr;
+        }
+
         // Step 2: Load user from disk (or cache)
-        User* user = getUser(userID);
+        std::shared_ptr<User> user = getUser(userID);
         if (!user) {
             std::cout << "Error: User " << userID << " not found\n";
             return nullptr;
@@ -134,7 +177,7 @@ public:
             std::lock_guard<std::mutex> lock(userLock);
             
             if (side == "BUY") {
-                double cost = price * quantity;
+                Money cost = notional(px, quantity);
                 if (!user->deductCash(cost)) {
                     std::cout << "Error: Insufficient funds\n";
                     return nullptr;
@@ -157,7 +200,7 @@ public:
             std::lock_guard<std::mutex> lock(orderLock);
             
             int orderID = nextOrderID++;
-            order = new Order(orderID, userID, symbol, side, price, quantity);
+            order = new Order(orderID, userID, symbol, side, px, quantity);
             
             // Write order to disk BEFORE matching
             orderStorage.persist(*order);
@@ -176,20 +219,16 @@ public:
 
         
         // Step 5: Match order in order book
-        std::cerr << "[DBG] placeOrder: Getting order book\n";
-        OrderBook* book = getOrCreateOrderBook(symbol);
-
-        std::cerr << "[DBG] placeOrder: About to call addOrder\n";
+        LOG_DEBUG("placeOrder: About to call addOrder");
         std::vector<Trade> trades = book->addOrder(order);
 
-        std::cerr << "[DBG] placeOrder: addOrder returned, trades.size()=" << trades.size() << "\n";
-        cout << "Reached Here After order added!";
-        std::cerr << "[DBG] placeOrder: About to process trades\n";
+        LOG_DEBUG("placeOrder: addOrder returned, trades.size()=" << trades.size());
+        LOG_DEBUG("placeOrder: About to process trades");
 
         // Step 6: Process trades
         processTrades(trades);
 
-        std::cerr << "[DBG] placeOrder: Trades processed\n";
+        LOG_DEBUG("placeOrder: Trades processed");
 
 
         std::cout << "Order placed: " << order->toString() << "\n";
@@ -197,6 +236,7 @@ public:
     }
 
 void cancelOrder(int orderID, const std::string& userID) {
+    if (capture) capture->cancelOrder(orderID, userID);
     std::lock_guard<std::mutex> lock(orderLock);
 
     DiskOffset off = orderStorage.getOffsetForOrder(orderID);
@@ -212,19 +252,22 @@ void cancelOrder(int orderID, const std::string& userID) {
         return;
     }
 
-    // ✅ CAPTURE remaining BEFORE cancel
-    int remaining = order.getRemainingQuantity();
-
-    // Cancel inside order book (this will zero remaining)
-    OrderBook* book = getOrCreateOrderBook(order.getSymbol());
-    book->cancelOrder(orderID);
+    // Cancel inside order book; it hands back the state it cancelled,
+    // so the refund covers exactly what was still resting
+    std::shared_ptr<OrderBook> book = getOrCreateOrderBook(order.getSymbol());
+    Order resting;
+    if (!book->cancelOrder(orderID, &resting)) {
+        cout << "Error: Order " << orderID << " is not active\n";
+        return;
+    }
+    int remaining = resting.getRemainingQuantity();
 
     // Refund remaining
     if (remaining > 0) {
-        User* user = getUser(userID);
+        std::shared_ptr<User> user = getUser(userID);
         if (user) {
             if (order.side == "BUY")
-                user->addCash(order.price * remaining);
+                user->addCash(notional(order.price, remaining));
             else
                 user->addStock(order.getSymbol(), remaining);
 
@@ -243,7 +286,8 @@ void cancelOrder(int orderID, const std::string& userID) {
 }
 
 
-    bool addStock(const std::string& symbol, const std::string& userID) {
+    bool addStock(const std::string& symbol, const std::string& userID, double tickSize = 0.01) {
+        if (capture) capture->addStock(symbol, userID, tickSize);
 
         if (userID != "admin123") {
             std::cout << "Unauthorized\n";
@@ -255,8 +299,14 @@ void cancelOrder(int orderID, const std::string& userID) {
             return false;
         }
         
+        Price tick = toPrice(tickSize);
+        if (tick <= 0) {
+            std::cout << "Invalid tick size\n";
+            return false;
+        }
+        
         // Persist symbol to disk
-        symbolStorage.addSymbol(symbol);
+        symbolStorage.addSymbol(symbol, tick);
         
         std::cout << "Stock " << symbol << " added\n";
         return true;
@@ -268,29 +318,20 @@ void cancelOrder(int orderID, const std::string& userID) {
     }
 
     std::vector<Trade> getUserTrades(const std::string& userID) {
-        // Load all trades from disk and filter
-        std::vector<Trade> allTrades = tradeStorage.loadAllTrades();
-        std::vector<Trade> userTrades;
-        
-        for (const Trade& t : allTrades) {
-            if (t.buyUserID == userID || t.sellUserID == userID) {
-                userTrades.push_back(t);
-            }
-        }
-        
-        return userTrades;
+        // Only the archive segments that hold the user, plus the unsealed tail
+        return tradeStorage.loadTradesForUser(userID);
     }
 
-    std::vector<Order*> getActiveOrders(const std::string& userID) {
+    std::vector<std::shared_ptr<Order>> getActiveOrders(const std::string& userID) {
         // Load user from disk
-        User* user = getUser(userID);
+        std::shared_ptr<User> user = getUser(userID);
         if (!user) return {};
         
-        std::vector<Order*> orders;
+        std::vector<std::shared_ptr<Order>> orders;
         std::vector<int> orderIDs = user->getActiveOrderIDs();
         
         for (int id : orderIDs) {
-            Order* order = getOrderFromDisk(id);
+            std::shared_ptr<Order> order = getOrderFromDisk(id);
             if (order) orders.push_back(order);
         }
         
@@ -298,7 +339,7 @@ void cancelOrder(int orderID, const std::string& userID) {
     }
 
     void printPortfolio(const std::string& userID) {
-        User* user = getUser(userID);
+        std::shared_ptr<User> user = getUser(userID);
         if (!user) {
             std::cout << "User not found\n";
             return;
@@ -316,24 +357,25 @@ void cancelOrder(int orderID, const std::string& userID) {
 
     void printOrderBook(const string& symbol)
     {
-        OrderBook* book = getOrCreateOrderBook(symbol);
+        std::shared_ptr<OrderBook> book = getOrCreateOrderBook(symbol);
         book->printOrderBook();
     }
 private:
  
     
-OrderBook* getOrCreateOrderBook(const std::string& symbol) {
+std::shared_ptr<OrderBook> getOrCreateOrderBook(const std::string& symbol) {
     std::lock_guard<std::mutex> lock(bookLock);
     
     auto cached = bookCache.get(symbol);
     if (cached) {
-        return cached.get();
+        return cached;
     }
     
-    auto book = std::make_shared<OrderBook>(symbol, orderStorage);
+    auto book = std::make_shared<OrderBook>(symbol, orderStorage,
+                                            symbolStorage.getTickSize(symbol));
     
     bookCache.put(symbol, book);
-    return book.get();
+    return book;
 }
 
     Order loadOrderFromDisk(int orderID) {
@@ -354,9 +396,9 @@ OrderBook* getOrCreateOrderBook(const std::string& symbol) {
         return Order(); // Empty order if not found
     }
 
-    Order* getOrderFromDisk(int orderID) {
+    std::shared_ptr<Order> getOrderFromDisk(int orderID) {
         auto cached = orderCache.get(orderID);
-        if (cached) return cached.get();
+        if (cached) return cached;
         
         DiskOffset offset = orderStorage.getOffsetForOrder(orderID);
         if (!offset) return nullptr;
@@ -364,7 +406,7 @@ OrderBook* getOrCreateOrderBook(const std::string& symbol) {
         Order order = orderStorage.load(offset);
         auto ptr = std::make_shared<Order>(order);
         orderCache.put(orderID, ptr);
-        return ptr.get();
+        return ptr;
     }
 
     void processTrades(const std::vector<Trade>& trades) {
@@ -379,6 +421,7 @@ OrderBook* getOrCreateOrderBook(const std::string& symbol) {
             
             // Persist trade to disk immediately
             tradeStorage.persist(trade);
+            if (capture) capture->trade(trade);
             
             std::cout << "Trade executed: " << trade.toString() << "\n";
         }
@@ -386,17 +429,18 @@ OrderBook* getOrCreateOrderBook(const std::string& symbol) {
 
 void updateUsersForTrade(const Trade& trade) {
     // NO LOCK HERE - getUser() will lock internally
-    
-    User* buyer = getUser(trade.buyUserID);
-    User* seller = getUser(trade.sellUserID);
+    // Both are held by shared_ptr, so loading the seller can't evict and
+    // free the buyer under us
+    std::shared_ptr<User> buyer = getUser(trade.getBuyUserID());
+    std::shared_ptr<User> seller = getUser(trade.getSellUserID());
     
     if (!buyer || !seller) return;
     
     // Lock only when modifying
     {
         std::lock_guard<std::mutex> lock(userLock);
-        buyer->addStock(trade.symbol, trade.quantity);
-        seller->addCash(trade.price * trade.quantity);
+        buyer->addStock(trade.symbolKey, trade.quantity);
+        seller->addCash(notional(trade.price, trade.quantity));
         
         userStorage.updateUser(*buyer);
         userStorage.updateUser(*seller);
@@ -406,13 +450,13 @@ void updateUsersForTrade(const Trade& trade) {
     void refundUser(const std::string& userID, const Order& order) {
         //std::lock_guard<std::mutex> lock(userLock);
         
-        User* user = getUser(userID);
+        std::shared_ptr<User> user = getUser(userID);
         if (!user) return;
         
         int remaining = order.getRemainingQuantity();
         if (remaining > 0) {
             if (order.side == "BUY") {
-                user->addCash(order.price * remaining);
+                user->addCash(notional(order.price, remaining));
             } else {
                 user->addStock(order.getSymbol(), remaining);
             }
@@ -423,11 +467,21 @@ void updateUsersForTrade(const Trade& trade) {
 
     void rebuildAllOrderBooks() {
     vector<string> symbols = symbolStorage.loadAllSymbols();
-    
-    for (const string& symbol : symbols) {
-        auto book = std::make_shared<OrderBook>(symbol, orderStorage);
-        book->rebuildFromStorage();
-        bookCache.put(symbol, book);
+    unordered_map<string, Price> ticks = symbolStorage.loadAllTickSizes();
+    vector<shared_ptr<OrderBook>> books(symbols.size());
+    for (size_t i = 0; i < symbols.size(); i++) {
+        auto t = ticks.find(symbols[i]);
+        books[i] = std::make_shared<OrderBook>(symbols[i], orderStorage,
+                                               t != ticks.end() ? t->second : DEFAULT_TICK_SIZE);
+    }
+
+    // One task per symbol; each reads only that symbol's live orders
+    parallelFor(symbols.size(), [&](size_t i) {
+        books[i]->rebuildFromStorage();
+    });
+
+    for (size_t i = 0; i < symbols.size(); i++) {
+        bookCache.put(symbols[i], books[i]);
     }
     
     cout << "Rebuilt " << symbols.size() << " order books from storage.\n";
@@ -19,7 +19,7 @@ void phase1_create_and_persist() {
     engine.printPortfolio("alice");
     engine.printPortfolio("bob");
     
-    User* bob = engine.getUser("bob");
+    std::shared_ptr<User> bob = engine.getUser("bob");
     assert(bob);
     bob->addStock("AAPL", 100);
     engine.printPortfolio("bob");
@@ -61,8 +61,8 @@ void phase2_recover_and_verify() {
     PersistentMatchingEngine engine;
 
     // --- Users recovered ---
-    User* alice = engine.getUser("alice");
-    User* bob   = engine.getUser("bob");
+    std::shared_ptr<User> alice = engine.getUser("alice");
+    std::shared_ptr<User> bob   = engine.getUser("bob");
 
     assert(alice);
     assert(bob);
@@ -123,5 +123,5 @@ int main(int argc, char* argv[]) {
 
 //g++ -std=c++17 -pthread \
     Stock_Market_Matching_Engine/main.cpp \
-    Stock_Market_Matching_Engine/**/*.cpp \
+    Stock_Market_Matching_Engine/{core,data_structures,engine,storage}/*.cpp \
     -o main
@@ -0,0 +1,141 @@
+#include "BookSnapshot.h"
+#include "../core/Log.h"
+#include <cstring>
+#include <ctime>
+#include <fstream>
+#include <iterator>
+#include <fcntl.h>
+#include <unistd.h>
+
+using namespace std;
+
+namespace {
+
+uint32_t fnv1a(const char* p, size_t n) {
+    uint32_t h = 2166136261u;
+    for (size_t i = 0; i < n; i++) { h ^= (uint8_t)p[i]; h *= 16777619u; }
+    return h;
+}
+
+template <typename T>
+void put(vector<char>& out, const T& v) {
+    const char* p = reinterpret_cast<const char*>(&v);
+    out.insert(out.end(), p, p + sizeof(T));
+}
+
+template <typename T>
+bool get(const vector<char>& in, size_t& pos, size_t end, T& v) {
+    if (pos + sizeof(T) > end) return false;
+    memcpy(&v, in.data() + pos, sizeof(T));
+    pos += sizeof(T);
+    return true;
+}
+
+}
+
+bool BookSnapshotFile::write(const string& path, const vector<BookSnapshot>& books) {
+    vector<char> buf;
+    Header hdr{MAGIC, VERSION, (uint32_t)books.size(), 0, (int64_t)time(nullptr)};
+    put(buf, hdr);
+
+    for (const BookSnapshot& b : books) {
+        uint16_t symLen = (uint16_t)b.symbol.size();
+        put(buf, symLen);
+        buf.insert(buf.end(), b.symbol.begin(), b.symbol.end());
+        put(buf, (int64_t)b.tickSize);
+        put(buf, (uint64_t)b.dataMark);
+        put(buf, (uint64_t)b.bids.size());
+        put(buf, (uint64_t)b.asks.size());
+        for (const vector<SnapshotOrder>* side : { &b.bids, &b.asks }) {
+            for (const SnapshotOrder& o : *side) {
+                put(buf, (uint64_t)o.offset);
+                put(buf, o.rec);
+            }
+        }
+    }
+    put(buf, fnv1a(buf.data(), buf.size()));
+
+    string tmp = path + ".tmp";
+    int fd = ::open(tmp.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) {
+        LOG_ERROR("BookSnapshot: cannot create " << tmp);
+        return false;
+    }
+
+    bool ok = true;
+    size_t done = 0;
+    while (ok && done < buf.size()) {
+        ssize_t n = ::write(fd, buf.data() + done, buf.size() - done);
+        if (n <= 0) ok = false;
+        else done += n;
+    }
+    ok = ok && ::fsync(fd) == 0;
+    ::close(fd);
+
+    if (!ok || ::rename(tmp.c_str(), path.c_str()) != 0) {
+        LOG_ERROR("BookSnapshot: failed to write " << path);
+        ::unlink(tmp.c_str());
+        return false;
+    }
+    return true;
+}
+
+bool BookSnapshotFile::read(const string& path, vector<BookSnapshot>& books) {
+    books.clear();
+
+    ifstream in(path, ios::binary);
+    if (!in) return false;
+    vector<char> buf((istreambuf_iterator<char>(in)), istreambuf_iterator<char>());
+
+    uint32_t sum;
+    if (buf.size() < sizeof(Header) + sizeof(sum)) return false;
+    size_t end = buf.size() - sizeof(sum);
+    memcpy(&sum, buf.data() + end, sizeof(sum));
+    if (fnv1a(buf.data(), end) != sum) {
+        LOG_WARN("BookSnapshot: checksum mismatch in " << path << ", ignoring it");
+        return false;
+    }
+
+    size_t pos = 0;
+    Header hdr;
+    if (!get(buf, pos, end, hdr)) return false;
+    if (hdr.magic != MAGIC || hdr.version != VERSION) {
+        LOG_WARN("BookSnapshot: " << path << " has unsupported version " << hdr.version);
+        return false;
+    }
+
+    // A half-read snapshot must not be mistaken for a usable one
+    auto fail = [&books]() {
+        books.clear();
+        return false;
+    };
+
+    books.resize(hdr.books);
+    for (BookSnapshot& b : books) {
+        uint16_t symLen;
+        int64_t tick;
+        uint64_t mark, nb, na;
+        if (!get(buf, pos, end, symLen) || pos + symLen > end) return fail();
+        b.symbol.assign(buf.data() + pos, symLen);
+        pos += symLen;
+        if (!get(buf, pos, end, tick) || !get(buf, pos, end, mark) ||
+            !get(buf, pos, end, nb) || !get(buf, pos, end, na)) return fail();
+        b.tickSize = tick;
+        b.dataMark = mark;
+
+        const size_t entry = sizeof(uint64_t) + sizeof(OrderRecord);
+        if ((nb + na) > (end - pos) / entry) return fail();
+        b.bids.resize(nb);
+        b.asks.resize(na);
+        for (vector<SnapshotOrder>* side : { &b.bids, &b.asks }) {
+            for (SnapshotOrder& o : *side) {
+                uint64_t off = 0;
+                if (!get(buf, pos, end, off) || !get(buf, pos, end, o.rec)) return fail();
+                o.offset = off;
+            }
+        }
+    }
+
+    if (pos != end) return fail();
+    return true;
+}
@@ -0,0 +1,52 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "DiskTypes.h"
+#include "../core/Order.h"
+
+// Live state of one OrderBook at a consistent point: every resting order
+// with its record, bids best price first, asks best price first, FIFO
+// within each level. dataMark is the end of orders.dat when the copy was
+// taken; orders appended after it are not in the snapshot.
+struct SnapshotOrder {
+    DiskOffset offset;   // stored offset (raw + 1), as in the book
+    OrderRecord rec;
+};
+
+struct BookSnapshot {
+    std::string symbol;
+    Price tickSize = DEFAULT_TICK_SIZE;
+    DiskOffset dataMark = 0;
+    std::vector<SnapshotOrder> bids;
+    std::vector<SnapshotOrder> asks;
+};
+
+// data/books.snap: versioned binary file holding one BookSnapshot per book.
+//
+//   header  [u32 magic 'BKSN'][u32 version][u32 books][u32 reserved][i64 created]
+//   book    [u16 symbol len][symbol][i64 tick][u64 dataMark][u64 bids][u64 asks]
+//           then (bids + asks) x [u64 offset][OrderRecord]
+//   trailer [u32 FNV-1a over everything before it]
+//
+// Written to a temp file, fsynced and renamed, so readers only ever see a
+// whole snapshot.
+class BookSnapshotFile {
+private:
+    struct Header {
+        uint32_t magic;
+        uint32_t version;
+        uint32_t books;
+        uint32_t reserved;
+        int64_t created;
+    };
+
+    static const uint32_t MAGIC = 0x4E534B42;   // "BKSN"
+    static const uint32_t VERSION = 1;
+
+public:
+    static bool write(const std::string& path, const std::vector<BookSnapshot>& books);
+
+    // False if the file is missing, from another version or damaged
+    static bool read(const std::string& path, std::vector<BookSnapshot>& books);
+};
@@ -0,0 +1,301 @@
+#include "CommandCapture.h"
+#include "../core/Log.h"
+#include <cstring>
+
+using namespace std;
+
+namespace {
+
+struct PayloadWriter {
+    vector<char> bytes;
+
+    template <typename T>
+    void put(const T& v) {
+        const char* p = reinterpret_cast<const char*>(&v);
+        bytes.insert(bytes.end(), p, p + sizeof(T));
+    }
+
+    void putString(const string& s) {
+        uint16_t len = (uint16_t)min<size_t>(s.size(), UINT16_MAX);
+        put(len);
+        bytes.insert(bytes.end(), s.data(), s.data() + len);
+    }
+};
+
+struct PayloadReader {
+    const vector<char>& bytes;
+    size_t pos = 0;
+    bool ok = true;
+
+    explicit PayloadReader(const vector<char>& b) : bytes(b) {}
+
+    template <typename T>
+    T get() {
+        T v{};
+        if (pos + sizeof(T) > bytes.size()) { ok = false; return v; }
+        memcpy(&v, bytes.data() + pos, sizeof(T));
+        pos += sizeof(T);
+        return v;
+    }
+
+    string getString() {
+        uint16_t len = get<uint16_t>();
+        if (!ok || pos + len > bytes.size()) { ok = false; return string(); }
+        string s(bytes.data() + pos, len);
+        pos += len;
+        return s;
+    }
+};
+
+vector<char> placePayload(const string& userID, const string& symbol,
+                          const string& side, double price, int quantity) {
+    PayloadWriter w;
+    w.putString(userID);
+    w.putString(symbol);
+    w.putString(side);
+    w.put(price);
+    w.put((int32_t)quantity);
+    return w.bytes;
+}
+
+vector<char> cancelPayload(int orderID, const string& userID) {
+    PayloadWriter w;
+    w.put((int32_t)orderID);
+    w.putString(userID);
+    return w.bytes;
+}
+
+vector<char> batchPayload(CaptureType type, size_t count) {
+    PayloadWriter w;
+    w.put((uint8_t)type);
+    w.put((int32_t)count);
+    return w.bytes;
+}
+
+}
+
+/* ================= CommandCapture ================= */
+
+CommandCapture::CommandCapture(const string& path)
+    : start(chrono::steady_clock::now()), records(0) {
+    out.open(path, ios::binary | ios::trunc);
+    if (!out) {
+        LOG_ERROR("CommandCapture: cannot open " << path);
+        return;
+    }
+    FileHeader hdr{FILE_MAGIC, FILE_VERSION};
+    out.write(reinterpret_cast<const char*>(&hdr), sizeof(hdr));
+}
+
+CommandCapture::~CommandCapture() {
+    flush();
+}
+
+void CommandCapture::flush() {
+    lock_guard<mutex> lk(writeMutex);
+    if (out.is_open()) out.flush();
+}
+
+void CommandCapture::write(CaptureType type, const vector<char>& payload) {
+    lock_guard<mutex> lk(writeMutex);
+    writeLocked(type, payload);
+}
+
+void CommandCapture::writeLocked(CaptureType type, const vector<char>& payload) {
+    if (!out.is_open()) return;
+
+    uint64_t ns = chrono::duration_cast<chrono::nanoseconds>(
+        chrono::steady_clock::now() - start).count();
+    uint8_t t = (uint8_t)type;
+    uint16_t len = (uint16_t)payload.size();
+
+    out.write(reinterpret_cast<const char*>(&t), sizeof(t));
+    out.write(reinterpret_cast<const char*>(&ns), sizeof(ns));
+    out.write(reinterpret_cast<const char*>(&len), sizeof(len));
+    out.write(payload.data(), len);
+    records++;
+}
+
+void CommandCapture::createUser(const string& userID, double initialCash) {
+    PayloadWriter w;
+    w.putString(userID);
+    w.put(initialCash);
+    write(CaptureType::CREATE_USER, w.bytes);
+}
+
+void CommandCapture::addStock(const string& symbol, const string& userID, double tickSize) {
+    PayloadWriter w;
+    w.putString(symbol);
+    w.putString(userID);
+    w.put(tickSize);
+    write(CaptureType::ADD_STOCK, w.bytes);
+}
+
+void CommandCapture::depositStock(const string& userID, const string& symbol, int quantity) {
+    PayloadWriter w;
+    w.putString(userID);
+    w.putString(symbol);
+    w.put((int32_t)quantity);
+    write(CaptureType::DEPOSIT_STOCK, w.bytes);
+}
+
+void CommandCapture::placeOrder(const string& userID, const string& symbol,
+                                const string& side, double price, int quantity) {
+    write(CaptureType::PLACE_ORDER, placePayload(userID, symbol, side, price, quantity));
+}
+
+void CommandCapture::cancelOrder(int orderID, const string& userID) {
+    write(CaptureType::CANCEL_ORDER, cancelPayload(orderID, userID));
+}
+
+void CommandCapture::reduceOrder(int orderID, const string& userID, int quantity) {
+    PayloadWriter w;
+    w.put((int32_t)orderID);
+    w.putString(userID);
+    w.put((int32_t)quantity);
+    write(CaptureType::REDUCE_ORDER, w.bytes);
+}
+
+// Marker and commands under one lock so nothing lands in between
+void CommandCapture::placeOrders(const vector<OrderRequest>& requests) {
+    lock_guard<mutex> lk(writeMutex);
+    writeLocked(CaptureType::BATCH, batchPayload(CaptureType::PLACE_ORDER, requests.size()));
+    for (const OrderRequest& r : requests) {
+        writeLocked(CaptureType::PLACE_ORDER, placePayload(r.userID, r.symbol, r.side, r.price, r.quantity));
+    }
+}
+
+void CommandCapture::cancelOrders(const vector<CancelRequest>& requests) {
+    lock_guard<mutex> lk(writeMutex);
+    writeLocked(CaptureType::BATCH, batchPayload(CaptureType::CANCEL_ORDER, requests.size()));
+    for (const CancelRequest& r : requests) {
+        writeLocked(CaptureType::CANCEL_ORDER, cancelPayload(r.orderID, r.userID));
+    }
+}
+
+void CommandCapture::trade(const Trade& t) {
+    write(CaptureType::TRADE, encodeTrade(t));
+}
+
+vector<char> CommandCapture::encodeTrade(const Trade& t) {
+    PayloadWriter w;
+    w.put((int32_t)t.tradeID);
+    w.put((int32_t)t.buyOrderID);
+    w.put((int32_t)t.sellOrderID);
+    w.putString(t.getBuyUserID());
+    w.putString(t.getSellUserID());
+    w.putString(t.getSymbol());
+    w.put((int64_t)t.price);
+    w.put((int32_t)t.quantity);
+    return w.bytes;
+}
+
+/* ================= CaptureReader ================= */
+
+CaptureReader::CaptureReader(const string& path) : valid(false) {
+    in.open(path, ios::binary);
+    if (!in) {
+        LOG_ERROR("CaptureReader: cannot open " << path);
+        return;
+    }
+
+    CommandCapture::FileHeader hdr{};
+    in.read(reinterpret_cast<char*>(&hdr), sizeof(hdr));
+    if (!in || hdr.magic != CommandCapture::FILE_MAGIC) {
+        LOG_ERROR("CaptureReader: " << path << " is not a capture file");
+        return;
+    }
+    if (hdr.version != CommandCapture::FILE_VERSION) {
+        LOG_ERROR("CaptureReader: unsupported capture version " << hdr.version);
+        return;
+    }
+    valid = true;
+}
+
+bool CaptureReader::next(CaptureEvent& ev) {
+    if (!valid) return false;
+
+    uint8_t t = 0;
+    uint64_t ns = 0;
+    uint16_t len = 0;
+    in.read(reinterpret_cast<char*>(&t), sizeof(t));
+    in.read(reinterpret_cast<char*>(&ns), sizeof(ns));
+    in.read(reinterpret_cast<char*>(&len), sizeof(len));
+    if (!in) return false;
+
+    ev = CaptureEvent();
+    ev.type = (CaptureType)t;
+    ev.timestampNs = ns;
+    ev.payload.resize(len);
+    in.read(ev.payload.data(), len);
+    if (!in) {
+        LOG_WARN("CaptureReader: truncated record at end of capture");
+        return false;
+    }
+
+    PayloadReader r(ev.payload);
+    switch (ev.type) {
+    case CaptureType::CREATE_USER:
+        ev.userID = r.getString();
+        ev.amount = r.get<double>();
+        break;
+    case CaptureType::ADD_STOCK:
+        ev.symbol = r.getString();
+        ev.userID = r.getString();
+        ev.amount = r.get<double>();
+        break;
+    case CaptureType::DEPOSIT_STOCK:
+        ev.userID = r.getString();
+        ev.symbol = r.getString();
+        ev.quantity = r.get<int32_t>();
+        break;
+    case CaptureType::PLACE_ORDER:
+        ev.userID = r.getString();
+        ev.symbol = r.getString();
+        ev.side = r.getString();
+        ev.amount = r.get<double>();
+        ev.quantity = r.get<int32_t>();
+        break;
+    case CaptureType::CANCEL_ORDER:
+        ev.orderID = r.get<int32_t>();
+        ev.userID = r.getString();
+        break;
+    case CaptureType::REDUCE_ORDER:
+        ev.orderID = r.get<int32_t>();
+        ev.userID = r.getString();
+        ev.quantity = r.get<int32_t>();
+        break;
+    case CaptureType::BATCH:
+        ev.batchOf = (CaptureType)r.get<uint8_t>();
+        ev.quantity = r.get<int32_t>();
+        break;
+    case CaptureType::TRADE:
+        ev.trade.tradeID = r.get<int32_t>();
+        ev.trade.buyOrderID = r.get<int32_t>();
+        ev.trade.sellOrderID = r.get<int32_t>();
+        ev.trade.buyUserKey = userTable().intern(r.getString());
+        ev.trade.sellUserKey = userTable().intern(r.getString());
+        ev.trade.symbolKey = symbolTable().intern(r.getString());
+        ev.trade.price = r.get<int64_t>();
+        ev.trade.quantity = r.get<int32_t>();
+        ev.trade.timestamp = 0;
+        break;
+    default:
+        LOG_ERROR("CaptureReader: unknown record type " << (int)t);
+        return false;
+    }
+
+    if (!r.ok) {
+        LOG_ERROR("CaptureReader: malformed payload for record type " << (int)t);
+        return false;
+    }
+    return true;
+}
+
+vector<CaptureEvent> CaptureReader::readAll(const string& path) {
+    vector<CaptureEvent> events;
+    CaptureReader reader(path);
+    CaptureEvent ev;
+    while (reader.next(ev)) events.push_back(ev);
+    return events;
+}
@@ -0,0 +1,114 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <mutex>
+#include <chrono>
+#include <fstream>
+#include "../core/Trade.h"
+
+// Binary capture of everything that reaches an engine from the outside
+// (createUser, addStock, depositStock, placeOrder, cancelOrder, reduceOrder)
+// plus the trades each placeOrder produced.
+//
+// File layout: a FileHeader, then records of
+//   [u8 type][u64 ns since capture start][u16 payload length][payload]
+// Strings are length-prefixed (u16), numbers are written in host byte
+// order. Trade payloads leave out the wall-clock timestamp so two runs of
+// the same flow produce byte-identical trade records.
+//
+// Commands are recorded in the order callers hand them to the engine, so a
+// replay is only deterministic for a capture taken from a single caller
+// thread (or callers that never race on the same symbol).
+//
+// A batch call (placeOrders / cancelOrders) is a BATCH record holding the
+// command type and count, followed right away by that many PLACE_ORDER or
+// CANCEL_ORDER records; a replay hands them back to the engine as one batch.
+enum class CaptureType : uint8_t {
+    CREATE_USER = 1,
+    ADD_STOCK,
+    DEPOSIT_STOCK,
+    PLACE_ORDER,
+    CANCEL_ORDER,
+    REDUCE_ORDER,
+    TRADE,          // engine output, used to verify replays
+    BATCH
+};
+
+struct CaptureEvent {
+    CaptureType type = CaptureType::CREATE_USER;
+    uint64_t timestampNs = 0;
+
+    std::string userID;
+    std::string symbol;
+    std::string side;
+    double amount = 0;      // cash (CREATE_USER), price (PLACE_ORDER), tick (ADD_STOCK)
+    int quantity = 0;
+    int orderID = 0;
+    Trade trade;            // TRADE only
+    CaptureType batchOf = CaptureType::PLACE_ORDER;   // BATCH only; count is in quantity
+
+    std::vector<char> payload;  // raw bytes as stored, filled in by CaptureReader
+};
+
+class CommandCapture {
+private:
+    struct FileHeader {
+        uint32_t magic;
+        uint32_t version;
+    };
+
+    static const uint32_t FILE_MAGIC = 0x50434D53;  // "SMCP"
+    static const uint32_t FILE_VERSION = 1;
+
+    std::ofstream out;
+    std::mutex writeMutex;
+    std::chrono::steady_clock::time_point start;
+    uint64_t records;
+
+    void write(CaptureType type, const std::vector<char>& payload);
+    void writeLocked(CaptureType type, const std::vector<char>& payload);   // holds writeMutex
+
+    friend class CaptureReader;
+
+public:
+    explicit CommandCapture(const std::string& path);
+    ~CommandCapture();
+
+    CommandCapture(const CommandCapture&) = delete;
+    CommandCapture& operator=(const CommandCapture&) = delete;
+
+    bool isOpen() const { return out.is_open(); }
+    uint64_t getRecordCount() const { return records; }
+    void flush();
+
+    void createUser(const std::string& userID, double initialCash);
+    void addStock(const std::string& symbol, const std::string& userID, double tickSize);
+    void depositStock(const std::string& userID, const std::string& symbol, int quantity);
+    void placeOrder(const std::string& userID, const std::string& symbol,
+                    const std::string& side, double price, int quantity);
+    void cancelOrder(int orderID, const std::string& userID);
+    void reduceOrder(int orderID, const std::string& userID, int quantity);
+    void placeOrders(const std::vector<OrderRequest>& requests);
+    void cancelOrders(const std::vector<CancelRequest>& requests);
+    void trade(const Trade& t);
+
+    // Canonical trade bytes (no timestamp); what replays compare
+    static std::vector<char> encodeTrade(const Trade& t);
+};
+
+class CaptureReader {
+private:
+    std::ifstream in;
+    bool valid;
+
+public:
+    explicit CaptureReader(const std::string& path);
+
+    bool isValid() const { return valid; }
+
+    // False at end of file or on a truncated/corrupt record
+    bool next(CaptureEvent& ev);
+
+    static std::vector<CaptureEvent> readAll(const std::string& path);
+};
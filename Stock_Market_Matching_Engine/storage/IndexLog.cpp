@@ -0,0 +1,251 @@
+#include "IndexLog.h"
+#include "../core/Log.h"
+#include <algorithm>
+#include <cstring>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+using namespace std;
+
+namespace {
+
+// FNV-1a, enough to spot a torn entry at the end of the log
+uint32_t checksum(const char* p, size_t n) {
+    uint32_t h = 2166136261u;
+    for (size_t i = 0; i < n; i++) { h ^= (uint8_t)p[i]; h *= 16777619u; }
+    return h;
+}
+
+bool readFile(const string& path, vector<char>& out, bool& present) {
+    int fd = ::open(path.c_str(), O_RDONLY);
+    present = fd >= 0;
+    if (fd < 0) return false;
+
+    struct stat st;
+    if (::fstat(fd, &st) != 0) { ::close(fd); return false; }
+    out.resize(st.st_size);
+
+    size_t done = 0;
+    while (done < out.size()) {
+        ssize_t n = ::read(fd, out.data() + done, out.size() - done);
+        if (n <= 0) break;
+        done += n;
+    }
+    ::close(fd);
+    out.resize(done);
+    return true;
+}
+
+bool writeAll(int fd, const char* p, size_t n) {
+    while (n > 0) {
+        ssize_t w = ::write(fd, p, n);
+        if (w <= 0) return false;
+        p += w;
+        n -= w;
+    }
+    return true;
+}
+
+}
+
+IndexLog::IndexLog(const string& snapshotFile)
+    : snapshotPath(snapshotFile), logPath(snapshotFile + ".log"), logFd(-1),
+      snapshotEntries(0), logEntries(0) {
+    // Room for a full batch plus one entry, so appending never allocates
+    unwritten.reserve(FLUSH_BYTES + 1024);
+}
+
+IndexLog::~IndexLog() {
+    flush();
+    if (logFd >= 0) ::close(logFd);
+}
+
+// Entry layout: [u32 checksum][u16 payload len][payload]
+// payload: i64 id, u64 offset, then name / symbol / userID as u8 len + bytes
+void IndexLog::encode(const Entry& e, vector<char>& out) {
+    char payload[3 * 256 + 16];
+    size_t n = 0;
+
+    memcpy(payload + n, &e.id, sizeof(e.id)); n += sizeof(e.id);
+    memcpy(payload + n, &e.offset, sizeof(e.offset)); n += sizeof(e.offset);
+    for (const string* s : { &e.name, &e.symbol, &e.userID }) {
+        uint8_t len = (uint8_t)min<size_t>(s->size(), 255);
+        payload[n++] = (char)len;
+        memcpy(payload + n, s->data(), len);
+        n += len;
+    }
+
+    uint32_t sum = checksum(payload, n);
+    uint16_t len = (uint16_t)n;
+    size_t at = out.size();
+    out.resize(at + sizeof(sum) + sizeof(len) + n);
+    memcpy(out.data() + at, &sum, sizeof(sum));
+    memcpy(out.data() + at + sizeof(sum), &len, sizeof(len));
+    memcpy(out.data() + at + sizeof(sum) + sizeof(len), payload, n);
+}
+
+bool IndexLog::decode(const char* p, size_t avail, Entry& e, size_t& used) {
+    uint32_t sum;
+    uint16_t len;
+    if (avail < sizeof(sum) + sizeof(len)) return false;
+    memcpy(&sum, p, sizeof(sum));
+    memcpy(&len, p + sizeof(sum), sizeof(len));
+
+    const char* payload = p + sizeof(sum) + sizeof(len);
+    if (avail - sizeof(sum) - sizeof(len) < len) return false;
+    if (checksum(payload, len) != sum) return false;
+
+    size_t n = 0;
+    if (len < sizeof(e.id) + sizeof(e.offset)) return false;
+    memcpy(&e.id, payload + n, sizeof(e.id)); n += sizeof(e.id);
+    memcpy(&e.offset, payload + n, sizeof(e.offset)); n += sizeof(e.offset);
+    for (string* s : { &e.name, &e.symbol, &e.userID }) {
+        if (n >= len) return false;
+        uint8_t sl = (uint8_t)payload[n++];
+        if (n + sl > len) return false;
+        s->assign(payload + n, sl);
+        n += sl;
+    }
+
+    used = sizeof(sum) + sizeof(len) + len;
+    return true;
+}
+
+bool IndexLog::loadSnapshot(const function<void(const Entry&)>& apply, bool& present) {
+    vector<char> buf;
+    if (!readFile(snapshotPath, buf, present)) return false;
+
+    SnapshotHeader hdr;
+    if (buf.size() < sizeof(hdr)) return false;
+    memcpy(&hdr, buf.data(), sizeof(hdr));
+    if (hdr.magic != SNAPSHOT_MAGIC || hdr.version != SNAPSHOT_VERSION) {
+        LOG_WARN("IndexLog: " << snapshotPath << " is not a current snapshot");
+        return false;
+    }
+
+    size_t pos = sizeof(hdr);
+    uint64_t seen = 0;
+    Entry e;
+    size_t used = 0;
+    while (pos < buf.size() && decode(buf.data() + pos, buf.size() - pos, e, used)) {
+        apply(e);
+        pos += used;
+        seen++;
+    }
+
+    if (seen != hdr.count || pos != buf.size()) {
+        LOG_ERROR("IndexLog: " << snapshotPath << " damaged (" << seen << " of " << hdr.count << " entries)");
+        return false;
+    }
+    snapshotEntries = seen;
+    return true;
+}
+
+void IndexLog::replayLog(const function<void(const Entry&)>& apply, bool& present) {
+    vector<char> buf;
+    if (!readFile(logPath, buf, present)) return;
+
+    size_t pos = 0;
+    Entry e;
+    size_t used = 0;
+    while (pos < buf.size() && decode(buf.data() + pos, buf.size() - pos, e, used)) {
+        apply(e);
+        pos += used;
+        logEntries++;
+    }
+
+    // Drop a torn tail so new entries aren't appended after garbage
+    if (pos != buf.size()) {
+        LOG_WARN("IndexLog: dropping " << (buf.size() - pos) << " torn bytes from " << logPath);
+        if (::truncate(logPath.c_str(), pos) != 0) {
+            LOG_ERROR("IndexLog: cannot truncate " << logPath);
+        }
+    }
+}
+
+void IndexLog::openLog() {
+    if (logFd >= 0) return;
+    logFd = ::open(logPath.c_str(), O_WRONLY | O_CREAT | O_APPEND, 0644);
+    if (logFd < 0) LOG_ERROR("IndexLog: cannot open " << logPath);
+}
+
+bool IndexLog::load(const function<void(const Entry&)>& apply) {
+    snapshotEntries = 0;
+    logEntries = 0;
+
+    bool snapPresent = false, logPresent = false;
+    bool snapOk = loadSnapshot(apply, snapPresent);
+    if (snapPresent && !snapOk) return false;
+
+    replayLog(apply, logPresent);
+    if (!snapPresent && !logPresent) return false;
+
+    openLog();
+    return true;
+}
+
+void IndexLog::append(const Entry& e) {
+    encode(e, unwritten);
+    logEntries++;
+    if (unwritten.size() >= FLUSH_BYTES) flush();
+}
+
+void IndexLog::append(const vector<Entry>& entries) {
+    for (const Entry& e : entries) encode(e, unwritten);
+    logEntries += entries.size();
+    if (unwritten.size() >= FLUSH_BYTES) flush();
+}
+
+void IndexLog::flush() {
+    if (unwritten.empty()) return;
+    openLog();
+    if (logFd < 0) return;
+
+    if (!writeAll(logFd, unwritten.data(), unwritten.size())) {
+        LOG_ERROR("IndexLog: append to " << logPath << " failed");
+    }
+    unwritten.clear();
+}
+
+bool IndexLog::needsCompaction(size_t more) const {
+    return logEntries + more >= max(MIN_COMPACT_ENTRIES, snapshotEntries);
+}
+
+void IndexLog::compact(vector<Entry> entries) {
+    sort(entries.begin(), entries.end(), [](const Entry& a, const Entry& b) {
+        return a.id != b.id ? a.id < b.id : a.name < b.name;
+    });
+
+    vector<char> buf;
+    SnapshotHeader hdr{SNAPSHOT_MAGIC, SNAPSHOT_VERSION, entries.size()};
+    buf.resize(sizeof(hdr));
+    memcpy(buf.data(), &hdr, sizeof(hdr));
+    for (const Entry& e : entries) encode(e, buf);
+
+    // Write aside and rename so a crash leaves either the old or new snapshot
+    string tmp = snapshotPath + ".tmp";
+    int fd = ::open(tmp.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) {
+        LOG_ERROR("IndexLog: cannot create " << tmp);
+        return;
+    }
+    bool ok = writeAll(fd, buf.data(), buf.size()) && ::fsync(fd) == 0;
+    ::close(fd);
+    if (!ok || ::rename(tmp.c_str(), snapshotPath.c_str()) != 0) {
+        LOG_ERROR("IndexLog: failed to write " << snapshotPath);
+        ::unlink(tmp.c_str());
+        return;
+    }
+
+    // Everything in the log, written or not, is now in the snapshot
+    unwritten.clear();
+    openLog();
+    if (logFd >= 0 && ::ftruncate(logFd, 0) != 0) {
+        LOG_ERROR("IndexLog: cannot truncate " << logPath);
+    }
+
+    snapshotEntries = entries.size();
+    logEntries = 0;
+    LOG_DEBUG("IndexLog: compacted " << snapshotPath << " to " << snapshotEntries << " entries");
+}
@@ -0,0 +1,86 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <functional>
+
+using DiskOffset = uint64_t;
+
+// Persistent index for a record file: a sorted snapshot (e.g. data/orders.idx)
+// plus an append-only log next to it (data/orders.idx.log).
+//
+// Storages append one small entry per new record as it is persisted. Entries
+// are collected in memory and written FLUSH_BYTES at a time (and on flush()
+// / close), so the log costs one write() per few thousand records. A crash
+// loses the entries not written yet; owners of append-only data files
+// re-index the records past the last entry they loaded, owners that can't
+// call flush() after each append. Loading reads the snapshot, then
+// replays the log. Once the log outgrows the snapshot the caller compacts,
+// writing a fresh snapshot from its in-memory maps and emptying the log;
+// neither step reads the data file.
+//
+// Not thread-safe; callers use it under their own index mutex.
+class IndexLog {
+public:
+    // Generic index entry; each storage fills the fields it needs
+    struct Entry {
+        int64_t id = 0;          // orderID / tradeID
+        std::string name;        // userID key (UserStorage)
+        DiskOffset offset = 0;
+        std::string symbol;      // OrderStorage secondary keys
+        std::string userID;
+    };
+
+private:
+    struct SnapshotHeader {
+        uint32_t magic;
+        uint32_t version;
+        uint64_t count;
+    };
+
+    static const uint32_t SNAPSHOT_MAGIC = 0x53584449;  // "IDXS"
+    static const uint32_t SNAPSHOT_VERSION = 1;
+    static constexpr size_t MIN_COMPACT_ENTRIES = 65536;
+    static constexpr size_t FLUSH_BYTES = 64 * 1024;
+
+    std::string snapshotPath;
+    std::string logPath;
+    int logFd;
+
+    size_t snapshotEntries;
+    size_t logEntries;
+
+    std::vector<char> unwritten;   // encoded entries not in the log file yet
+
+    static void encode(const Entry& e, std::vector<char>& out);
+    static bool decode(const char* p, size_t avail, Entry& e, size_t& used);
+
+    bool loadSnapshot(const std::function<void(const Entry&)>& apply, bool& present);
+    void replayLog(const std::function<void(const Entry&)>& apply, bool& present);
+    void openLog();
+
+public:
+    explicit IndexLog(const std::string& snapshotFile);
+    ~IndexLog();
+
+    IndexLog(const IndexLog&) = delete;
+    IndexLog& operator=(const IndexLog&) = delete;
+
+    // Feeds every entry (snapshot first, then log) to apply. Returns false
+    // if there is no index on disk or the snapshot is unreadable, in which
+    // case the caller rebuilds from the data file and calls compact().
+    bool load(const std::function<void(const Entry&)>& apply);
+
+    void append(const Entry& e);
+    void append(const std::vector<Entry>& entries);
+    void flush();   // write out the appended entries now
+
+    // Log has grown past the snapshot (amortised O(1) per append), or
+    // will have after `more` further appends
+    bool needsCompaction(size_t more = 0) const;
+
+    // Replace the snapshot with these entries and empty the log
+    void compact(std::vector<Entry> entries);
+
+    size_t getLogEntries() const { return logEntries; }
+};
@@ -0,0 +1,248 @@
+#include "Journal.h"
+#include "StorageManager.h"
+#include "../core/Log.h"
+#include <fstream>
+#include <map>
+#include <filesystem>
+#include <cstring>
+#include <fcntl.h>
+#include <unistd.h>
+
+using namespace std;
+
+JournalConfig Journal::config;
+
+Journal& Journal::instance() {
+    static Journal journal("data/journal.log");
+    return journal;
+}
+
+Journal::Journal(const string& journalPath)
+    : path(journalPath), fd(-1), nextLsn(0), committedLsn(0), journalBytes(0),
+      epoch(0), stopping(false), commits(0), entries(0) {
+    // data/ is not shipped with the sources; the journal is the first
+    // thing opened, so create it here
+    std::error_code ec;
+    std::filesystem::path dir = std::filesystem::path(path).parent_path();
+    if (!dir.empty()) std::filesystem::create_directories(dir, ec);
+
+    fd = ::open(path.c_str(), O_RDWR | O_CREAT | O_APPEND, 0644);
+    if (fd < 0) {
+        LOG_ERROR("Journal: cannot open " << path);
+    } else {
+        replay();
+    }
+    buffer.reserve(WINDOW_BYTES);
+    committer = thread(&Journal::commitLoop, this);
+}
+
+Journal::~Journal() {
+    {
+        lock_guard<mutex> lk(bufferMutex);
+        stopping = true;
+    }
+    pendingCv.notify_all();
+    if (committer.joinable()) committer.join();
+    if (fd >= 0) ::close(fd);
+}
+
+// FNV-1a, enough to spot a torn tail after a crash
+uint32_t Journal::checksum(const char* p, size_t pathLen, const void* data, size_t size) {
+    uint32_t h = 2166136261u;
+    for (size_t i = 0; i < pathLen; i++) { h ^= (uint8_t)p[i]; h *= 16777619u; }
+    const uint8_t* d = static_cast<const uint8_t*>(data);
+    for (size_t i = 0; i < size; i++) { h ^= d[i]; h *= 16777619u; }
+    return h;
+}
+
+// Re-apply whatever survived in the journal onto the checkpoint files
+void Journal::replay() {
+    off_t len = ::lseek(fd, 0, SEEK_END);
+    if (len <= 0) return;
+
+    vector<char> log(len);
+    if (::pread(fd, log.data(), len, 0) != len) {
+        LOG_ERROR("Journal: short read during replay");
+        return;
+    }
+
+    map<string, fstream> files;
+    size_t pos = 0, applied = 0;
+
+    while (pos + sizeof(EntryHeader) <= log.size()) {
+        EntryHeader h;
+        memcpy(&h, &log[pos], sizeof(h));
+        size_t total = sizeof(h) + h.pathLen + h.size;
+        if (h.magic != ENTRY_MAGIC || pos + total > log.size()) break;
+
+        const char* p = &log[pos + sizeof(h)];
+        const char* data = p + h.pathLen;
+        if (checksum(p, h.pathLen, data, h.size) != h.checksum) break;
+
+        string file(p, h.pathLen);
+        fstream& f = files[file];
+        if (!f.is_open()) {
+            f.open(file, ios::in | ios::out | ios::binary);
+            if (!f.is_open()) {
+                f.open(file, ios::out | ios::binary);
+                f.close();
+                f.open(file, ios::in | ios::out | ios::binary);
+            }
+        }
+        f.seekp(h.offset, ios::beg);
+        f.write(data, h.size);
+
+        pos += total;
+        applied++;
+    }
+
+    for (auto& [file, f] : files) {
+        f.close();
+        int dfd = ::open(file.c_str(), O_RDONLY);
+        if (dfd >= 0) { ::fsync(dfd); ::close(dfd); }
+    }
+
+    if (pos < log.size()) {
+        LOG_WARN("Journal: discarded " << (log.size() - pos) << " bytes of torn tail");
+    }
+    LOG_INFO("Journal: replayed " << applied << " entries into " << files.size() << " files");
+
+    ::ftruncate(fd, 0);
+}
+
+void Journal::attach(StorageManager* mgr) {
+    lock_guard<mutex> lk(registryMutex);
+    managers.insert(mgr);
+}
+
+void Journal::detach(StorageManager* mgr) {
+    unique_lock<shared_mutex> ck(checkpointLock);
+    mgr->checkpoint();
+
+    lock_guard<mutex> lk(registryMutex);
+    managers.erase(mgr);
+
+    // Everything logged so far belongs to files that are now on disk
+    if (managers.empty()) {
+        lock_guard<mutex> cm(commitMutex);
+        {
+            lock_guard<mutex> bl(bufferMutex);
+            buffer.clear();
+            committedLsn = nextLsn;
+            epoch++;
+        }
+        committedCv.notify_all();
+        if (fd >= 0) ::ftruncate(fd, 0);
+        journalBytes = 0;
+    }
+}
+
+uint64_t Journal::log(const string& file, DiskOffset offset, const void* data, size_t size) {
+    EntryHeader h;
+    h.magic = ENTRY_MAGIC;
+    h.checksum = checksum(file.data(), file.size(), data, size);
+    h.offset = offset;
+    h.size = (uint32_t)size;
+    h.pathLen = (uint16_t)file.size();
+    h.reserved = 0;
+
+    uint64_t lsn;
+    bool wasEmpty;
+    {
+        lock_guard<mutex> lk(bufferMutex);
+        wasEmpty = buffer.empty();
+        size_t at = buffer.size();
+        buffer.resize(at + sizeof(h) + file.size() + size);
+        memcpy(&buffer[at], &h, sizeof(h));
+        memcpy(&buffer[at + sizeof(h)], file.data(), file.size());
+        memcpy(&buffer[at + sizeof(h) + file.size()], data, size);
+        lsn = nextLsn++;
+    }
+    entries++;
+    if (wasEmpty) pendingCv.notify_one();
+    return lsn;
+}
+
+void Journal::waitCommitted(uint64_t lsn) {
+    unique_lock<mutex> lk(bufferMutex);
+    committedCv.wait(lk, [&] { return committedLsn > lsn; });
+}
+
+void Journal::commitLoop() {
+    vector<char> batch;
+    batch.reserve(WINDOW_BYTES);
+    unique_lock<mutex> lk(bufferMutex);
+
+    while (true) {
+        pendingCv.wait(lk, [&] { return stopping || !buffer.empty(); });
+        if (buffer.empty() && stopping) break;
+
+        // Let the window fill up so many engine events share one write
+        if (!stopping && config.commitWindow.count() > 0) {
+            lk.unlock();
+            this_thread::sleep_for(config.commitWindow);
+            lk.lock();
+        }
+
+        batch.clear();
+        batch.swap(buffer);
+        uint64_t upTo = nextLsn;
+        uint64_t batchEpoch = epoch;
+        lk.unlock();
+
+        writeBatch(batch, upTo, batchEpoch);
+
+        if (journalBytes >= config.checkpointBytes) {
+            checkpoint();
+        }
+        lk.lock();
+    }
+}
+
+void Journal::writeBatch(vector<char>& batch, uint64_t upToLsn, uint64_t batchEpoch) {
+    {
+        lock_guard<mutex> cm(commitMutex);
+
+        // A checkpoint ran after this batch was taken; its files already
+        // hold these bytes and the journal has been truncated under us
+        if (batchEpoch == epoch && fd >= 0) {
+            size_t done = 0;
+            while (done < batch.size()) {
+                ssize_t n = ::write(fd, batch.data() + done, batch.size() - done);
+                if (n <= 0) { LOG_ERROR("Journal: write failed"); break; }
+                done += n;
+            }
+            if (config.syncOnCommit) ::fdatasync(fd);
+            journalBytes += batch.size();
+            commits++;
+        }
+    }
+
+    {
+        lock_guard<mutex> lk(bufferMutex);
+        if (upToLsn > committedLsn) committedLsn = upToLsn;
+    }
+    committedCv.notify_all();
+}
+
+void Journal::checkpoint() {
+    unique_lock<shared_mutex> ck(checkpointLock);
+    lock_guard<mutex> cm(commitMutex);
+
+    {
+        lock_guard<mutex> lk(registryMutex);
+        for (StorageManager* mgr : managers) mgr->checkpoint();
+    }
+
+    // Files now reflect every logged entry: drop what is queued and truncate
+    {
+        lock_guard<mutex> lk(bufferMutex);
+        buffer.clear();
+        committedLsn = nextLsn;
+        epoch++;
+    }
+    committedCv.notify_all();
+
+    if (fd >= 0) ::ftruncate(fd, 0);
+    journalBytes = 0;
+}
@@ -0,0 +1,124 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <mutex>
+#include <shared_mutex>
+#include <condition_variable>
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <unordered_set>
+
+using DiskOffset = uint64_t;
+
+class StorageManager;
+
+// Redo journal shared by every StorageManager.
+//
+// Each append/write is recorded as a physical redo entry
+// (file, offset, bytes) in one sequential log. The entry is logged before
+// the bytes are copied into the file, but at that point both are only in
+// memory: a committer thread writes a whole window's worth of entries with
+// a single write() and an optional fdatasync(), while the *.dat files are
+// checkpoints: mapped ones are updated through the mapping, STREAM ones
+// only in memory, and both reach disk at checkpoint time, after which the
+// journal is truncated.
+//
+// On startup any entries left in the journal (crash before checkpoint) are
+// replayed onto their files before the first StorageManager uses them, so a
+// file never misses a committed write; with waitForCommit a write does not
+// return before its entry is committed. This is not strict write-ahead:
+// the OS can write a data page back before the entry covering it reaches
+// the journal, so a file may also hold writes whose entries were lost.
+// Anything that points into a data file outside the journal (the IndexLog
+// files) has to check the record is really there when it loads.
+struct JournalConfig {
+    std::chrono::microseconds commitWindow{1000};  // group-commit window
+    bool syncOnCommit = false;      // fdatasync() after each group write
+    bool waitForCommit = false;     // block writers until their entry is committed
+    size_t checkpointBytes = 64u << 20;  // checkpoint once the journal grows past this
+};
+
+class Journal {
+private:
+    struct EntryHeader {
+        uint32_t magic;
+        uint32_t checksum;   // over path + payload
+        uint64_t offset;
+        uint32_t size;
+        uint16_t pathLen;
+        uint16_t reserved;
+    };
+
+    static const uint32_t ENTRY_MAGIC = 0x4A524E4C;  // "JRNL"
+    static JournalConfig config;
+
+    std::string path;
+    int fd;
+
+    // Held shared by StorageManager writes, exclusively by checkpoints
+    std::shared_mutex checkpointLock;
+
+    // Serialises journal file writes against truncation
+    std::mutex commitMutex;
+
+    std::mutex bufferMutex;
+    std::condition_variable pendingCv;
+    std::condition_variable committedCv;
+    std::vector<char> buffer;        // entries not yet handed to the committer
+
+    // buffer and the committer's batch swap every window, so both start
+    // this big and a busy window doesn't grow them on the writer's path
+    static constexpr size_t WINDOW_BYTES = 1u << 20;
+    uint64_t nextLsn;                // lsn of the next logged entry
+    uint64_t committedLsn;           // every entry below this is in the journal file
+    std::atomic<size_t> journalBytes;  // bytes in the journal file since last checkpoint
+    uint64_t epoch;                  // bumped by every checkpoint
+    bool stopping;
+
+    std::mutex registryMutex;
+    std::unordered_set<StorageManager*> managers;
+
+    std::thread committer;
+    std::atomic<uint64_t> commits;
+    std::atomic<uint64_t> entries;
+
+    Journal(const std::string& journalPath);
+    ~Journal();
+
+    void replay();
+    void commitLoop();
+    void writeBatch(std::vector<char>& batch, uint64_t upToLsn, uint64_t batchEpoch);
+
+    static uint32_t checksum(const char* path, size_t pathLen, const void* data, size_t size);
+
+public:
+    Journal(const Journal&) = delete;
+    Journal& operator=(const Journal&) = delete;
+
+    // Must be called before the first StorageManager is created
+    static void configure(const JournalConfig& cfg) { config = cfg; }
+    static Journal& instance();
+
+    void attach(StorageManager* mgr);
+    void detach(StorageManager* mgr);
+
+    // Writers hold this for the duration of the file write + log
+    std::shared_mutex& writeLock() { return checkpointLock; }
+
+    // Record a redo entry ahead of the file write. Caller holds
+    // writeLock() shared and the manager's own io lock, so per-file order
+    // in the journal matches the order the bytes hit the file.
+    uint64_t log(const std::string& file, DiskOffset offset, const void* data, size_t size);
+
+    // Block until the entry with this lsn is in the journal file
+    void waitCommitted(uint64_t lsn);
+    bool waitsForCommit() const { return config.waitForCommit; }
+
+    // Flush every attached file to disk and truncate the journal
+    void checkpoint();
+
+    uint64_t getCommitCount() const { return commits.load(); }
+    uint64_t getEntryCount() const { return entries.load(); }
+};
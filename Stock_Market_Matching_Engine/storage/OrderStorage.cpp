@@ -1,17 +1,41 @@
 #include "OrderStorage.h"
 #include "../core/Order.h"
-#include <fstream>
+#include "../core/Log.h"
 #include <iostream>
 
-OrderStorage::OrderStorage() : storage("data/orders.dat") {
+OrderStorage::OrderStorage()
+    : storage("data/orders.dat", StorageMode::MAPPED, sizeof(OrderRecord)),
+      indexLog("data/orders.idx") {
+    dataEnd = storage.getFileSize();
+
+    // Loading the index interns every symbol and user, so the saved keys
+    // have to be in place first
+    attachInternTables();
+
     // CHANGED: Only load indexes
     loadIndex();
-    cout << "Loaded order index: " << orderIDToOffsetMap.size() << " orders.\n";
+    cout << "Loaded order index: " << orderIDToOffsetMap.getSize() << " orders.\n";
+
+    spareNodes.reserve(MAX_SPARE_NODES);
+
+    // A checkpoint truncates the journal, so queued records must be in
+    // orders.dat by then
+    storage.setCheckpointHook([this] { applyPendingForCheckpoint(); });
+
+    writerThread = thread(&OrderStorage::writerLoop, this);
 }
 
 OrderStorage::~OrderStorage() {
-    // NEW: Save indexes on shutdown
-    saveIndex();
+    // Drain the write-behind queue before the index is written
+    {
+        lock_guard<mutex> lock(pendingMutex);
+        stopWriter = true;
+    }
+    pendingCv.notify_all();
+    if (writerThread.joinable()) writerThread.join();
+    storage.setCheckpointHook(nullptr);
+
+    // Index is already on disk: every persist appended to orders.idx.log
 }
 
 DiskOffset OrderStorage::persist(const Order& order) {
@@ -20,58 +44,207 @@ DiskOffset OrderStorage::persist(const Order& order) {
     OrderRecord rec = order.toRecord();
     DiskOffset rawOff = storage.append(&rec, sizeof(OrderRecord));
     DiskOffset storedOff = rawOff + 1;
+    dataEnd = rawOff + sizeof(OrderRecord);
     
     // CHANGED: Update indexes only
-    orderIDToOffsetMap[order.orderID] = storedOff;
-    symbolToOrdersMap[order.symbol].push_back(order.orderID);
-    userToOrdersMap[order.userID].push_back(order.orderID);
+    indexOrder(order.orderID, storedOff, order.symbol, order.userID);
+
+    logEntry.id = order.orderID;
+    logEntry.offset = storedOff;
+    logEntry.symbol = order.symbol;
+    logEntry.userID = order.userID;
+    indexLog.append(logEntry);
+    if (indexLog.needsCompaction()) compactIndex();
     
     return storedOff;
 }
 
 Order OrderStorage::load(DiskOffset offset) {
     if (offset == 0) {
-        std::cerr << "[ERR] load called with offset=0\n";
+        LOG_ERROR("load called with offset=0");
         return Order();
     }
     
     if (offset == 1) {
-        std::cerr << "[ERR] load called with offset=1 (likely invalid)\n";
+        LOG_ERROR("load called with offset=1 (likely invalid)");
+    }
+    
+    OrderRecord rec;
+    if (!readRecord(offset, rec)) {
+        return Order(); // Return empty order
+    }
+    return Order::fromRecord(rec);
+}
+
+bool OrderStorage::loadRecord(DiskOffset offset, OrderRecord& rec) {
+    if (offset == 0) {
+        LOG_ERROR("loadRecord called with offset=0");
+        return false;
+    }
+    return readRecord(offset, rec);
+}
+
+// Raw record at offset (pending writes first), without building an Order
+bool OrderStorage::readRecord(DiskOffset offset, OrderRecord& rec) {
+    if (readPending(offset, rec)) {
+        return true;
     }
     
     DiskOffset rawOff = offset - 1;
     
     // ✅ ADD: Check if offset is within file bounds
-    std::ifstream checkFile("data/orders.dat", std::ios::binary | std::ios::ate);
-    size_t fileSize = checkFile.tellg();
-    checkFile.close();
-    
+    size_t fileSize = dataEnd;
     if (rawOff + sizeof(OrderRecord) > fileSize) {
-        std::cerr << "[ERR] offset " << offset << " beyond file size " << fileSize << "\n";
-        return Order(); // Return empty order
+        LOG_ERROR("offset " << offset << " beyond file size " << fileSize);
+        return false;
     }
     
-    OrderRecord rec;
     storage.read(rawOff, &rec, sizeof(OrderRecord));
-    return Order::fromRecord(rec);
+    return true;
 }
 
 
 void OrderStorage::save(const Order& order, DiskOffset offset) {
+    saveRecord(order.toRecord(), offset);
+}
+
+void OrderStorage::saveRecord(const OrderRecord& rec, DiskOffset offset) {
     if (offset == 0) return;
     
     DiskOffset rawOff = offset - 1;
-    OrderRecord rec = order.toRecord();
-    storage.write(rawOff, &rec, sizeof(OrderRecord));
+    uint64_t lsn;
+    {
+        auto ck = storage.holdCheckpoint();
+        lock_guard<mutex> lock(pendingMutex);
+        lsn = storage.logWrite(rawOff, &rec, sizeof(OrderRecord));
+
+        // A queued async write for this offset would land after us and undo it
+        if (pendingWrites.count(offset) || inFlightWrites.count(offset)) {
+            queueWrite(offset, rec);
+            pendingCv.notify_one();
+        } else {
+            storage.applyWrite(rawOff, &rec, sizeof(OrderRecord));
+        }
+    }
+    storage.waitLogged(lsn);
+}
+
+void OrderStorage::saveAsync(const Order& order, DiskOffset offset) {
+    saveRecordAsync(order.toRecord(), offset);
+}
+
+void OrderStorage::saveRecordAsync(const OrderRecord& rec, DiskOffset offset) {
+    if (offset == 0) return;
+    
+    // The new state is journaled here, before this returns; only copying it
+    // into orders.dat is left to the writer thread
+    uint64_t lsn;
+    {
+        auto ck = storage.holdCheckpoint();
+        lock_guard<mutex> lock(pendingMutex);
+        lsn = storage.logWrite(offset - 1, &rec, sizeof(OrderRecord));
+        queueWrite(offset, rec);  // newest state wins
+    }
+    pendingCv.notify_one();
+    storage.waitLogged(lsn);
+}
+
+void OrderStorage::queueWrite(DiskOffset offset, const OrderRecord& rec) {
+    auto it = pendingWrites.find(offset);
+    if (it != pendingWrites.end()) {
+        it->second = rec;
+        return;
+    }
+    if (spareNodes.empty()) {
+        pendingWrites.emplace(offset, rec);
+        return;
+    }
+    auto node = std::move(spareNodes.back());
+    spareNodes.pop_back();
+    node.key() = offset;
+    node.mapped() = rec;
+    pendingWrites.insert(std::move(node));
+}
+
+void OrderStorage::flushPending() {
+    unique_lock<mutex> lock(pendingMutex);
+    drainedCv.wait(lock, [this] {
+        return pendingWrites.empty() && inFlightWrites.empty();
+    });
+}
+
+bool OrderStorage::readPending(DiskOffset offset, OrderRecord& out) const {
+    lock_guard<mutex> lock(pendingMutex);
     
-    // REMOVED: Don't update ordersMap - it doesn't exist
+    auto it = pendingWrites.find(offset);
+    if (it != pendingWrites.end()) {
+        out = it->second;
+        return true;
+    }
+    it = inFlightWrites.find(offset);
+    if (it != inFlightWrites.end()) {
+        out = it->second;
+        return true;
+    }
+    return false;
+}
+
+void OrderStorage::recycleNodes(map<DiskOffset, OrderRecord>& written) {
+    while (!written.empty() && spareNodes.size() < MAX_SPARE_NODES) {
+        spareNodes.push_back(written.extract(written.begin()));
+    }
+    written.clear();
+}
+
+// Every queued record is already in the journal, so this only copies it
+// into orders.dat (no second journal entry)
+void OrderStorage::writerLoop() {
+    unique_lock<mutex> lock(pendingMutex);
+    
+    while (true) {
+        pendingCv.wait(lock, [this] { return stopWriter || !pendingWrites.empty(); });
+        
+        if (pendingWrites.empty()) {
+            if (stopWriter) break;
+            continue;
+        }
+        
+        // No checkpoint may run between taking the batch and applying it;
+        // the checkpoint lock is always taken before pendingMutex
+        lock.unlock();
+        auto ck = storage.holdCheckpoint();
+        lock.lock();
+        
+        // Take the whole batch; the map keeps it in file order
+        inFlightWrites.swap(pendingWrites);
+        lock.unlock();
+        
+        for (const auto& [offset, rec] : inFlightWrites) {
+            storage.applyWrite(offset - 1, &rec, sizeof(OrderRecord));
+        }
+        
+        lock.lock();
+        recycleNodes(inFlightWrites);
+        ck.unlock();
+        if (pendingWrites.empty()) drainedCv.notify_all();
+    }
+}
+
+// Runs inside a journal checkpoint with every writer locked out, so the
+// writer thread is not mid-batch and inFlightWrites is empty
+void OrderStorage::applyPendingForCheckpoint() {
+    lock_guard<mutex> lock(pendingMutex);
+    for (const auto& [offset, rec] : pendingWrites) {
+        storage.applyWrite(offset - 1, &rec, sizeof(OrderRecord));
+    }
+    recycleNodes(pendingWrites);
+    drainedCv.notify_all();
 }
 
 DiskOffset OrderStorage::getOffsetForOrder(int orderID) {
     lock_guard<mutex> lock(indexMutex);
     
-    auto it = orderIDToOffsetMap.find(orderID);
-    return (it != orderIDToOffsetMap.end()) ? it->second : 0;
+    return orderIDToOffsetMap.get(orderID);
 }
 
 // NEW: Load single order by ID
@@ -84,7 +257,7 @@ Order OrderStorage::loadOrder(int orderID) {
 // NEW: Check if order exists
 bool OrderStorage::orderExists(int orderID) {
     lock_guard<mutex> lock(indexMutex);
-    return orderIDToOffsetMap.find(orderID) != orderIDToOffsetMap.end();
+    return orderIDToOffsetMap.contains(orderID);
 }
 
 // NEW: Load orders for a specific user
@@ -92,13 +265,12 @@ vector<Order> OrderStorage::loadOrdersForUser(const string& userID) {
     lock_guard<mutex> lock(indexMutex);
     
     vector<Order> orders;
-    auto it = userToOrdersMap.find(userID);
-    if (it == userToOrdersMap.end()) return orders;
+    const KeyChain* chain = chainFor(userChains, userTable(), userID);
+    if (!chain) return orders;
     
-    orders.reserve(it->second.size());
-    for (int orderID : it->second) {
-        DiskOffset offset = orderIDToOffsetMap[orderID];
-        orders.push_back(load(offset));
+    orders.reserve(chain->count);
+    for (int i = chain->head; i >= 0; i = indexLinks[i].nextByUser) {
+        orders.push_back(load(orderIDToOffsetMap.get(indexLinks[i].orderID)));
     }
     
     return orders;
@@ -108,186 +280,232 @@ vector<Order> OrderStorage::loadAllOrdersForSymbol(const string& symbol) {
     lock_guard<mutex> lock(indexMutex);
     
     vector<Order> orders;
-    auto it = symbolToOrdersMap.find(symbol);
-    if (it == symbolToOrdersMap.end()) return orders;
+    const KeyChain* chain = chainFor(symbolChains, symbolTable(), symbol);
+    if (!chain) return orders;
     
-    orders.reserve(it->second.size());
-    for (int orderID : it->second) {
-        DiskOffset offset = orderIDToOffsetMap[orderID];
-        orders.push_back(load(offset));
+    orders.reserve(chain->count);
+    for (int i = chain->head; i >= 0; i = indexLinks[i].nextBySymbol) {
+        orders.push_back(load(orderIDToOffsetMap.get(indexLinks[i].orderID)));
     }
     
     return orders;
 }
 
+vector<pair<DiskOffset, Order>> OrderStorage::loadLiveOrdersForSymbol(const string& symbol) {
+    vector<DiskOffset> offsets;
+    {
+        lock_guard<mutex> lock(indexMutex);
+        const KeyChain* chain = chainFor(symbolChains, symbolTable(), symbol);
+        if (!chain) return {};
+        
+        offsets.reserve(chain->count);
+        for (int i = chain->head; i >= 0; i = indexLinks[i].nextBySymbol) {
+            if (const DiskOffset* off = orderIDToOffsetMap.find(indexLinks[i].orderID))
+                offsets.push_back(*off);
+        }
+    }
+    
+    // Filter on the raw record so dead orders never become Order objects
+    vector<pair<DiskOffset, Order>> live;
+    OrderRecord rec;
+    for (DiskOffset offset : offsets) {
+        if (!readRecord(offset, rec)) continue;
+        if (rec.status != 'A' && rec.status != 'P') continue;
+        if (rec.remainingQty <= 0) continue;
+        live.emplace_back(offset, Order::fromRecord(rec));
+    }
+    
+    return live;
+}
+
+bool OrderStorage::reloadLiveOrders(const vector<SnapshotOrder>& saved,
+                                    vector<pair<DiskOffset, Order>>& live) {
+    OrderRecord rec;
+    for (const SnapshotOrder& s : saved) {
+        if (!readRecord(s.offset, rec) || rec.orderID != s.rec.orderID) return false;
+        if (rec.status != 'A' && rec.status != 'P') continue;
+        if (rec.remainingQty <= 0) continue;
+        live.emplace_back(s.offset, Order::fromRecord(rec));
+    }
+    return true;
+}
+
+unordered_map<string, vector<pair<DiskOffset, Order>>> OrderStorage::loadLiveOrdersSince(DiskOffset rawFrom) {
+    unordered_map<string, vector<pair<DiskOffset, Order>>> live;
+    
+    storage.scan(sizeof(OrderRecord), [&](DiskOffset rawOff, const void* p) {
+        OrderRecord rec = *static_cast<const OrderRecord*>(p);
+        readPending(rawOff + 1, rec);   // a queued write is newer than the file
+        
+        if (rec.orderID == 0 || rec.symbol[0] == '\0') return;
+        if (rec.status != 'A' && rec.status != 'P') return;
+        if (rec.remainingQty <= 0) return;
+        
+        Order o = Order::fromRecord(rec);
+        live[o.symbol].emplace_back(rawOff + 1, std::move(o));
+    }, rawFrom);
+    
+    return live;
+}
+
 vector<Order> OrderStorage::loadAllOrders() {
     lock_guard<mutex> lock(indexMutex);
     
     vector<Order> result;
-    result.reserve(orderIDToOffsetMap.size());
+    result.reserve(orderIDToOffsetMap.getSize());
     
-    for (const auto& [orderID, offset] : orderIDToOffsetMap) {
+    orderIDToOffsetMap.forEach([&](int, DiskOffset offset) {
         result.push_back(load(offset));
-    }
+    });
     
     return result;
 }
 
-void OrderStorage::loadIndex() {
-    ifstream indexFile("data/orders.idx", ios::binary);
-    
-    if (!indexFile) {
-        cout << "Order index not found, rebuilding...\n";
-        rebuildIndex();
+void OrderStorage::indexOrder(int orderID, DiskOffset offset,
+                              string_view symbol, string_view userID) {
+    // Entries can repeat (log replayed over a snapshot that already has
+    // them); only the first one goes into the secondary indexes
+    if (DiskOffset* known = orderIDToOffsetMap.find(orderID)) {
+        *known = offset;
         return;
     }
-    
-    // ✅ ADD: Check file size first
-    indexFile.seekg(0, ios::end);
-    size_t fileSize = indexFile.tellg();
-    indexFile.seekg(0, ios::beg);
-    
-    if (fileSize < sizeof(size_t)) {
-        cout << "Order index corrupted, rebuilding...\n";
-        indexFile.close();
-        rebuildIndex();
-        return;
+    orderIDToOffsetMap.insert(orderID, offset);
+
+    uint32_t sym = symbolTable().intern(symbol);
+    uint32_t user = userTable().intern(userID);
+    if (sym >= symbolChains.size()) symbolChains.resize(sym + 1);
+    if (user >= userChains.size()) userChains.resize(user + 1);
+
+    int link = (int)indexLinks.size();
+    indexLinks.push_back(IndexLink{orderID, sym, user, -1, -1});
+
+    KeyChain& bySymbol = symbolChains[sym];
+    if (bySymbol.tail >= 0) indexLinks[bySymbol.tail].nextBySymbol = link;
+    else bySymbol.head = link;
+    bySymbol.tail = link;
+    bySymbol.count++;
+
+    KeyChain& byUser = userChains[user];
+    if (byUser.tail >= 0) indexLinks[byUser.tail].nextByUser = link;
+    else byUser.head = link;
+    byUser.tail = link;
+    byUser.count++;
+}
+
+// Caller holds indexMutex; nullptr if the name has no orders
+const OrderStorage::KeyChain* OrderStorage::chainFor(const vector<KeyChain>& chains, InternTable& table,
+                                                     const string& name) const {
+    uint32_t key;
+    if (!table.find(name, key) || key >= chains.size()) return nullptr;
+    return &chains[key];
+}
+
+void OrderStorage::reserveOrders(size_t n) {
+    {
+        lock_guard<mutex> lock(indexMutex);
+        orderIDToOffsetMap.reserve(orderIDToOffsetMap.getSize() + (int)n);
+        indexLinks.reserve(indexLinks.size() + n);
+        if (indexLog.needsCompaction(n)) compactIndex();
     }
-    
-    // Load primary index (orderID -> offset)
-    size_t count;
-    indexFile.read(reinterpret_cast<char*>(&count), sizeof(count));
-    
-    // ✅ ADD: Sanity check on count
-    if (count > 1000000) {  // More than 1 million orders is suspicious
-        cout << "Order index has invalid count: " << count << ", rebuilding...\n";
-        indexFile.close();
-        rebuildIndex();
-        return;
+
+    // Spare nodes only come back from written batches, so a writer that
+    // falls behind for the first time would make queueWrite allocate
+    lock_guard<mutex> lock(pendingMutex);
+    map<DiskOffset, OrderRecord> fresh;
+    for (DiskOffset i = 0; spareNodes.size() + fresh.size() < MAX_SPARE_NODES; i++) {
+        fresh.emplace_hint(fresh.end(), i, OrderRecord{});
     }
-    
-    for (size_t i = 0; i < count; i++) {
-        int orderID;
-        indexFile.read(reinterpret_cast<char*>(&orderID), sizeof(orderID));
-        
-        DiskOffset offset;
-        indexFile.read(reinterpret_cast<char*>(&offset), sizeof(offset));
-        
-        // Read symbol
-        size_t symLen;
-        indexFile.read(reinterpret_cast<char*>(&symLen), sizeof(symLen));
-        
-        // ✅ ADD: Validate symbol length
-        if (symLen > 100) {  // Symbol longer than 100 chars is invalid
-            cout << "Invalid symbol length: " << symLen << ", stopping index load\n";
-            indexFile.close();
-            rebuildIndex();
-            return;
-        }
-        
-        string symbol(symLen, '\0');
-        indexFile.read(&symbol[0], symLen);
-        
-        // Read userID
-        size_t userLen;
-        indexFile.read(reinterpret_cast<char*>(&userLen), sizeof(userLen));
-        
-        // ✅ ADD: Validate userID length
-        if (userLen > 100) {
-            cout << "Invalid userID length: " << userLen << ", stopping index load\n";
-            indexFile.close();
-            rebuildIndex();
+    recycleNodes(fresh);
+}
+
+void OrderStorage::loadIndex() {
+    // The index log is written straight to its file while orders.dat goes
+    // through the journal, so after a crash the log can name records that
+    // never made it to orders.dat. Those entries are dropped.
+    size_t dangling = 0;
+    DiskOffset indexedEnd = 0;   // raw end of the last record the index knows
+    bool ok = indexLog.load([this, &dangling, &indexedEnd](const IndexLog::Entry& e) {
+        if (e.offset == 0 || e.offset - 1 + sizeof(OrderRecord) > dataEnd) {
+            dangling++;
             return;
         }
-        
-        string userID(userLen, '\0');
-        indexFile.read(&userID[0], userLen);
-        
-        // Build secondary indexes
-        orderIDToOffsetMap[orderID] = offset;
-        symbolToOrdersMap[symbol].push_back(orderID);
-        userToOrdersMap[userID].push_back(orderID);
+        indexOrder((int)e.id, e.offset, e.symbol, e.userID);
+        indexedEnd = max<DiskOffset>(indexedEnd, e.offset - 1 + sizeof(OrderRecord));
+    });
+
+    if (!ok) {
+        cout << "Order index not found, rebuilding...\n";
+        rebuildIndex();
+        return;
     }
-    
-    indexFile.close();
-    cout << "Loaded order index: " << orderIDToOffsetMap.size() << " orders.\n";
-}
 
+    // The log is written in batches, so a crash can lose its newest
+    // entries. orders.dat is append-only and persist() logs in file order:
+    // whatever lies past the last indexed record is exactly what's missing.
+    size_t caughtUp = 0;
+    storage.scan(sizeof(OrderRecord), [&](DiskOffset rawOff, const void* p) {
+        const OrderRecord& rec = *static_cast<const OrderRecord*>(p);
+        if (rec.orderID == 0 || rec.symbol[0] == '\0') return;
+        indexOrder(rec.orderID, rawOff + 1,
+                   string_view(rec.symbol, strnlen(rec.symbol, sizeof(rec.symbol))),
+                   string_view(rec.userID, strnlen(rec.userID, sizeof(rec.userID))));
+        caughtUp++;
+    }, indexedEnd);
 
-void OrderStorage::saveIndex() {
-    ofstream indexFile("data/orders.idx", ios::binary);
-    if (!indexFile) {
-        cerr << "Failed to save order index\n";
-        return;
+    if (dangling > 0 || caughtUp > 0) {
+        // Rewrite the snapshot so stale entries can't match records
+        // appended at those offsets later, and the caught-up ones are kept
+        if (dangling > 0)
+            LOG_WARN("OrderStorage: dropped " << dangling << " index entries past the end of orders.dat");
+        if (caughtUp > 0)
+            LOG_WARN("OrderStorage: indexed " << caughtUp << " orders the index log had not written");
+        compactIndex();
     }
-    
-    lock_guard<mutex> lock(indexMutex);
-    
-    size_t count = orderIDToOffsetMap.size();
-    indexFile.write(reinterpret_cast<const char*>(&count), sizeof(count));
-    
-    for (const auto& [orderID, offset] : orderIDToOffsetMap) {
-        // Load order to get symbol and userID
-        Order order = load(offset);
-        
-        indexFile.write(reinterpret_cast<const char*>(&orderID), sizeof(orderID));
-        indexFile.write(reinterpret_cast<const char*>(&offset), sizeof(offset));
-        
-        // Write symbol
-        size_t symLen = order.symbol.size();
-        indexFile.write(reinterpret_cast<const char*>(&symLen), sizeof(symLen));
-        indexFile.write(order.symbol.c_str(), symLen);
-        
-        // Write userID
-        size_t userLen = order.userID.size();
-        indexFile.write(reinterpret_cast<const char*>(&userLen), sizeof(userLen));
-        indexFile.write(order.userID.c_str(), userLen);
+}
+
+// Write a fresh snapshot from the in-memory maps and empty the log.
+// symbol/userID come from the secondary indexes, so orders.dat is not read.
+void OrderStorage::compactIndex() {
+    vector<IndexLog::Entry> entries(indexLinks.size());
+    for (size_t i = 0; i < indexLinks.size(); i++) {
+        const IndexLink& link = indexLinks[i];
+        IndexLog::Entry& e = entries[i];
+        e.id = link.orderID;
+        e.offset = orderIDToOffsetMap.get(link.orderID);
+        e.symbol = symbolTable().name(link.symbolKey);
+        e.userID = userTable().name(link.userKey);
     }
-    
-    indexFile.close();
+    indexLog.compact(std::move(entries));
 }
 
 
 void OrderStorage::rebuildIndex() {
     orderIDToOffsetMap.clear();
-    symbolToOrdersMap.clear();
-    userToOrdersMap.clear();
-    
-    const size_t recSize = sizeof(OrderRecord);
-    ifstream f("data/orders.dat", ios::binary | ios::ate);
-    
-    if (!f) {
-        cout << "orders.dat not found, starting fresh\n";
-        return; // ✅ Exit early if file doesn't exist
-    }
-    
-    size_t fileSize = (size_t)f.tellg();
-    f.close();
+    indexLinks.clear();
+    symbolChains.clear();
+    userChains.clear();
     
     // ✅ ADD: Exit if file is empty
-    if (fileSize == 0) {
+    if (storage.getFileSize() == 0) {
         cout << "orders.dat is empty, starting fresh\n";
+        compactIndex();
         return;
     }
     
-    for (size_t rawOff = 0; rawOff + recSize <= fileSize; rawOff += recSize) {
-        OrderRecord rec;
-        storage.read(rawOff, &rec, recSize);
-        
-        Order o = Order::fromRecord(rec);
+    // Walk the records in place instead of one read() each
+    storage.scan(sizeof(OrderRecord), [&](DiskOffset rawOff, const void* p) {
+        const OrderRecord& rec = *static_cast<const OrderRecord*>(p);
         
         // ✅ ADD: Validate order
-        if (o.getOrderID() == 0 || o.symbol[0] == '\0') {
-            continue; // Skip invalid orders
+        if (rec.orderID == 0 || rec.symbol[0] == '\0') {
+            return; // Skip invalid orders
         }
         
-        DiskOffset storedOff = static_cast<DiskOffset>(rawOff) + 1;
-        
-        orderIDToOffsetMap[o.orderID] = storedOff;
-        symbolToOrdersMap[o.symbol].push_back(o.orderID);
-        userToOrdersMap[o.userID].push_back(o.orderID);
-    }
+        indexOrder(rec.orderID, rawOff + 1,
+                   string_view(rec.symbol, strnlen(rec.symbol, sizeof(rec.symbol))),
+                   string_view(rec.userID, strnlen(rec.userID, sizeof(rec.userID))));
+    });
     
-    cout << "Rebuilt order index: " << orderIDToOffsetMap.size() << " orders.\n";
-    saveIndex();
+    cout << "Rebuilt order index: " << orderIDToOffsetMap.getSize() << " orders.\n";
+    compactIndex();
 }
\ No newline at end of file
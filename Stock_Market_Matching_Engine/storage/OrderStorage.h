@@ -2,9 +2,16 @@
 
 #include "../core/Order.h"
 #include "StorageManager.h"
+#include "IndexLog.h"
+#include "BookSnapshot.h"
+#include "../data_structures/MyHashMap.h"
 #include <vector>
 #include <unordered_map>
+#include <map>
 #include <mutex>
+#include <thread>
+#include <atomic>
+#include <condition_variable>
 
 using DiskOffset = uint64_t;
 using namespace std;
@@ -12,18 +19,64 @@ using namespace std;
 class OrderStorage {
 private:
     StorageManager storage;
+
+    // orders.idx snapshot + orders.idx.log, appended on every persist
+    IndexLog indexLog;
     
     // CHANGED: Only keep indexes, not full orders
-    unordered_map<int, DiskOffset> orderIDToOffsetMap;  // orderID -> offset
+    MyHashMap<int, DiskOffset> orderIDToOffsetMap{0};  // orderID -> offset
     
-    // NEW: Secondary indexes for fast queries
-    unordered_map<string, vector<int>> symbolToOrdersMap;  // symbol -> orderIDs
-    unordered_map<string, vector<int>> userToOrdersMap;    // userID -> orderIDs
+    // NEW: Secondary indexes for fast queries. Every indexed order gets one
+    // link, in persist order, chained to the previous order with the same
+    // interned symbol / user key (core/Intern.h). One flat array, so
+    // reserveOrders() can size it up front.
+    struct IndexLink {
+        int orderID;
+        uint32_t symbolKey;
+        uint32_t userKey;
+        int nextBySymbol;   // link index, -1 = end of chain
+        int nextByUser;
+    };
+    struct KeyChain {
+        int head = -1;
+        int tail = -1;
+        size_t count = 0;
+    };
+    vector<IndexLink> indexLinks;
+    vector<KeyChain> symbolChains;   // symbol key -> its orders
+    vector<KeyChain> userChains;     // user key -> its orders
+    const KeyChain* chainFor(const vector<KeyChain>& chains, InternTable& table, const string& name) const;
+
+    // Entry for the index log, reused so persist doesn't build strings
+    IndexLog::Entry logEntry;
     
     // REMOVED: ordersMap - data lives on disk
     
     mutable mutex indexMutex;  // NEW: Thread safety
 
+    // Write-behind queue: saveAsync() journals the record, then parks the
+    // latest record per offset here and writerThread copies it into
+    // orders.dat, so the matching path never touches the data file.
+    // load() checks pending/in-flight records first (read-your-writes).
+    // A journal checkpoint applies what is still queued before it truncates
+    // the journal (applyPendingForCheckpoint).
+    map<DiskOffset, OrderRecord> pendingWrites;
+    map<DiskOffset, OrderRecord> inFlightWrites;
+
+    // Map nodes of written batches, reused by the next saves so queueing a
+    // write does not allocate in steady state
+    vector<map<DiskOffset, OrderRecord>::node_type> spareNodes;
+    static constexpr size_t MAX_SPARE_NODES = 4096;
+    mutable mutex pendingMutex;
+    condition_variable pendingCv;
+    condition_variable drainedCv;
+    bool stopWriter = false;
+    thread writerThread;
+
+    // Logical end of orders.dat (raw bytes), tracked in memory so load()
+    // does not have to stat the file for its bounds check.
+    atomic<DiskOffset> dataEnd{0};
+
 public:
     OrderStorage();
     OrderStorage(const OrderStorage&) = delete;
@@ -33,9 +86,42 @@ public:
     DiskOffset persist(const Order& order);
     Order load(DiskOffset offset);
     void save(const Order& order, DiskOffset offset);
+
+    // Asynchronous write-through used by resident order books
+    void saveAsync(const Order& order, DiskOffset offset);
+
+    // Record-level variants for the matching path (no Order / strings)
+    bool loadRecord(DiskOffset offset, OrderRecord& rec);
+    void saveRecord(const OrderRecord& rec, DiskOffset offset);
+    void saveRecordAsync(const OrderRecord& rec, DiskOffset offset);
+    void flushPending();  // blocks until every queued write reached the file
+
+    // Size the indexes for n more orders, compact the index log now if it
+    // would otherwise be due within them, and fill the write-behind node
+    // pool, so the next n persists and saves don't allocate (as long as n
+    // is no bigger than the index snapshot and the writer keeps within
+    // MAX_SPARE_NODES)
+    void reserveOrders(size_t n);
     
     // Existing methods
     vector<Order> loadAllOrdersForSymbol(const string& symbol);
+
+    // Only resting (ACTIVE / PARTIAL_FILL) orders, with their offsets, for
+    // startup recovery. indexMutex is held just long to copy the offsets,
+    // so several symbols can be loaded in parallel.
+    vector<pair<DiskOffset, Order>> loadLiveOrdersForSymbol(const string& symbol);
+
+    // Snapshot recovery: current state of the orders a snapshot saw (those
+    // no longer resting are dropped, order kept). False if a record no
+    // longer matches the snapshot, i.e. the snapshot is not for this file.
+    bool reloadLiveOrders(const vector<SnapshotOrder>& saved, vector<pair<DiskOffset, Order>>& live);
+
+    // Resting orders among the records appended at or after rawFrom, by symbol
+    unordered_map<string, vector<pair<DiskOffset, Order>>> loadLiveOrdersSince(DiskOffset rawFrom);
+
+    // End of orders.dat in raw bytes; records past it are newer than any
+    // snapshot taken now
+    DiskOffset getDataEnd() const { return dataEnd; }
     DiskOffset getOffsetForOrder(int orderID);
     vector<Order> loadAllOrders();
     
@@ -45,8 +131,16 @@ public:
     bool orderExists(int orderID);
     
 private:
+    void writerLoop();
+    void queueWrite(DiskOffset offset, const OrderRecord& rec);   // holds pendingMutex
+    void recycleNodes(map<DiskOffset, OrderRecord>& written);    // holds pendingMutex
+    void applyPendingForCheckpoint();
+    bool readPending(DiskOffset offset, OrderRecord& out) const;
+    bool readRecord(DiskOffset offset, OrderRecord& out);
+
     // NEW: Index management
     void loadIndex();
-    void saveIndex();
+    void compactIndex();   // caller holds indexMutex (or is the constructor)
     void rebuildIndex();
+    void indexOrder(int orderID, DiskOffset offset, string_view symbol, string_view userID);
 };
\ No newline at end of file
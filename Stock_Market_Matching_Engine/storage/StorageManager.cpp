@@ -1,53 +1,345 @@
 #include "StorageManager.h"
+#include "Journal.h"
+#include "../core/Log.h"
 #include <iostream>
+#include <vector>
+#include <cstring>
 #include <sys/stat.h>
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <unistd.h>
 
-StorageManager::StorageManager(const std::string& filename) {
-    file.open(filename, std::ios::in | std::ios::out | std::ios::binary);
+StorageManager::StorageManager(const std::string& filename, StorageMode m, size_t recSize)
+    : path(filename), mode(m), recordSize(recSize),
+      dirtyFrom(0), dirtyTo(0),
+      fd(-1), base(nullptr), capacity(0), dataSize(0) {
+    // Opening the journal replays anything left from an unclean shutdown,
+    // so do it before we look at the file
+    Journal& journal = Journal::instance();
+
+    if (mode == StorageMode::MAPPED) {
+        openMapped();
+    } else {
+        openStream();
+    }
+
+    journal.attach(this);
+}
+
+void StorageManager::openStream() {
+    file.open(path, std::ios::in | std::ios::out | std::ios::binary);
 
     if (!file.is_open()) {
         // create file if not exists
-        file.open(filename, std::ios::out | std::ios::binary);
+        file.open(path, std::ios::out | std::ios::binary);
         file.close();
-        file.open(filename, std::ios::in | std::ios::out | std::ios::binary);
+        file.open(path, std::ios::in | std::ios::out | std::ios::binary);
     }
+    if (!file.is_open()) {
+        LOG_ERROR("StorageManager: cannot open " << path);
+        return;
+    }
+
+    file.seekg(0, std::ios::end);
+    std::streamoff size = file.tellg();
+    if (size > 0) {
+        image.resize((size_t)size);
+        file.seekg(0, std::ios::beg);
+        file.read(image.data(), size);
+    }
+    file.clear();
 }
 
 StorageManager::~StorageManager() {
-    file.close();
+    Journal::instance().detach(this);
+    if (mode == StorageMode::MAPPED) {
+        closeMapped();
+    } else {
+        file.close();
+    }
+}
+
+void StorageManager::openMapped() {
+    fd = ::open(path.c_str(), O_RDWR | O_CREAT, 0644);
+    if (fd < 0) {
+        LOG_ERROR("StorageManager: cannot open " << path);
+        return;
+    }
+
+    struct stat st;
+    fstat(fd, &st);
+    size_t fileSize = st.st_size;
+
+    if (fileSize > 0) {
+        capacity = fileSize;
+        base = static_cast<char*>(mmap(nullptr, capacity, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0));
+        if (base == MAP_FAILED) {
+            LOG_ERROR("StorageManager: mmap failed for " << path);
+            base = nullptr;
+            capacity = 0;
+            return;
+        }
+    }
+
+    // A clean close truncates to the logical end. After a crash the extent
+    // padding is still there, so walk back over all-zero records.
+    size_t end = fileSize;
+    if (recordSize > 0) {
+        end -= end % recordSize;
+        while (end >= recordSize) {
+            const char* rec = base + end - recordSize;
+            bool zero = true;
+            for (size_t i = 0; i < recordSize; i++) {
+                if (rec[i]) { zero = false; break; }
+            }
+            if (!zero) break;
+            end -= recordSize;
+        }
+    }
+    dataSize = end;
+}
+
+void StorageManager::closeMapped() {
+    if (base) {
+        msync(base, capacity, MS_SYNC);
+        munmap(base, capacity);
+        base = nullptr;
+    }
+    if (fd >= 0) {
+        // Drop the unused extent so the file is exactly its records
+        if (ftruncate(fd, dataSize.load()) != 0) {
+            LOG_WARN("StorageManager: could not trim " << path);
+        }
+        ::close(fd);
+        fd = -1;
+    }
+}
+
+void StorageManager::growTo(size_t needed) {
+    size_t extent = std::min(std::max(capacity, MIN_EXTENT), MAX_EXTENT);
+    size_t newCap = capacity + extent;
+    while (newCap < needed) newCap += extent;
+
+    std::unique_lock<std::shared_mutex> lock(mapLock);
+    if (ftruncate(fd, newCap) != 0) {
+        LOG_ERROR("StorageManager: could not grow " << path << " to " << newCap);
+        return;
+    }
+    if (base) munmap(base, capacity);
+    base = static_cast<char*>(mmap(nullptr, newCap, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0));
+    if (base == MAP_FAILED) {
+        LOG_ERROR("StorageManager: remap failed for " << path);
+        base = nullptr;
+        capacity = 0;
+        return;
+    }
+    capacity = newCap;
 }
 
 DiskOffset StorageManager::append(const void* data, size_t size) {
-    std::lock_guard<std::mutex> lock(ioMutex);
+    Journal& journal = Journal::instance();
+    DiskOffset offset;
+    uint64_t lsn;
 
-    file.seekp(0, std::ios::end);
-    DiskOffset offset = file.tellp();
-    file.write(reinterpret_cast<const char*>(data), size);
-    file.flush();
+    if (mode == StorageMode::MAPPED) {
+        std::shared_lock<std::shared_mutex> ck(journal.writeLock());
+        std::lock_guard<std::mutex> lock(appendMutex);
+
+        offset = dataSize.load();
+        lsn = journal.log(path, offset, data, size);
+        if (offset + size > capacity) growTo(offset + size);
+        {
+            std::shared_lock<std::shared_mutex> map(mapLock);
+            memcpy(base + offset, data, size);
+        }
+        dataSize = offset + size;
+    } else {
+        std::shared_lock<std::shared_mutex> ck(journal.writeLock());
+        std::lock_guard<std::mutex> lock(ioMutex);
+
+        offset = image.size();
+        lsn = journal.log(path, offset, data, size);
+        writeImage(offset, data, size);
+    }
+
+    if (journal.waitsForCommit()) journal.waitCommitted(lsn);
     return offset;
 }
 
 void StorageManager::read(DiskOffset offset, void* buffer, size_t size) {
+    if (mode == StorageMode::MAPPED) {
+        std::shared_lock<std::shared_mutex> map(mapLock);
+        if (offset + size > capacity) {
+            memset(buffer, 0, size);
+            return;
+        }
+        memcpy(buffer, base + offset, size);
+        return;
+    }
+
     std::lock_guard<std::mutex> lock(ioMutex);
 
-    file.seekg(offset);
-    file.read(reinterpret_cast<char*>(buffer), size);
+    // Past the end reads as zeros, same as a mapped file
+    size_t avail = offset < image.size() ? std::min(size, image.size() - offset) : 0;
+    if (avail) memcpy(buffer, image.data() + offset, avail);
+    if (avail < size) memset(static_cast<char*>(buffer) + avail, 0, size - avail);
+}
+
+void StorageManager::writeImage(DiskOffset offset, const void* data, size_t size) {
+    if (offset + size > image.size()) image.resize(offset + size);
+    memcpy(image.data() + offset, data, size);
+
+    if (dirtyFrom == dirtyTo) {
+        dirtyFrom = offset;
+        dirtyTo = offset + size;
+    } else {
+        dirtyFrom = std::min<size_t>(dirtyFrom, offset);
+        dirtyTo = std::max<size_t>(dirtyTo, offset + size);
+    }
+}
+
+void StorageManager::writeMapped(DiskOffset offset, const void* data, size_t size) {
+    {
+        // In-place update of an existing record: just a store
+        std::shared_lock<std::shared_mutex> map(mapLock);
+        if (offset + size <= dataSize) {
+            memcpy(base + offset, data, size);
+            return;
+        }
+    }
+    std::lock_guard<std::mutex> lock(appendMutex);
+    if (offset + size > capacity) growTo(offset + size);
+    {
+        std::shared_lock<std::shared_mutex> map(mapLock);
+        memcpy(base + offset, data, size);
+    }
+    if (offset + size > dataSize) dataSize = offset + size;
 }
 
 void StorageManager::write(DiskOffset offset, const void* data, size_t size) {
+    Journal& journal = Journal::instance();
+    uint64_t lsn;
+
+    if (mode == StorageMode::MAPPED) {
+        std::shared_lock<std::shared_mutex> ck(journal.writeLock());
+        lsn = journal.log(path, offset, data, size);
+        writeMapped(offset, data, size);
+    } else {
+        std::shared_lock<std::shared_mutex> ck(journal.writeLock());
+        std::lock_guard<std::mutex> lock(ioMutex);
+
+        lsn = journal.log(path, offset, data, size);
+        writeImage(offset, data, size);
+    }
+
+    if (journal.waitsForCommit()) journal.waitCommitted(lsn);
+}
+
+std::shared_lock<std::shared_mutex> StorageManager::holdCheckpoint() {
+    return std::shared_lock<std::shared_mutex>(Journal::instance().writeLock());
+}
+
+uint64_t StorageManager::logWrite(DiskOffset offset, const void* data, size_t size) {
+    return Journal::instance().log(path, offset, data, size);
+}
+
+void StorageManager::applyWrite(DiskOffset offset, const void* data, size_t size) {
+    if (mode == StorageMode::MAPPED) {
+        writeMapped(offset, data, size);
+        return;
+    }
     std::lock_guard<std::mutex> lock(ioMutex);
-    file.seekp(offset, std::ios::beg);
-    file.write(reinterpret_cast<const char*>(data), size);
-    file.flush(); // Ensure data is written to disk
+    writeImage(offset, data, size);
+}
+
+void StorageManager::waitLogged(uint64_t lsn) {
+    Journal& journal = Journal::instance();
+    if (journal.waitsForCommit()) journal.waitCommitted(lsn);
+}
+
+void StorageManager::setCheckpointHook(std::function<void()> hook) {
+    // Exclusive, so a running checkpoint never sees the hook change
+    std::unique_lock<std::shared_mutex> ck(Journal::instance().writeLock());
+    checkpointHook = std::move(hook);
+}
+
+void StorageManager::discard(DiskOffset from, DiskOffset to) {
+    if (mode != StorageMode::MAPPED || fd < 0) return;
+
+    const DiskOffset page = (DiskOffset)sysconf(_SC_PAGESIZE);
+    from = (from + page - 1) / page * page;
+    to = std::min<DiskOffset>(to, dataSize.load()) / page * page;
+    if (from >= to) return;
+
+#ifdef FALLOC_FL_PUNCH_HOLE
+    if (fallocate(fd, FALLOC_FL_PUNCH_HOLE | FALLOC_FL_KEEP_SIZE, from, to - from) != 0) {
+        LOG_WARN("StorageManager: cannot punch a hole in " << path << ", keeping the space");
+    }
+#endif
+}
+
+void StorageManager::checkpoint() {
+    if (checkpointHook) checkpointHook();
+    syncToDisk();
+}
+
+void StorageManager::scan(size_t recSize, const std::function<void(DiskOffset, const void*)>& visit,
+                          DiskOffset from) {
+    size_t end = getFileSize();
+    size_t start = (from + recSize - 1) / recSize * recSize;
+
+    if (mode == StorageMode::MAPPED) {
+        std::shared_lock<std::shared_mutex> map(mapLock);
+        for (size_t off = start; off + recSize <= end; off += recSize) {
+            visit(off, base + off);
+        }
+        return;
+    }
+
+    // Read whole chunks of records at a time
+    const size_t perChunk = std::max<size_t>(1, (1u << 20) / recSize);
+    std::vector<char> chunk(perChunk * recSize);
+
+    for (size_t off = start; off + recSize <= end; ) {
+        size_t n = std::min(perChunk, (end - off) / recSize);
+        read(off, chunk.data(), n * recSize);
+        for (size_t i = 0; i < n; i++) {
+            visit(off + i * recSize, chunk.data() + i * recSize);
+        }
+        off += n * recSize;
+    }
 }
 
 size_t StorageManager::getFileSize() {
-    if (!file.is_open()) return 0;
-    
-    auto current = file.tellg();
-    file.seekg(0, std::ios::end);
-    size_t size = file.tellg();
-    file.seekg(current);
-    
-    return size;
-}
\ No newline at end of file
+    if (mode == StorageMode::MAPPED) return dataSize.load();
+
+    std::lock_guard<std::mutex> lock(ioMutex);
+    return image.size();
+}
+
+void StorageManager::syncToDisk() {
+    if (mode == StorageMode::MAPPED) {
+        std::shared_lock<std::shared_mutex> map(mapLock);
+        if (base) msync(base, capacity, MS_SYNC);
+        return;
+    }
+
+    std::lock_guard<std::mutex> lock(ioMutex);
+    if (!file.is_open() || dirtyFrom == dirtyTo) return;
+
+    file.seekp(dirtyFrom, std::ios::beg);
+    file.write(image.data() + dirtyFrom, dirtyTo - dirtyFrom);
+    file.flush();
+    if (!file) {
+        LOG_ERROR("StorageManager: write-out to " << path << " failed");
+        file.clear();
+        return;   // still dirty, the next checkpoint retries
+    }
+    dirtyFrom = dirtyTo = 0;
+
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd >= 0) {
+        ::fsync(fd);
+        ::close(fd);
+    }
+}
@@ -1,18 +1,73 @@
 #pragma once
 #include <cstdint>
 #include <string>
+#include <vector>
 #include <fstream>
 #include <mutex>
+#include <shared_mutex>
+#include <atomic>
+#include <functional>
 
 using DiskOffset = uint64_t;
 
+enum class StorageMode {
+    STREAM,   // small files held in memory, written out at checkpoints
+    MAPPED    // mmap'd file grown in extents; loads/saves are memcpy
+};
+
+// Record-oriented file access. Durability comes from the shared Journal
+// (see Journal.h), which logs every append/write and group-commits them;
+// the files themselves are checkpoints of the journal.
+//
+// In STREAM mode the whole file is read into memory on open. An append or
+// write only logs the entry and updates that copy, so it makes no syscall;
+// the changed range goes to the file (and is fsynced) at the next journal
+// checkpoint or on close.
+//
+// In MAPPED mode the file is mapped read/write and grown ahead of the data
+// in large extents. Readers only take mapLock shared (it is held exclusively
+// while the mapping is moved on growth), so concurrent loads don't queue on
+// a stream. The padding past the logical end is trimmed on close; after a
+// crash the logical end is found by dropping trailing all-zero records, so
+// recordSize must be set for MAPPED files.
 class StorageManager {
 private:
+    std::string path;
+    StorageMode mode;
+    size_t recordSize;
+
+    // STREAM mode
     std::fstream file;
     std::mutex ioMutex;
+    std::vector<char> image;             // file contents, newer than the file
+    size_t dirtyFrom;                    // [dirtyFrom, dirtyTo) not written out
+    size_t dirtyTo;
+
+    void openStream();
+    void writeImage(DiskOffset offset, const void* data, size_t size);   // holds ioMutex
+
+    // MAPPED mode
+    int fd;
+    char* base;
+    size_t capacity;
+    std::atomic<size_t> dataSize;
+    std::shared_mutex mapLock;
+    std::mutex appendMutex;
+
+    static constexpr size_t MIN_EXTENT = 1u << 20;    // 1 MB
+    static constexpr size_t MAX_EXTENT = 64u << 20;   // 64 MB
+
+    std::function<void()> checkpointHook;   // see setCheckpointHook()
+
+    void openMapped();
+    void closeMapped();
+    void growTo(size_t needed);   // caller holds appendMutex
+    void writeMapped(DiskOffset offset, const void* data, size_t size);
 
 public:
-    StorageManager(const std::string& filename);
+    StorageManager(const std::string& filename,
+                   StorageMode mode = StorageMode::STREAM,
+                   size_t recordSize = 0);
     ~StorageManager();
     StorageManager(const StorageManager&) = delete;
     StorageManager& operator=(const StorageManager&) = delete;
@@ -24,5 +79,40 @@ public:
     void read(DiskOffset offset, void* buffer, size_t size);
     void write(DiskOffset offset, const void* data, size_t size);
 
+    // Visit every whole record in [from, size) in file order (from is
+    // rounded up to a record boundary). MAPPED mode hands out pointers into
+    // the mapping (valid only during the callback); STREAM mode reads the
+    // file in large chunks instead of one read per record.
+    void scan(size_t recSize, const std::function<void(DiskOffset, const void*)>& visit,
+              DiskOffset from = 0);
+
+    // Deferred in-place writes, for owners that queue record updates and
+    // apply them from a background thread. Logging a write and queueing it,
+    // and later applying it, both happen under holdCheckpoint(), so the
+    // journal is never truncated while a logged write is only in the queue
+    // or half applied. Whatever is still queued at a checkpoint is applied
+    // by the hook, which runs with every writer locked out.
+    std::shared_lock<std::shared_mutex> holdCheckpoint();
+    uint64_t logWrite(DiskOffset offset, const void* data, size_t size);   // journal only
+    void applyWrite(DiskOffset offset, const void* data, size_t size);     // file only
+    void waitLogged(uint64_t lsn);   // no-op unless the journal waits for commits
+    void setCheckpointHook(std::function<void()> hook);
+
+    // Give the disk space of [from, to) back to the filesystem (MAPPED
+    // only; whole pages inside the range). The range then reads as zeros,
+    // so the owner must have another copy of it and must keep the file's
+    // last record in place. No-op where hole punching is unsupported.
+    void discard(DiskOffset from, DiskOffset to);
+
+    // Journal checkpoints call this: the hook, then syncToDisk()
+    void checkpoint();
+
     size_t getFileSize();
+    const std::string& getPath() const { return path; }
+    StorageMode getMode() const { return mode; }
+
+    // Write out what is only in memory (msync when mapped) and fsync the
+    // file. Called at journal checkpoints and shutdown; safe to call
+    // explicitly.
+    void syncToDisk();
 };
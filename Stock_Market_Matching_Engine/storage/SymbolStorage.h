@@ -5,20 +5,70 @@
 #include <algorithm>
 #include <string>
 #include <cstring>
+#include <unordered_map>
+#include "../core/Price.h"
+#include "../core/Intern.h"
 
 using namespace std;
+
+// One record per symbol in data/ticksizes.dat
+struct TickSizeRecord {
+    char symbol[16];
+    int64_t tickSize;   // fixed-point, see Price.h
+};
+
 class SymbolStorage {
 private:
     StorageManager storage;
+    StorageManager tickStorage;
 
 public:
-    SymbolStorage() : storage("data/symbols.dat") {}
+    // Symbol keys (see Intern.h) come from data/symbols.intern so they stay
+    // put across restarts; symbols.dat is still the list of symbols
+    SymbolStorage() : storage("data/symbols.dat"), tickStorage("data/ticksizes.dat") {
+        attachInternTables();
+        for (const string& symbol : loadAllSymbols()) symbolTable().intern(symbol);
+    }
 
-void addSymbol(const std::string& symbol) {
+void addSymbol(const std::string& symbol, Price tickSize = DEFAULT_TICK_SIZE) {
     vector<std::string> symbols = loadAllSymbols();
     if (find(symbols.begin(), symbols.end(), symbol) == symbols.end()) {
         storage.append(symbol.c_str(), symbol.size() + 1);
+
+        TickSizeRecord rec;
+        memset(&rec, 0, sizeof(rec));
+        strncpy(rec.symbol, symbol.c_str(), sizeof(rec.symbol) - 1);
+        rec.tickSize = tickSize;
+        tickStorage.append(&rec, sizeof(rec));
     }
+    symbolTable().intern(symbol);
+}
+
+// Symbols created before tick sizes were stored trade in DEFAULT_TICK_SIZE
+Price getTickSize(const std::string& symbol) {
+    size_t size = tickStorage.getFileSize();
+    
+    for (size_t offset = 0; offset + sizeof(TickSizeRecord) <= size; offset += sizeof(TickSizeRecord)) {
+        TickSizeRecord rec;
+        tickStorage.read(offset, &rec, sizeof(rec));
+        if (strncmp(rec.symbol, symbol.c_str(), sizeof(rec.symbol)) == 0 && rec.tickSize > 0) {
+            return rec.tickSize;
+        }
+    }
+    return DEFAULT_TICK_SIZE;
+}
+
+// Every stored tick size in one pass (startup uses this instead of a
+// getTickSize scan per symbol). Missing symbols use DEFAULT_TICK_SIZE.
+unordered_map<string, Price> loadAllTickSizes() {
+    unordered_map<string, Price> ticks;
+    tickStorage.scan(sizeof(TickSizeRecord), [&](DiskOffset, const void* p) {
+        const TickSizeRecord& rec = *static_cast<const TickSizeRecord*>(p);
+        if (rec.tickSize <= 0) return;
+        string symbol(rec.symbol, strnlen(rec.symbol, sizeof(rec.symbol)));
+        ticks.emplace(symbol, rec.tickSize);   // first record wins, as in getTickSize
+    });
+    return ticks;
 }
 
 vector<string> loadAllSymbols() {
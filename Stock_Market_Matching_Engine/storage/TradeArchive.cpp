@@ -0,0 +1,503 @@
+#include "TradeArchive.h"
+#include "../core/Log.h"
+#include "../core/Varint.h"
+#include <algorithm>
+#include <cstring>
+#include <string_view>
+#include <unordered_map>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+namespace {
+
+bool preadAll(int fd, void* buf, size_t n, uint64_t offset) {
+    char* p = static_cast<char*>(buf);
+    while (n > 0) {
+        ssize_t r = ::pread(fd, p, n, offset);
+        if (r <= 0) return false;
+        p += r;
+        n -= r;
+        offset += r;
+    }
+    return true;
+}
+
+bool pwriteAll(int fd, const void* buf, size_t n, uint64_t offset) {
+    const char* p = static_cast<const char*>(buf);
+    while (n > 0) {
+        ssize_t w = ::pwrite(fd, p, n, offset);
+        if (w <= 0) return false;
+        p += w;
+        n -= w;
+        offset += w;
+    }
+    return true;
+}
+
+uint64_t fnv1a64(string_view s) {
+    uint64_t h = 0xcbf29ce484222325ull;
+    for (char c : s) {
+        h ^= (uint8_t)c;
+        h *= 0x100000001b3ull;
+    }
+    return h;
+}
+
+uint32_t fnv1a32(const char* p, size_t n) {
+    uint32_t h = 0x811c9dc5u;
+    for (size_t i = 0; i < n; i++) {
+        h ^= (uint8_t)p[i];
+        h *= 0x01000193u;
+    }
+    return h;
+}
+
+// Three bits per name, taken from different parts of one 64-bit hash
+void bloomAdd(vector<uint64_t>& bloom, string_view name) {
+    uint64_t h = fnv1a64(name);
+    for (int k = 0; k < 3; k++) {
+        size_t bit = (h >> (k * 21)) % (bloom.size() * 64);
+        bloom[bit / 64] |= 1ull << (bit % 64);
+    }
+}
+
+bool bloomHas(const vector<uint64_t>& bloom, string_view name) {
+    if (bloom.empty()) return true;
+    uint64_t h = fnv1a64(name);
+    for (int k = 0; k < 3; k++) {
+        size_t bit = (h >> (k * 21)) % (bloom.size() * 64);
+        if (!(bloom[bit / 64] & (1ull << (bit % 64)))) return false;
+    }
+    return true;
+}
+
+// Bloom over a dictionary: BLOOM_BITS_PER_NAME bits per name, whole words
+vector<uint64_t> makeBloom(const vector<string_view>& names, size_t bitsPerName) {
+    vector<uint64_t> bloom(max<size_t>(1, (names.size() * bitsPerName + 63) / 64), 0);
+    for (string_view n : names) bloomAdd(bloom, n);
+    return bloom;
+}
+
+string_view fieldView(const char* field, size_t size) {
+    return string_view(field, strnlen(field, size));
+}
+
+// Columns stored as deltas from the previous row
+bool isDeltaColumn(int c) {
+    return c == TRADE_COL_TRADE_ID || c == TRADE_COL_TIME || c == TRADE_COL_BUY_ORDER ||
+           c == TRADE_COL_SELL_ORDER || c == TRADE_COL_PRICE;
+}
+
+}
+
+// Columns of one segment, each read from disk the first time it is asked for
+class TradeArchive::Reader {
+private:
+    int fd;
+    const Segment& seg;
+    vector<int64_t> values[TRADE_COLUMN_COUNT];
+    vector<string> dicts[2];
+    bool loaded[TRADE_COLUMN_COUNT] = {};
+
+    bool readColumn(int c, vector<char>& bytes) {
+        uint32_t from = seg.header.columnOffset[c];
+        uint32_t to = seg.header.columnOffset[c + 1];
+        bytes.resize(to - from);
+        return preadAll(fd, bytes.data(), bytes.size(), seg.bodyOffset + from);
+    }
+
+public:
+    bool ok = true;
+
+    Reader(int file, const Segment& segment) : fd(file), seg(segment) {}
+
+    size_t rows() const { return seg.header.count; }
+
+    const vector<string>& dict(TradeColumn c) {
+        vector<string>& d = dicts[c == TRADE_COL_USER_DICT];
+        if (loaded[c]) return d;
+        loaded[c] = true;
+
+        vector<char> bytes;
+        size_t pos = 0;
+        uint64_t n = 0;
+        if (!readColumn(c, bytes) || !getVarint(bytes.data(), bytes.size(), pos, n)) {
+            ok = false;
+            return d;
+        }
+        d.reserve(n);
+        for (uint64_t i = 0; i < n; i++) {
+            uint64_t len;
+            if (!getVarint(bytes.data(), bytes.size(), pos, len) || pos + len > bytes.size()) {
+                ok = false;
+                break;
+            }
+            d.emplace_back(bytes.data() + pos, len);
+            pos += len;
+        }
+        return d;
+    }
+
+    const vector<int64_t>& column(TradeColumn c) {
+        vector<int64_t>& v = values[c];
+        if (loaded[c]) return v;
+        loaded[c] = true;
+
+        vector<char> bytes;
+        if (!readColumn(c, bytes)) {
+            ok = false;
+            v.assign(rows(), 0);
+            return v;
+        }
+        v.resize(rows());
+        size_t pos = 0;
+        int64_t prev = 0;
+        bool signedColumn = c != TRADE_COL_SYMBOL && c != TRADE_COL_BUYER && c != TRADE_COL_SELLER;
+        for (size_t i = 0; i < v.size(); i++) {
+            uint64_t raw = 0;
+            if (!getVarint(bytes.data(), bytes.size(), pos, raw)) ok = false;
+            int64_t x = signedColumn ? unzigzag(raw) : (int64_t)raw;
+            if (isDeltaColumn(c)) x += prev;
+            v[i] = prev = x;
+        }
+        return v;
+    }
+
+    // Row i as a Trade; pulls in every column it still needs
+    Trade trade(size_t i) {
+        const vector<string>& symbols = dict(TRADE_COL_SYMBOL_DICT);
+        const vector<string>& users = dict(TRADE_COL_USER_DICT);
+        auto name = [](const vector<string>& d, int64_t at) -> string_view {
+            return at >= 0 && (size_t)at < d.size() ? string_view(d[at]) : string_view();
+        };
+
+        Trade t;
+        t.tradeID = (int)column(TRADE_COL_TRADE_ID)[i];
+        t.buyOrderID = (int)column(TRADE_COL_BUY_ORDER)[i];
+        t.sellOrderID = (int)column(TRADE_COL_SELL_ORDER)[i];
+        t.buyUserKey = userTable().intern(name(users, column(TRADE_COL_BUYER)[i]));
+        t.sellUserKey = userTable().intern(name(users, column(TRADE_COL_SELLER)[i]));
+        t.symbolKey = symbolTable().intern(name(symbols, column(TRADE_COL_SYMBOL)[i]));
+        t.price = column(TRADE_COL_PRICE)[i];
+        t.quantity = (int)column(TRADE_COL_QUANTITY)[i];
+        t.timestamp = (time_t)column(TRADE_COL_TIME)[i];
+        return t;
+    }
+};
+
+TradeArchive::TradeArchive(const string& file)
+    : path(file), fd(-1), fileEnd(0), archived(0) {
+    open();
+}
+
+TradeArchive::~TradeArchive() {
+    if (fd >= 0) ::close(fd);
+}
+
+// Load every segment header, cutting the file at the first segment that
+// is torn, fails its checksum or does not continue where the last ended
+void TradeArchive::open() {
+    fd = ::open(path.c_str(), O_RDWR | O_CREAT, 0644);
+    if (fd < 0) {
+        LOG_ERROR("TradeArchive: cannot open " << path);
+        return;
+    }
+
+    struct stat st;
+    uint64_t size = ::fstat(fd, &st) == 0 ? st.st_size : 0;
+    uint32_t hdr[2] = {0, 0};
+    if (size < FILE_HEADER || !preadAll(fd, hdr, sizeof(hdr), 0) ||
+        hdr[0] != FILE_MAGIC || hdr[1] != FILE_VERSION) {
+        // An older version is sealed again from trades.dat, which still
+        // has every record: those versions never gave space back
+        if (size > 0) LOG_WARN("TradeArchive: " << path << " is not a version " << FILE_VERSION << " trade archive, starting it over");
+        truncateTo(0);
+        uint32_t fresh[2] = {FILE_MAGIC, FILE_VERSION};
+        if (!pwriteAll(fd, fresh, sizeof(fresh), 0)) LOG_ERROR("TradeArchive: cannot write " << path);
+        fileEnd = FILE_HEADER;
+        return;
+    }
+
+    uint64_t pos = FILE_HEADER;
+    uint64_t expected = 0;
+    vector<char> body;
+    while (pos + sizeof(TradeSegmentHeader) <= size) {
+        Segment seg;
+        if (!preadAll(fd, &seg.header, sizeof(seg.header), pos)) break;
+        const TradeSegmentHeader& h = seg.header;
+        seg.bodyOffset = pos + sizeof(TradeSegmentHeader);
+        if (h.magic != SEGMENT_MAGIC || h.count == 0 || h.firstRecord != expected) break;
+        if (seg.bodyOffset + h.bodySize > size || h.columnOffset[TRADE_COLUMN_COUNT] != h.bodySize) break;
+
+        body.resize(h.bodySize);
+        if (!preadAll(fd, body.data(), body.size(), seg.bodyOffset)) break;
+        if (fnv1a32(body.data(), body.size()) != h.checksum) break;
+
+        loadBlooms(seg, body.data());
+        segments.push_back(move(seg));
+        pos = seg.bodyOffset + h.bodySize;
+        expected += h.count;
+    }
+
+    if (pos < size) {
+        LOG_WARN("TradeArchive: dropping a damaged tail of " << path << " (" << (size - pos) << " bytes)");
+        truncateTo(pos);
+    }
+    fileEnd = pos;
+    archived = expected;
+}
+
+void TradeArchive::loadBlooms(Segment& seg, const char* body) {
+    auto words = [&](int c, vector<uint64_t>& bloom) {
+        uint32_t from = seg.header.columnOffset[c];
+        uint32_t to = seg.header.columnOffset[c + 1];
+        bloom.resize((to - from) / sizeof(uint64_t));
+        if (!bloom.empty()) memcpy(bloom.data(), body + from, bloom.size() * sizeof(uint64_t));
+    };
+    words(TRADE_COL_SYMBOL_BLOOM, seg.symbolBloom);
+    words(TRADE_COL_USER_BLOOM, seg.userBloom);
+}
+
+void TradeArchive::truncateTo(uint64_t size) {
+    if (::ftruncate(fd, size) != 0) LOG_ERROR("TradeArchive: cannot truncate " << path);
+}
+
+bool TradeArchive::append(const vector<TradeRecord>& records, uint64_t firstRecord) {
+    if (records.empty() || fd < 0) return false;
+    if (firstRecord != archived.load()) {
+        LOG_ERROR("TradeArchive: segment starting at " << firstRecord << " does not follow " << archived.load());
+        return false;
+    }
+
+    TradeSegmentHeader h;
+    memset(&h, 0, sizeof(h));
+    h.magic = SEGMENT_MAGIC;
+    h.count = (uint32_t)records.size();
+    h.firstRecord = firstRecord;
+    h.minTradeID = h.maxTradeID = records[0].tradeID;
+    h.minTime = h.maxTime = records[0].timestamp;
+    h.lastTradeID = records.back().tradeID;
+
+    vector<char> cols[TRADE_COLUMN_COUNT];
+    unordered_map<string_view, uint32_t> symbolAt, userAt;
+    vector<string_view> symbols, users;
+    auto indexOf = [](string_view name, unordered_map<string_view, uint32_t>& at, vector<string_view>& names) {
+        auto it = at.find(name);
+        if (it != at.end()) return it->second;
+        uint32_t i = (uint32_t)names.size();
+        at.emplace(name, i);
+        names.push_back(name);
+        return i;
+    };
+
+    int64_t prev[TRADE_COLUMN_COUNT] = {};
+    auto putDelta = [&](int c, int64_t v) {
+        putSignedVarint(cols[c], v - prev[c]);
+        prev[c] = v;
+    };
+
+    for (const TradeRecord& r : records) {
+        string_view symbol = fieldView(r.symbol, sizeof(r.symbol));
+        string_view buyer = fieldView(r.buyUserID, sizeof(r.buyUserID));
+        string_view seller = fieldView(r.sellUserID, sizeof(r.sellUserID));
+
+        h.minTradeID = min(h.minTradeID, r.tradeID);
+        h.maxTradeID = max(h.maxTradeID, r.tradeID);
+        h.minTime = min<int64_t>(h.minTime, r.timestamp);
+        h.maxTime = max<int64_t>(h.maxTime, r.timestamp);
+
+        putDelta(TRADE_COL_TRADE_ID, r.tradeID);
+        putDelta(TRADE_COL_TIME, r.timestamp);
+        putDelta(TRADE_COL_BUY_ORDER, r.buyOrderID);
+        putDelta(TRADE_COL_SELL_ORDER, r.sellOrderID);
+        putVarint(cols[TRADE_COL_SYMBOL], indexOf(symbol, symbolAt, symbols));
+        putVarint(cols[TRADE_COL_BUYER], indexOf(buyer, userAt, users));
+        putVarint(cols[TRADE_COL_SELLER], indexOf(seller, userAt, users));
+        putDelta(TRADE_COL_PRICE, r.price);
+        putSignedVarint(cols[TRADE_COL_QUANTITY], r.quantity);
+    }
+
+    auto putDict = [](vector<char>& out, const vector<string_view>& names) {
+        putVarint(out, names.size());
+        for (string_view n : names) {
+            putVarint(out, n.size());
+            out.insert(out.end(), n.begin(), n.end());
+        }
+    };
+    putDict(cols[TRADE_COL_SYMBOL_DICT], symbols);
+    putDict(cols[TRADE_COL_USER_DICT], users);
+    Segment seg;
+    seg.symbolBloom = makeBloom(symbols, BLOOM_BITS_PER_NAME);
+    seg.userBloom = makeBloom(users, BLOOM_BITS_PER_NAME);
+    auto putWords = [](vector<char>& out, const vector<uint64_t>& bloom) {
+        const char* p = reinterpret_cast<const char*>(bloom.data());
+        out.insert(out.end(), p, p + bloom.size() * sizeof(uint64_t));
+    };
+    putWords(cols[TRADE_COL_SYMBOL_BLOOM], seg.symbolBloom);
+    putWords(cols[TRADE_COL_USER_BLOOM], seg.userBloom);
+
+    vector<char> out(sizeof(h));
+    for (int c = 0; c < TRADE_COLUMN_COUNT; c++) {
+        h.columnOffset[c] = (uint32_t)(out.size() - sizeof(h));
+        out.insert(out.end(), cols[c].begin(), cols[c].end());
+    }
+    h.bodySize = (uint32_t)(out.size() - sizeof(h));
+    h.columnOffset[TRADE_COLUMN_COUNT] = h.bodySize;
+    h.checksum = fnv1a32(out.data() + sizeof(h), h.bodySize);
+    memcpy(out.data(), &h, sizeof(h));
+
+    // Only one thread appends (TradeStorage's sealer), so the write and
+    // fsync happen outside the lock and readers keep going meanwhile
+    uint64_t at;
+    {
+        lock_guard<mutex> guard(lock);
+        at = fileEnd;
+    }
+    if (!pwriteAll(fd, out.data(), out.size(), at) || ::fdatasync(fd) != 0) {
+        LOG_ERROR("TradeArchive: cannot write a segment to " << path);
+        return false;
+    }
+
+    seg.header = h;
+    seg.bodyOffset = at + sizeof(h);
+    lock_guard<mutex> guard(lock);
+    segments.push_back(move(seg));
+    fileEnd = at + out.size();
+    archived = firstRecord + h.count;
+    return true;
+}
+
+void TradeArchive::reset() {
+    lock_guard<mutex> guard(lock);
+    segments.clear();
+    truncateTo(FILE_HEADER);
+    fileEnd = FILE_HEADER;
+    archived = 0;
+}
+
+void TradeArchive::cutTo(uint64_t records) {
+    lock_guard<mutex> guard(lock);
+    while (!segments.empty() &&
+           segments.back().header.firstRecord + segments.back().header.count > records) {
+        fileEnd = segments.back().bodyOffset - sizeof(TradeSegmentHeader);
+        segments.pop_back();
+    }
+    truncateTo(fileEnd);
+    archived = segments.empty() ? 0 : segments.back().header.firstRecord + segments.back().header.count;
+}
+
+int TradeArchive::lastTradeID() const {
+    lock_guard<mutex> guard(lock);
+    return segments.empty() ? 0 : segments.back().header.lastTradeID;
+}
+
+size_t TradeArchive::segmentCount() const {
+    lock_guard<mutex> guard(lock);
+    return segments.size();
+}
+
+uint64_t TradeArchive::fileSize() const {
+    lock_guard<mutex> guard(lock);
+    return fileEnd;
+}
+
+template <typename Wanted, typename Match>
+uint64_t TradeArchive::query(Wanted wanted, Match match, vector<Trade>& out) const {
+    lock_guard<mutex> guard(lock);
+
+    vector<uint32_t> rows;
+    for (const Segment& seg : segments) {
+        if (!wanted(seg)) continue;
+
+        Reader reader(fd, seg);
+        rows.clear();
+        match(reader, rows);
+        for (uint32_t i : rows) out.push_back(reader.trade(i));
+        if (!reader.ok) LOG_ERROR("TradeArchive: unreadable segment at " << seg.bodyOffset << " in " << path);
+    }
+    return archived.load();
+}
+
+uint64_t TradeArchive::tradesForUser(const string& userID, vector<Trade>& out) const {
+    return query(
+        [&](const Segment& s) { return bloomHas(s.userBloom, userID); },
+        [&](Reader& r, vector<uint32_t>& rows) {
+            const vector<string>& users = r.dict(TRADE_COL_USER_DICT);
+            int64_t want = -1;
+            for (size_t i = 0; i < users.size() && want < 0; i++) {
+                if (users[i] == userID) want = (int64_t)i;
+            }
+            if (want < 0) return;
+
+            const vector<int64_t>& buyers = r.column(TRADE_COL_BUYER);
+            const vector<int64_t>& sellers = r.column(TRADE_COL_SELLER);
+            for (size_t i = 0; i < r.rows(); i++) {
+                if (buyers[i] == want || sellers[i] == want) rows.push_back((uint32_t)i);
+            }
+        },
+        out);
+}
+
+uint64_t TradeArchive::tradesForSymbol(const string& symbol, vector<Trade>& out) const {
+    return query(
+        [&](const Segment& s) { return bloomHas(s.symbolBloom, symbol); },
+        [&](Reader& r, vector<uint32_t>& rows) {
+            const vector<string>& symbols = r.dict(TRADE_COL_SYMBOL_DICT);
+            int64_t want = -1;
+            for (size_t i = 0; i < symbols.size() && want < 0; i++) {
+                if (symbols[i] == symbol) want = (int64_t)i;
+            }
+            if (want < 0) return;
+
+            const vector<int64_t>& col = r.column(TRADE_COL_SYMBOL);
+            for (size_t i = 0; i < r.rows(); i++) {
+                if (col[i] == want) rows.push_back((uint32_t)i);
+            }
+        },
+        out);
+}
+
+uint64_t TradeArchive::tradesBetween(time_t from, time_t to, vector<Trade>& out) const {
+    return query(
+        [&](const Segment& s) { return s.header.maxTime >= from && s.header.minTime <= to; },
+        [&](Reader& r, vector<uint32_t>& rows) {
+            const vector<int64_t>& times = r.column(TRADE_COL_TIME);
+            for (size_t i = 0; i < r.rows(); i++) {
+                if (times[i] >= from && times[i] <= to) rows.push_back((uint32_t)i);
+            }
+        },
+        out);
+}
+
+uint64_t TradeArchive::allTrades(vector<Trade>& out) const {
+    return query(
+        [](const Segment&) { return true; },
+        [](Reader& r, vector<uint32_t>& rows) {
+            for (size_t i = 0; i < r.rows(); i++) rows.push_back((uint32_t)i);
+        },
+        out);
+}
+
+bool TradeArchive::tradeAt(uint64_t record, Trade& out) const {
+    lock_guard<mutex> guard(lock);
+    auto it = upper_bound(segments.begin(), segments.end(), record,
+                          [](uint64_t r, const Segment& s) { return r < s.header.firstRecord; });
+    if (it == segments.begin()) return false;
+    const Segment& seg = *--it;
+    if (record >= seg.header.firstRecord + seg.header.count) return false;
+
+    Reader reader(fd, seg);
+    out = reader.trade(record - seg.header.firstRecord);
+    return reader.ok;
+}
+
+void TradeArchive::forEachTradeID(const function<void(uint64_t, int)>& visit) const {
+    lock_guard<mutex> guard(lock);
+    for (const Segment& seg : segments) {
+        Reader reader(fd, seg);
+        const vector<int64_t>& ids = reader.column(TRADE_COL_TRADE_ID);
+        if (!reader.ok) LOG_ERROR("TradeArchive: unreadable segment at " << seg.bodyOffset << " in " << path);
+        for (size_t i = 0; i < ids.size(); i++) visit(seg.header.firstRecord + i, (int)ids[i]);
+    }
+}
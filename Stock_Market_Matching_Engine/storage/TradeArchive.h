@@ -0,0 +1,140 @@
+#pragma once
+
+#include "../core/Trade.h"
+#include <cstdint>
+#include <ctime>
+#include <string>
+#include <vector>
+#include <mutex>
+#include <atomic>
+#include <functional>
+
+using namespace std;
+
+// Sealed trades in columnar form: data/trades.arc.
+//
+// TradeStorage keeps appending fixed TradeRecords to trades.dat; every
+// TRADES_PER_SEGMENT of them get rolled into one segment here. A segment
+// stores each field as its own column of varints:
+//   - trade ID, timestamp, order IDs and price as zigzag deltas from the
+//     previous row
+//   - symbol and users as indexes into the segment's own dictionaries
+//   - quantity as is
+// That takes a trade from ~300 bytes to ~10-15.
+//
+// The header of every segment stays in memory: trade ID / time ranges,
+// plus bloom filters over the segment's symbols and users, stored as
+// columns of their own and sized from the dictionaries (BLOOM_BITS_PER_NAME
+// bits per name, so a segment with thousands of users stays selective).
+// A query skips segments by header and bloom first, then reads only the
+// columns it filters on (e.g. the user dictionary, buyer and seller), and
+// decodes the remaining columns only for segments that actually have a
+// match.
+//
+// Segments are only ever appended. The archive is derived from trades.dat,
+// so a torn or missing last segment is simply cut off and sealed again,
+// as long as trades.dat still has those records: TradeStorage gives back
+// the space of sealed records once they are safely on disk here.
+enum TradeColumn {
+    TRADE_COL_SYMBOL_DICT,  // [varint n]{[varint len][bytes]}
+    TRADE_COL_USER_DICT,
+    TRADE_COL_TRADE_ID,     // zigzag delta
+    TRADE_COL_TIME,         // zigzag delta
+    TRADE_COL_BUY_ORDER,    // zigzag delta
+    TRADE_COL_SELL_ORDER,   // zigzag delta
+    TRADE_COL_SYMBOL,       // symbol dictionary index
+    TRADE_COL_BUYER,        // user dictionary index
+    TRADE_COL_SELLER,       // user dictionary index
+    TRADE_COL_PRICE,        // zigzag delta
+    TRADE_COL_QUANTITY,     // zigzag
+    TRADE_COL_SYMBOL_BLOOM, // raw 64-bit words
+    TRADE_COL_USER_BLOOM,
+    TRADE_COLUMN_COUNT
+};
+
+struct TradeSegmentHeader {
+    uint32_t magic;                 // "TSEG"
+    uint32_t bodySize;              // column bytes following the header
+    uint32_t checksum;              // FNV-1a of the body
+    uint32_t count;                 // trades in the segment
+    uint64_t firstRecord;           // trades.dat position of the first one
+    int32_t minTradeID;
+    int32_t maxTradeID;
+    int32_t lastTradeID;            // ID of the segment's last record
+    int32_t reserved;
+    int64_t minTime;
+    int64_t maxTime;
+    uint32_t columnOffset[TRADE_COLUMN_COUNT + 1];  // column c = body[off[c], off[c+1])
+};
+
+class TradeArchive {
+public:
+    static constexpr size_t TRADES_PER_SEGMENT = 4096;
+
+private:
+    static constexpr uint32_t FILE_MAGIC = 0x43524154;      // "TARC"
+    static constexpr uint32_t FILE_VERSION = 2;   // 1 had fixed 512/1024-bit blooms in the header
+    static constexpr uint32_t SEGMENT_MAGIC = 0x47455354;   // "TSEG"
+    static constexpr size_t FILE_HEADER = sizeof(uint32_t) * 2;
+    static constexpr size_t BLOOM_BITS_PER_NAME = 10;   // ~2% false positives with 3 probes
+
+    struct Segment {
+        TradeSegmentHeader header;
+        uint64_t bodyOffset;        // file offset of the body
+        vector<uint64_t> symbolBloom;
+        vector<uint64_t> userBloom;
+    };
+
+    class Reader;
+
+    string path;
+    int fd;
+    vector<Segment> segments;       // file order
+    uint64_t fileEnd;
+    atomic<uint64_t> archived;      // trades.dat records covered so far
+    mutable mutex lock;             // segments / fileEnd; appends
+
+    void open();
+    void truncateTo(uint64_t size);   // caller holds lock
+    static void loadBlooms(Segment& seg, const char* body);
+
+    // Visit the matches of every segment 'wanted' lets through; returns
+    // the number of trades.dat records the visited segments cover
+    template <typename Wanted, typename Match>
+    uint64_t query(Wanted wanted, Match match, vector<Trade>& out) const;
+
+public:
+    explicit TradeArchive(const string& file);
+    ~TradeArchive();
+
+    TradeArchive(const TradeArchive&) = delete;
+    TradeArchive& operator=(const TradeArchive&) = delete;
+
+    // Seal records as one segment; firstRecord must be archivedRecords()
+    bool append(const vector<TradeRecord>& records, uint64_t firstRecord);
+
+    // Drop every segment (trades.dat no longer matches the archive)
+    void reset();
+    // Drop the segments that reach past the first 'records' records
+    // (trades.dat lost its tail)
+    void cutTo(uint64_t records);
+
+    uint64_t archivedRecords() const { return archived.load(); }
+    // ID of the last archived record, 0 if there is none
+    int lastTradeID() const;
+    size_t segmentCount() const;
+    uint64_t fileSize() const;
+
+    // Matching trades in trades.dat order. Each returns how many
+    // trades.dat records it covered; the caller scans the rest.
+    uint64_t tradesForUser(const string& userID, vector<Trade>& out) const;
+    uint64_t tradesForSymbol(const string& symbol, vector<Trade>& out) const;
+    uint64_t tradesBetween(time_t from, time_t to, vector<Trade>& out) const;
+    uint64_t allTrades(vector<Trade>& out) const;
+
+    // The trade at trades.dat position 'record' (decodes its segment), for
+    // records whose trades.dat space was given back
+    bool tradeAt(uint64_t record, Trade& out) const;
+    // trades.dat position and trade ID of every archived trade
+    void forEachTradeID(const function<void(uint64_t, int)>& visit) const;
+};
@@ -1,16 +1,149 @@
 #include "TradeStorage.h"
-#include <fstream>
+#include "../core/Log.h"
 #include <iostream>
+#include <cstring>
+
+TradeStorage::TradeStorage()
+    : storage("data/trades.dat", StorageMode::MAPPED, sizeof(TradeRecord)),
+      indexLog("data/trades.idx"),
+      archive("data/trades.arc") {
+    attachInternTables();   // trades loaded from here on carry keys
 
-TradeStorage::TradeStorage() : storage("data/trades.dat") {
     // CHANGED: Only load index
     loadIndex();
     cout << "Loaded trade index: " << tradeIDToOffsetMap.size() << " trades.\n";
+
+    recordCount = storage.getFileSize() / sizeof(TradeRecord);
+    checkArchive();
+
+    // What survived a crash may only be in the page cache; sync it once so
+    // the sealed part of it can be reclaimed
+    storage.syncToDisk();
+    syncedRecords = recordCount;
+    reclaimSealed();
+    storage.setCheckpointHook([this] {
+        reclaimSealed();
+        syncedRecords = recordCount;   // the checkpoint syncs them next
+    });
+
+    // Starts by sealing whatever backlog trades.dat already has
+    sealerThread = thread(&TradeStorage::sealerLoop, this);
 }
 
 TradeStorage::~TradeStorage() {
-    // NEW: Save index on shutdown
-    saveIndex();
+    {
+        lock_guard<mutex> lock(sealMutex);
+        stopSealer = true;
+    }
+    sealCv.notify_all();
+    if (sealerThread.joinable()) sealerThread.join();
+    storage.setCheckpointHook(nullptr);
+
+    // Nothing to save: persist() already appended to trades.idx.log
+}
+
+// The archive is a copy of trades.dat's first records. Segments covering
+// records trades.dat lost with its unsynced tail are dropped (they are
+// never reclaimed ones, see reclaimSealed()). If the rest does not match,
+// start it over, unless trades.dat's space was already given back: then
+// the archive has the only copy.
+void TradeStorage::checkArchive() {
+    if (archive.archivedRecords() > recordCount) {
+        LOG_WARN("TradeStorage: trades.arc is ahead of trades.dat, dropping its last segments");
+        archive.cutTo(recordCount);
+    }
+    uint64_t archived = archive.archivedRecords();
+    if (archived == 0) return;
+
+    TradeRecord last;
+    storage.read((archived - 1) * sizeof(TradeRecord), &last, sizeof(last));
+    if (last.tradeID == archive.lastTradeID()) return;
+
+    TradeRecord first;
+    storage.read(0, &first, sizeof(first));
+    if (first.tradeID == 0) {
+        LOG_ERROR("TradeStorage: trades.arc does not match trades.dat, keeping it (reclaimed trades only live there)");
+        return;
+    }
+    LOG_WARN("TradeStorage: trades.arc does not match trades.dat, sealing it again");
+    archive.reset();
+}
+
+// Punch out whole sealed segments that are on disk in trades.dat as well.
+// The last record of the range stays, so checkArchive() can still compare
+// it and the mapped file never ends in zeros. Always from the start:
+// punching a hole again is cheap, and journal replay may have refilled one.
+void TradeStorage::reclaimSealed() {
+    const uint64_t n = TradeArchive::TRADES_PER_SEGMENT;
+    uint64_t upTo = min<uint64_t>(archive.archivedRecords(), syncedRecords) / n * n;
+    if (upTo == 0 || upTo - 1 <= reclaimedRecords) return;
+
+    reclaimedRecords = upTo - 1;   // before the punch, see load()
+    storage.discard(0, (upTo - 1) * sizeof(TradeRecord));
+}
+
+void TradeStorage::recordsAppended(size_t n) {
+    uint64_t count = recordCount += n;
+    if (count - archive.archivedRecords() >= TradeArchive::TRADES_PER_SEGMENT) sealCv.notify_all();
+}
+
+void TradeStorage::sealerLoop() {
+    const size_t n = TradeArchive::TRADES_PER_SEGMENT;
+    vector<TradeRecord> batch(n);
+    unique_lock<mutex> lock(sealMutex);
+
+    while (true) {
+        // Appends notify without sealMutex, so also look every so often
+        sealCv.wait_for(lock, chrono::milliseconds(100), [&] {
+            return stopSealer || recordCount - archive.archivedRecords() >= n;
+        });
+        if (stopSealer) break;
+        if (recordCount - archive.archivedRecords() < n) continue;
+
+        // Whole segments only; a partial one stays in trades.dat's tail
+        lock.unlock();
+        bool ok = true;
+        while (ok && recordCount - archive.archivedRecords() >= n) {
+            uint64_t first = archive.archivedRecords();
+            storage.read(first * sizeof(TradeRecord), batch.data(), n * sizeof(TradeRecord));
+            ok = archive.append(batch, first);
+        }
+        lock.lock();
+
+        if (ok) {
+            sealFailed = false;
+            sealCv.notify_all();   // sealPending() waiters
+            continue;
+        }
+
+        // The backlog is still there, so the wait above would return at
+        // once; sit out the retry interval instead. Queries are unaffected,
+        // they scan whatever is not archived yet from trades.dat.
+        if (!sealFailed) {
+            LOG_ERROR("TradeStorage: sealing trades.arc failed, retrying every "
+                      << SEAL_RETRY.count() << "s");
+        }
+        sealFailed = true;
+        sealCv.notify_all();
+        sealCv.wait_for(lock, SEAL_RETRY, [&] { return stopSealer; });
+        if (stopSealer) break;
+    }
+}
+
+bool TradeStorage::sealPending() {
+    unique_lock<mutex> lock(sealMutex);
+    sealCv.notify_all();
+    sealCv.wait(lock, [&] {
+        return stopSealer || sealFailed ||
+               recordCount - archive.archivedRecords() < TradeArchive::TRADES_PER_SEGMENT;
+    });
+    return !sealFailed;
+}
+
+void TradeStorage::scanTail(uint64_t from, const function<void(const TradeRecord&)>& visit) {
+    storage.scan(sizeof(TradeRecord), [&](DiskOffset, const void* p) {
+        visit(*static_cast<const TradeRecord*>(p));
+    }, from * sizeof(TradeRecord));
 }
 
 DiskOffset TradeStorage::persist(const Trade& trade) {
@@ -19,19 +152,52 @@ DiskOffset TradeStorage::persist(const Trade& trade) {
     TradeRecord rec = trade.toRecord();
     DiskOffset rawOff = storage.append(&rec, sizeof(TradeRecord));
     DiskOffset storedOff = rawOff + 1;
+    recordsAppended(1);
     
     // CHANGED: Only update index
     tradeIDToOffsetMap[trade.tradeID] = storedOff;
+
+    IndexLog::Entry e;
+    e.id = trade.tradeID;
+    e.offset = storedOff;
+    indexLog.append(e);
+    if (indexLog.needsCompaction()) compactIndex();
     
     return storedOff;
 }
 
+void TradeStorage::persistBatch(const vector<Trade>& trades) {
+    if (trades.empty()) return;
+    lock_guard<mutex> lock(indexMutex);
+
+    vector<TradeRecord> recs;
+    recs.reserve(trades.size());
+    for (const Trade& t : trades) recs.push_back(t.toRecord());
+    DiskOffset rawOff = storage.append(recs.data(), recs.size() * sizeof(TradeRecord));
+    recordsAppended(recs.size());
+
+    vector<IndexLog::Entry> entries(trades.size());
+    for (size_t i = 0; i < trades.size(); i++) {
+        DiskOffset storedOff = rawOff + i * sizeof(TradeRecord) + 1;
+        tradeIDToOffsetMap[trades[i].tradeID] = storedOff;
+        entries[i].id = trades[i].tradeID;
+        entries[i].offset = storedOff;
+    }
+    indexLog.append(entries);
+    if (indexLog.needsCompaction()) compactIndex();
+}
+
 Trade TradeStorage::load(DiskOffset offset) {
     if (offset == 0) return Trade();
     
     DiskOffset rawOff = offset - 1;
     TradeRecord rec;
     storage.read(rawOff, &rec, sizeof(TradeRecord));
+
+    // Reclaimed (or being punched while we read): only the archive has it
+    uint64_t record = rawOff / sizeof(TradeRecord);
+    Trade t;
+    if ((rec.tradeID == 0 || record < reclaimedRecords) && archive.tradeAt(record, t)) return t;
     return Trade::fromRecord(rec);
 }
 
@@ -50,45 +216,54 @@ Trade TradeStorage::loadTrade(int tradeID) {
     return load(offset);
 }
 
-// NEW: Load trades for a specific user
+// Trades for a specific user, oldest first: archive segments that may
+// hold the user, then the unsealed tail of trades.dat
 vector<Trade> TradeStorage::loadTradesForUser(const string& userID) {
-    vector<Trade> allTrades = loadAllTrades();
     vector<Trade> userTrades;
-    
-    for (const Trade& t : allTrades) {
-        if (t.buyUserID == userID || t.sellUserID == userID) {
-            userTrades.push_back(t);
+    uint64_t sealed = archive.tradesForUser(userID, userTrades);
+
+    scanTail(sealed, [&](const TradeRecord& rec) {
+        if (strncmp(rec.buyUserID, userID.c_str(), sizeof(rec.buyUserID)) == 0 ||
+            strncmp(rec.sellUserID, userID.c_str(), sizeof(rec.sellUserID)) == 0) {
+            userTrades.push_back(Trade::fromRecord(rec));
         }
-    }
-    
+    });
     return userTrades;
 }
 
-// NEW: Load trades for a specific symbol
+// Trades for a specific symbol, oldest first
 vector<Trade> TradeStorage::loadTradesForSymbol(const string& symbol) {
-    vector<Trade> allTrades = loadAllTrades();
     vector<Trade> symbolTrades;
-    
-    for (const Trade& t : allTrades) {
-        if (t.symbol == symbol) {
-            symbolTrades.push_back(t);
+    uint64_t sealed = archive.tradesForSymbol(symbol, symbolTrades);
+
+    scanTail(sealed, [&](const TradeRecord& rec) {
+        if (strncmp(rec.symbol, symbol.c_str(), sizeof(rec.symbol)) == 0) {
+            symbolTrades.push_back(Trade::fromRecord(rec));
         }
-    }
-    
+    });
     return symbolTrades;
 }
 
+vector<Trade> TradeStorage::loadTradesBetween(time_t from, time_t to) {
+    vector<Trade> trades;
+    uint64_t sealed = archive.tradesBetween(from, to, trades);
+
+    scanTail(sealed, [&](const TradeRecord& rec) {
+        if (rec.timestamp >= from && rec.timestamp <= to) trades.push_back(Trade::fromRecord(rec));
+    });
+    return trades;
+}
+
+// Every trade in trades.dat order: the archive (whose trades.dat space
+// may be reclaimed), then the unsealed tail
 vector<Trade> TradeStorage::loadAllTrades() {
-    lock_guard<mutex> lock(indexMutex);
-    
     vector<Trade> result;
-    result.reserve(tradeIDToOffsetMap.size());
-    
-    // CHANGED: Load from disk using index
-    for (const auto& [tradeID, offset] : tradeIDToOffsetMap) {
-        result.push_back(load(offset));
-    }
-    
+    result.reserve(getTradeCount());
+
+    uint64_t sealed = archive.allTrades(result);
+    scanTail(sealed, [&](const TradeRecord& rec) {
+        if (rec.tradeID != 0) result.push_back(Trade::fromRecord(rec));
+    });
     return result;
 }
 
@@ -97,74 +272,73 @@ int TradeStorage::getTradeCount() {
     return tradeIDToOffsetMap.size();
 }
 
-// NEW: Load index from file
+// NEW: Load index (snapshot + log) from file
 void TradeStorage::loadIndex() {
-    ifstream indexFile("data/trades.idx", ios::binary);
-    
-    if (!indexFile) {
+    // Same as OrderStorage: skip log entries for records that were lost
+    // with the journal tail
+    size_t end = storage.getFileSize();
+    size_t dangling = 0;
+    DiskOffset indexedEnd = 0;
+    bool ok = indexLog.load([this, end, &dangling, &indexedEnd](const IndexLog::Entry& e) {
+        if (e.offset == 0 || e.offset - 1 + sizeof(TradeRecord) > end) {
+            dangling++;
+            return;
+        }
+        tradeIDToOffsetMap[(int)e.id] = e.offset;
+        indexedEnd = max<DiskOffset>(indexedEnd, e.offset - 1 + sizeof(TradeRecord));
+    });
+
+    if (!ok) {
         cout << "Trade index not found, rebuilding...\n";
         rebuildIndex();
         return;
     }
-    
-    size_t count;
-    indexFile.read(reinterpret_cast<char*>(&count), sizeof(count));
-    
-    for (size_t i = 0; i < count; i++) {
-        int tradeID;
-        indexFile.read(reinterpret_cast<char*>(&tradeID), sizeof(tradeID));
-        
-        DiskOffset offset;
-        indexFile.read(reinterpret_cast<char*>(&offset), sizeof(offset));
-        
-        tradeIDToOffsetMap[tradeID] = offset;
+
+    // Entries the batched log had not written when we crashed: the records
+    // past the last indexed one (trades.dat is append-only)
+    size_t caughtUp = 0;
+    storage.scan(sizeof(TradeRecord), [&](DiskOffset rawOff, const void* p) {
+        const TradeRecord& rec = *static_cast<const TradeRecord*>(p);
+        if (rec.tradeID == 0) return;
+        tradeIDToOffsetMap[rec.tradeID] = rawOff + 1;
+        caughtUp++;
+    }, indexedEnd);
+
+    if (dangling > 0 || caughtUp > 0) {
+        if (dangling > 0)
+            LOG_WARN("TradeStorage: dropped " << dangling << " index entries past the end of trades.dat");
+        if (caughtUp > 0)
+            LOG_WARN("TradeStorage: indexed " << caughtUp << " trades the index log had not written");
+        compactIndex();
     }
-    
-    indexFile.close();
 }
 
-// NEW: Save index to file
-void TradeStorage::saveIndex() {
-    ofstream indexFile("data/trades.idx", ios::binary);
-    if (!indexFile) {
-        cerr << "Failed to save trade index\n";
-        return;
-    }
-    
-    lock_guard<mutex> lock(indexMutex);
-    
-    size_t count = tradeIDToOffsetMap.size();
-    indexFile.write(reinterpret_cast<const char*>(&count), sizeof(count));
-    
+// Fold the log into a fresh snapshot written from memory
+void TradeStorage::compactIndex() {
+    vector<IndexLog::Entry> entries;
+    entries.reserve(tradeIDToOffsetMap.size());
     for (const auto& [tradeID, offset] : tradeIDToOffsetMap) {
-        indexFile.write(reinterpret_cast<const char*>(&tradeID), sizeof(tradeID));
-        indexFile.write(reinterpret_cast<const char*>(&offset), sizeof(offset));
+        IndexLog::Entry e;
+        e.id = tradeID;
+        e.offset = offset;
+        entries.push_back(e);
     }
-    
-    indexFile.close();
+    indexLog.compact(std::move(entries));
 }
 
 // NEW: Rebuild index from data file
 void TradeStorage::rebuildIndex() {
     tradeIDToOffsetMap.clear();
-    
-    const size_t recSize = sizeof(TradeRecord);
-    ifstream f("data/trades.dat", ios::binary | ios::ate);
-    if (!f) return;
-    
-    size_t fileSize = (size_t)f.tellg();
-    f.close();
-    
-    for (size_t rawOff = 0; rawOff + recSize <= fileSize; rawOff += recSize) {
-        TradeRecord rec;
-        storage.read(rawOff, &rec, recSize);
-        
-        Trade t = Trade::fromRecord(rec);
-        DiskOffset storedOff = static_cast<DiskOffset>(rawOff) + 1;
-        
-        tradeIDToOffsetMap[t.tradeID] = storedOff;
-    }
+
+    // Reclaimed records read as zeros in trades.dat; the archive has their IDs
+    archive.forEachTradeID([&](uint64_t record, int tradeID) {
+        tradeIDToOffsetMap[tradeID] = record * sizeof(TradeRecord) + 1;
+    });
+    storage.scan(sizeof(TradeRecord), [&](DiskOffset rawOff, const void* p) {
+        const TradeRecord& rec = *static_cast<const TradeRecord*>(p);
+        if (rec.tradeID != 0) tradeIDToOffsetMap[rec.tradeID] = rawOff + 1;
+    });
     
     cout << "Rebuilt trade index: " << tradeIDToOffsetMap.size() << " trades.\n";
-    saveIndex();
+    compactIndex();
 }
\ No newline at end of file
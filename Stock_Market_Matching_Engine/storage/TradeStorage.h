@@ -4,15 +4,25 @@
 #include "../core/Trade.h"
 #include "StorageManager.h"
 #include "DiskTypes.h"
+#include "IndexLog.h"
+#include "TradeArchive.h"
 #include <unordered_map>
 #include <vector>
 #include <mutex>
+#include <thread>
+#include <chrono>
+#include <atomic>
+#include <condition_variable>
+#include <functional>
 
 using namespace std;
 
 class TradeStorage {
 private:
     StorageManager storage;
+
+    // trades.idx snapshot + trades.idx.log, appended on every persist
+    IndexLog indexLog;
     
     // CHANGED: Only keep index, not full trades
     unordered_map<int, DiskOffset> tradeIDToOffsetMap;  // tradeID -> offset (INDEX ONLY)
@@ -21,6 +31,35 @@ private:
     
     mutable mutex indexMutex;  // NEW: Thread safety
 
+    // Older trades rolled into columnar segments (data/trades.arc). Every
+    // TRADES_PER_SEGMENT records appended to trades.dat wake sealerThread,
+    // which copies them into a new segment off the matching path. Queries
+    // read the archive, then scan only the not yet sealed tail of trades.dat.
+    TradeArchive archive;
+    atomic<uint64_t> recordCount{0};   // TradeRecords in trades.dat
+    mutex sealMutex;
+    condition_variable sealCv;
+    bool stopSealer = false;
+    bool sealFailed = false;   // last archive append failed; retried after SEAL_RETRY
+    thread sealerThread;
+
+    // Sealed records are then given back to the filesystem (punched out of
+    // trades.dat) at journal checkpoints, up to the last whole segment that
+    // an earlier checkpoint already synced: a crash can then cost trades.dat
+    // its tail, but never a record that only the archive still has.
+    // Reading a punched record (all zeros) goes to the archive instead.
+    uint64_t syncedRecords = 0;      // trades.dat records known to be on disk
+    atomic<uint64_t> reclaimedRecords{0};   // records before this are (being) punched out
+    void reclaimSealed();            // checkpoint hook
+
+    static constexpr chrono::seconds SEAL_RETRY{5};
+
+    void sealerLoop();
+    void checkArchive();
+    void recordsAppended(size_t n);
+    // Visit the trades.dat records from position 'from' on
+    void scanTail(uint64_t from, const function<void(const TradeRecord&)>& visit);
+
 public:
     TradeStorage();
     TradeStorage(const TradeStorage&) = delete;
@@ -29,6 +68,9 @@ public:
     
     // Core operations
     DiskOffset persist(const Trade& trade);
+    // Several trades as one contiguous append (one journal entry, one
+    // index log write)
+    void persistBatch(const vector<Trade>& trades);
     Trade load(DiskOffset offset);
     
     // Lookup operations
@@ -38,14 +80,21 @@ public:
     Trade loadTrade(int tradeID);
     vector<Trade> loadTradesForUser(const string& userID);
     vector<Trade> loadTradesForSymbol(const string& symbol);
+    // Trades with from <= timestamp <= to
+    vector<Trade> loadTradesBetween(time_t from, time_t to);
     
     vector<Trade> loadAllTrades();
     int getTradeCount();
+
+    // Blocks until every full segment's worth of trades is sealed, or
+    // returns false once sealing has failed
+    bool sealPending();
+    const TradeArchive& getArchive() const { return archive; }
     
 private:
     // NEW: Index management
     void loadIndex();
-    void saveIndex();
+    void compactIndex();   // caller holds indexMutex (or is the constructor)
     void rebuildIndex();
 };
 
@@ -1,60 +1,446 @@
 #include "UserStorage.h"
-#include <fstream>
+#include "Journal.h"
 #include <iostream>
+#include <fstream>
+#include <algorithm>
+#include <cstring>
+#include <cstdio>
+#include "../core/Intern.h"
+#include "../core/Log.h"
+
+namespace {
+
+const size_t SLOT = sizeof(UserSlot);
+const size_t SLOT_PAYLOAD = sizeof(UserSlot::payload);
+
+size_t slotsFor(size_t payloadSize) {
+    return max<size_t>(1, (payloadSize + SLOT_PAYLOAD - 1) / SLOT_PAYLOAD);
+}
+
+}
+
+UserStorage::UserStorage()
+    : migrating(moveLegacyAside("data/users.dat")),
+      storage("data/users.dat", StorageMode::MAPPED, sizeof(UserSlot)),
+      indexLog("data/users.idx"),
+      bytesWritten(0),
+      changeLog("data/users.log", StorageMode::MAPPED, sizeof(UserChange)),
+      changeSeq(0), changeEnd(0), appliedSeq(0) {
+    // Holdings are stored by symbol key, so the symbol table has to be
+    // on disk too. User keys (see Intern.h) are kept in data/users.intern;
+    // anyone in the index but not in that file gets a key now, in sorted
+    // order.
+    attachInternTables();
+
+    bool fresh = storage.getFileSize() == 0;
+
+    // Applied mark (older headers don't have one) and the last change
+    // logged. A new users.dat has no users for a leftover users.log.
+    UserSlot header;
+    storage.read(0, &header, sizeof(header));
+    if (header.used >= HEADER_BYTES) memcpy(&appliedSeq, header.payload + 8, sizeof(appliedSeq));
+    changeSeq = appliedSeq;
+    walkChanges([this](const UserChange& c) { changeSeq = max(changeSeq, c.seq); });
+    if (fresh) {
+        appliedSeq = changeSeq;
+        writeHeader(appliedSeq);
+    }
 
-UserStorage::UserStorage() : storage("data/users.dat") {
     // CHANGED: Only load the index, not full user objects
     loadIndex();
+
+    if (migrating) {
+        size_t moved = migrateLegacy("data/users.dat.v1");
+        cout << "Migrated " << moved << " users from the old users.dat (kept as users.dat.v1).\n";
+    }
+
+    vector<string> known;
+    known.reserve(userIDToOffsetMap.size());
+    for (const auto& [userID, offset] : userIDToOffsetMap) known.push_back(userID);
+    sort(known.begin(), known.end());
+    for (const string& userID : known) userTable().intern(userID);
     cout << "Loaded user index: " << userIDToOffsetMap.size() << " users.\n";
+
+    size_t replayed = replayChanges();
+    if (replayed > 0) cout << "Replayed " << replayed << " user changes from users.log.\n";
 }
 
 UserStorage::~UserStorage() {
-    // NEW: Save index on shutdown
-    saveIndex();
+    // Nothing to save: persist() already appended to users.idx.log
+}
+
+// Runs before storage opens users.dat. If the file is there but is not
+// the slot format, rename it out of the way (its index goes with it) so
+// storage starts a fresh file and the constructor migrates the old one.
+bool UserStorage::moveLegacyAside(const string& path) {
+    // Replay whatever the journal holds for the old file first
+    Journal::instance();
+
+    ifstream in(path, ios::binary);
+    if (!in.is_open()) return false;
+    UserSlot first;
+    memset(&first, 0, sizeof(first));
+    in.read(reinterpret_cast<char*>(&first), sizeof(first));
+    size_t got = in.gcount();
+    in.close();
+    if (got == 0) return false;
+
+    uint32_t magic = 0;
+    memcpy(&magic, first.payload, sizeof(magic));
+    if (got == sizeof(first) && first.kind == USER_SLOT_FILE && magic == FILE_MAGIC) return false;
+
+    string old = path + ".v1";
+    if (rename(path.c_str(), old.c_str()) != 0) {
+        LOG_ERROR("UserStorage: cannot move old " << path << " aside, leaving it alone");
+        return false;
+    }
+    remove("data/users.idx");
+    remove("data/users.idx.log");
+    return true;
+}
+
+// Read every UserRecord of the old file and store it in the new format.
+// A user written twice (older builds could) keeps its last record.
+size_t UserStorage::migrateLegacy(const string& path) {
+    ifstream in(path, ios::binary);
+    if (!in.is_open()) return 0;
+
+    vector<string> order;
+    unordered_map<string, User> latest;
+    UserRecord rec;
+    while (in.read(reinterpret_cast<char*>(&rec), sizeof(rec))) {
+        rec.userID[sizeof(rec.userID) - 1] = '\0';
+        if (rec.userID[0] == '\0') continue;   // zeroed tail of a crashed file
+        User user = User::fromRecord(rec);
+        if (latest.find(user.getUserID()) == latest.end()) order.push_back(user.getUserID());
+        latest[user.getUserID()] = user;
+    }
+
+    size_t moved = 0;
+    for (const string& userID : order) {
+        if (userExists(userID)) continue;
+        persist(latest[userID]);
+        moved++;
+    }
+    return moved;
+}
+
+// Slot 0: magic, version, then the applied change mark
+void UserStorage::writeHeader(uint64_t applied) {
+    UserSlot header;
+    memset(&header, 0, sizeof(header));
+    header.kind = USER_SLOT_FILE;
+    header.used = HEADER_BYTES;
+    uint32_t words[2] = {FILE_MAGIC, FILE_VERSION};
+    memcpy(header.payload, words, sizeof(words));
+    memcpy(header.payload + sizeof(words), &applied, sizeof(applied));
+    if (storage.getFileSize() == 0) {
+        storage.append(&header, sizeof(header));
+    } else {
+        storage.write(0, &header, sizeof(header));
+    }
+}
+
+// Gather a user's payload by walking its chain from the head slot. The
+// walk is bounded by the slot count so a damaged link cannot loop.
+bool UserStorage::readChain(DiskOffset offset, vector<char>& payload, vector<uint32_t>* slots) {
+    payload.clear();
+    if (slots) slots->clear();
+    if (offset == 0) return false;
+
+    size_t total = storage.getFileSize() / SLOT;
+    uint32_t s = (uint32_t)((offset - 1) / SLOT);
+    for (size_t steps = 0; steps < total; steps++) {
+        if (s == 0 || s >= total) return false;
+        UserSlot slot;
+        storage.read((DiskOffset)s * SLOT, &slot, sizeof(slot));
+        if (slot.kind != (steps == 0 ? USER_SLOT_HEAD : USER_SLOT_OVERFLOW)) return false;
+        if (slot.used > SLOT_PAYLOAD) return false;
+
+        payload.insert(payload.end(), slot.payload, slot.payload + slot.used);
+        if (slots) slots->push_back(s);
+        if (slot.next == 0) return true;
+        s = slot.next;
+    }
+    return false;
+}
+
+// New chain at the end of the file: the head and its overflow slots go
+// out together, linked in order, as one append. firstKind is OVERFLOW
+// when the chain extends an existing user's.
+DiskOffset UserStorage::appendChain(const vector<char>& payload, UserSlotKind firstKind) {
+    size_t n = slotsFor(payload.size());
+    vector<UserSlot> slots(n);
+    memset(slots.data(), 0, n * SLOT);
+
+    uint32_t first = (uint32_t)(storage.getFileSize() / SLOT);
+    for (size_t i = 0; i < n; i++) {
+        size_t from = i * SLOT_PAYLOAD;
+        size_t len = min(SLOT_PAYLOAD, payload.size() - min(from, payload.size()));
+        slots[i].kind = i == 0 ? firstKind : USER_SLOT_OVERFLOW;
+        slots[i].used = (uint16_t)len;
+        slots[i].next = i + 1 < n ? first + (uint32_t)(i + 1) : 0;
+        if (len > 0) memcpy(slots[i].payload, payload.data() + from, len);
+    }
+
+    DiskOffset rawOff = storage.append(slots.data(), n * SLOT);
+    bytesWritten += n * SLOT;
+    if (rawOff != (DiskOffset)first * SLOT) {
+        // Someone else appended in between; fix the links for where it landed
+        uint32_t at = (uint32_t)(rawOff / SLOT);
+        for (size_t i = 0; i + 1 < n; i++) slots[i].next = at + (uint32_t)(i + 1);
+        storage.write(rawOff, slots.data(), n * SLOT);
+        bytesWritten += n * SLOT;
+    }
+    return rawOff;
+}
+
+// Write only the bytes of one slot that differ, merging runs separated by
+// less than MERGE_GAP unchanged bytes into a single write
+void UserStorage::writeSlotDiff(uint32_t slot, const UserSlot& current, const UserSlot& wanted) {
+    const char* cur = reinterpret_cast<const char*>(&current);
+    const char* want = reinterpret_cast<const char*>(&wanted);
+    DiskOffset base = (DiskOffset)slot * SLOT;
+
+    size_t i = 0;
+    while (i < SLOT) {
+        if (cur[i] == want[i]) { i++; continue; }
+        size_t start = i, end = i + 1, same = 0;
+        for (size_t j = end; j < SLOT && same < MERGE_GAP; j++) {
+            if (cur[j] != want[j]) {
+                end = j + 1;
+                same = 0;
+            } else {
+                same++;
+            }
+        }
+        storage.write(base + start, want + start, end - start);
+        bytesWritten += end - start;
+        i = end;
+    }
+}
+
+// Lay payload over the chain starting at offset. Existing slots are
+// diffed in place; extra slots are appended first and then linked from
+// the old tail, so a crash in between only leaves an unreachable chain.
+// Slots the payload no longer needs stay in the chain with used = 0.
+void UserStorage::writeChain(DiskOffset offset, const vector<char>& payload) {
+    vector<char> old;
+    vector<uint32_t> chain;
+    if (!readChain(offset, old, &chain)) {
+        LOG_ERROR("UserStorage: broken slot chain at offset " << offset << ", user not saved");
+        return;
+    }
+
+    size_t needed = slotsFor(payload.size());
+    uint32_t extra = 0;
+    if (needed > chain.size()) {
+        size_t from = chain.size() * SLOT_PAYLOAD;
+        vector<char> rest(payload.begin() + from, payload.end());
+        extra = (uint32_t)(appendChain(rest, USER_SLOT_OVERFLOW) / SLOT);
+    }
+
+    for (size_t i = 0; i < chain.size(); i++) {
+        UserSlot current;
+        storage.read((DiskOffset)chain[i] * SLOT, &current, sizeof(current));
+
+        // Start from what is there so stale bytes past 'used' are not rewritten
+        UserSlot wanted = current;
+        size_t from = i * SLOT_PAYLOAD;
+        size_t len = from < payload.size() ? min(SLOT_PAYLOAD, payload.size() - from) : 0;
+        wanted.used = (uint16_t)len;
+        if (len > 0) memcpy(wanted.payload, payload.data() + from, len);
+        if (i + 1 == chain.size() && extra != 0) wanted.next = extra;
+
+        writeSlotDiff(chain[i], current, wanted);
+    }
 }
 
 // Persist a new user
 DiskOffset UserStorage::persist(const User& user) {
+    vector<char> payload;
+    user.toCompact(payload);
+
     lock_guard<mutex> lock(indexMutex);
-    
-    UserRecord rec = user.toRecord();
-    DiskOffset rawOff = storage.append(&rec, sizeof(UserRecord));
+
+    DiskOffset rawOff = appendChain(payload);
     DiskOffset storedOff = rawOff + 1;
-    
+
     // CHANGED: Only update index, don't store full user in memory
     userIDToOffsetMap[user.getUserID()] = storedOff;
-    
+    userTable().intern(user.getUserID());
+
+    IndexLog::Entry e;
+    e.name = user.getUserID();
+    e.offset = storedOff;
+    indexLog.append(e);
+    indexLog.flush();   // new users are rare; users.dat can't re-index a lost entry
+    if (indexLog.needsCompaction()) compactIndex();
+
     return storedOff;
 }
 
 // Load user from offset
 User UserStorage::load(DiskOffset offset) {
+    lock_guard<mutex> lock(indexMutex);
+    return loadLocked(offset);
+}
+
+User UserStorage::loadLocked(DiskOffset offset) {
     if (offset == 0) return User(); // invalid
-    
-    DiskOffset rawOff = offset - 1;
-    UserRecord rec;
-    storage.read(rawOff, &rec, sizeof(UserRecord));
-    return User::fromRecord(rec);
+
+    vector<char> payload;
+    User user;
+    if (!readChain(offset, payload) || !User::fromCompact(payload.data(), payload.size(), user)) {
+        LOG_ERROR("UserStorage: unreadable user at offset " << offset);
+        return User();
+    }
+    return user;
 }
 
 // Save user back to disk (update)
 void UserStorage::save(const User& user, DiskOffset offset) {
     if (offset == 0) return;
-    
+
+    vector<char> payload;
+    user.toCompact(payload);
+
     lock_guard<mutex> lock(indexMutex);
-    
-    DiskOffset rawOff = offset - 1;
-    UserRecord rec = user.toRecord();
-    storage.write(rawOff, &rec, sizeof(UserRecord));
-    
-    // REMOVED: Don't update usersMap - it doesn't exist anymore
-    // Data is on disk, cache handles memory copies
+    writeChain(offset, payload);
+}
+
+bool UserStorage::saveCompact(const vector<char>& payload) {
+    if (payload.size() < 2 || payload.size() < 2 + (size_t)(uint8_t)payload[1]) return false;
+    string userID(payload.data() + 2, (uint8_t)payload[1]);
+
+    lock_guard<mutex> lock(indexMutex);
+    auto it = userIDToOffsetMap.find(userID);
+    if (it == userIDToOffsetMap.end()) {
+        LOG_ERROR("UserStorage: saveCompact for unknown user " << userID);
+        return false;
+    }
+    writeChain(it->second, payload);
+    return true;
+}
+
+// Visit the run of changes from offset 0 whose sequence numbers follow
+// each other; returns where the run ends. Anything after it is left over
+// from before the log last started over (or zeros).
+DiskOffset UserStorage::walkChanges(const function<void(const UserChange&)>& visit) {
+    uint64_t last = 0;
+    DiskOffset end = 0;
+    bool inRun = true;
+    changeLog.scan(sizeof(UserChange), [&](DiskOffset off, const void* p) {
+        if (!inRun) return;
+        UserChange c;
+        memcpy(&c, p, sizeof(c));
+        if (c.seq == 0 || (last != 0 && c.seq != last + 1)) {
+            inRun = false;
+            return;
+        }
+        visit(c);
+        last = c.seq;
+        end = off + sizeof(c);
+    });
+    return end;
+}
+
+// Bring the stored users up to the last logged change: the engine had
+// them in memory but had not flushed them yet. Each user touched is saved
+// once, then the mark moves. Changes set values rather than add to them,
+// so a crash in here just means doing it again.
+size_t UserStorage::replayChanges() {
+    unordered_map<uint32_t, pair<DiskOffset, User>> touched;
+    size_t replayed = 0, unknown = 0;
+    walkChanges([&](const UserChange& c) {
+        if (c.seq <= appliedSeq) return;
+        auto it = touched.find(c.userKey);
+        if (it == touched.end()) {
+            auto off = userIDToOffsetMap.find(userTable().name(c.userKey));
+            if (c.userKey == 0 || off == userIDToOffsetMap.end()) {
+                unknown++;
+                return;
+            }
+            User stored = loadLocked(off->second);
+            if (stored.getUserID().empty()) {
+                unknown++;
+                return;
+            }
+            it = touched.emplace(c.userKey, make_pair(off->second, stored)).first;
+        }
+        User& user = it->second.second;
+        user.addCash(c.cash - user.getCash());
+        if (c.symbolKey != 0) {
+            int have = user.getStockQuantity(c.symbolKey);
+            if (c.shares > have) user.addStock(c.symbolKey, c.shares - have);
+            else if (c.shares < have) user.removeStock(c.symbolKey, have - c.shares);
+        }
+        replayed++;
+    });
+    if (unknown > 0) LOG_WARN("UserStorage: skipped " << unknown << " changes in users.log for unknown users");
+
+    vector<char> payload;
+    for (const auto& [key, entry] : touched) {
+        entry.second.toCompact(payload);
+        writeChain(entry.first, payload);
+    }
+    if (changeSeq > appliedSeq) {
+        appliedSeq = changeSeq;
+        writeHeader(appliedSeq);
+    }
+    return replayed;
+}
+
+uint64_t UserStorage::logChange(uint32_t userKey, const User& user, uint32_t symbolKey) {
+    UserChange c;
+    memset(&c, 0, sizeof(c));
+    c.userKey = userKey;
+    c.symbolKey = symbolKey;
+    c.cash = user.getCash();
+    c.shares = symbolKey != 0 ? user.getStockQuantity(symbolKey) : 0;
+
+    lock_guard<mutex> lock(changeMutex);
+    c.seq = ++changeSeq;
+    {
+        // Same as write(), minus the commit wait
+        auto ck = changeLog.holdCheckpoint();
+        changeLog.logWrite(changeEnd, &c, sizeof(c));
+        changeLog.applyWrite(changeEnd, &c, sizeof(c));
+    }
+    changeEnd += sizeof(c);
+    return c.seq;
+}
+
+uint64_t UserStorage::getChangeSeq() const {
+    lock_guard<mutex> lock(changeMutex);
+    return changeSeq;
+}
+
+void UserStorage::markApplied(uint64_t seq) {
+    lock_guard<mutex> lock(changeMutex);
+    if (seq > appliedSeq) {
+        appliedSeq = seq;
+        writeHeader(seq);
+    }
+    // Nothing logged since: the mark is in the journal ahead of whatever
+    // gets logged next, so the log can start over
+    if (seq == changeSeq) changeEnd = 0;
+}
+
+bool UserStorage::changeLogFull() const {
+    lock_guard<mutex> lock(changeMutex);
+    return changeEnd >= CHANGE_LOG_BYTES;
+}
+
+uint64_t UserStorage::getBytesWritten() const {
+    lock_guard<mutex> lock(indexMutex);
+    return bytesWritten;
 }
 
 // Get offset for a userID
 DiskOffset UserStorage::getOffsetForUser(const string& userID) {
     lock_guard<mutex> lock(indexMutex);
-    
+
     auto it = userIDToOffsetMap.find(userID);
     if (it == userIDToOffsetMap.end()) return 0;
     return it->second;
@@ -78,15 +464,15 @@ bool UserStorage::userExists(const string& userID) {
 // Load all users (reads from disk)
 vector<User> UserStorage::loadAllUsers() {
     lock_guard<mutex> lock(indexMutex);
-    
+
     vector<User> result;
     result.reserve(userIDToOffsetMap.size());
-    
+
     // CHANGED: Load from disk using index
     for (const auto& [userID, offset] : userIDToOffsetMap) {
-        result.push_back(load(offset));
+        result.push_back(loadLocked(offset));
     }
-    
+
     return result;
 }
 
@@ -101,114 +487,68 @@ void UserStorage::updateUser(const User& user) {
 }
 
 void UserStorage::loadIndex() {
-    ifstream indexFile("data/users.idx", ios::binary);
-    
-    if (!indexFile) {
+    // Same as OrderStorage: skip log entries whose head slot was lost
+    // with the journal tail
+    size_t end = storage.getFileSize();
+    size_t dangling = 0;
+    bool ok = indexLog.load([this, end, &dangling](const IndexLog::Entry& e) {
+        if (e.offset == 0 || e.offset - 1 + sizeof(UserSlot) > end) {
+            dangling++;
+            return;
+        }
+        userIDToOffsetMap[e.name] = e.offset;
+    });
+
+    if (!ok) {
         cout << "User index not found, rebuilding...\n";
         rebuildIndex();
-        return;
-    }
-    
-    // ✅ ADD: Check file size
-    indexFile.seekg(0, ios::end);
-    size_t fileSize = indexFile.tellg();
-    indexFile.seekg(0, ios::beg);
-    
-    if (fileSize < sizeof(size_t)) {
-        cout << "User index corrupted, rebuilding...\n";
-        indexFile.close();
-        rebuildIndex();
-        return;
-    }
-    
-    size_t count;
-    indexFile.read(reinterpret_cast<char*>(&count), sizeof(count));
-    
-    // ✅ ADD: Sanity check
-    if (count > 1000000) {
-        cout << "User index has invalid count, rebuilding...\n";
-        indexFile.close();
-        rebuildIndex();
-        return;
+    } else if (dangling > 0) {
+        LOG_WARN("UserStorage: dropped " << dangling << " index entries past the end of users.dat");
+        compactIndex();
     }
-    
-    for (size_t i = 0; i < count; i++) {
-        size_t idLen;
-        indexFile.read(reinterpret_cast<char*>(&idLen), sizeof(idLen));
-        
-        // ✅ ADD: Validate length
-        if (idLen > 100) {
-            cout << "Invalid userID length, rebuilding...\n";
-            indexFile.close();
-            rebuildIndex();
-            return;
-        }
-        
-        string userID(idLen, '\0');
-        indexFile.read(&userID[0], idLen);
-        
-        DiskOffset offset;
-        indexFile.read(reinterpret_cast<char*>(&offset), sizeof(offset));
-        
-        userIDToOffsetMap[userID] = offset;
-    }
-    
-    indexFile.close();
-    cout << "Loaded user index: " << userIDToOffsetMap.size() << " users.\n";
 }
 
-// NEW: Save index to file
-void UserStorage::saveIndex() {
-    ofstream indexFile("data/users.idx", ios::binary);
-    if (!indexFile) {
-        cerr << "Failed to save user index\n";
-        return;
-    }
-    
-    lock_guard<mutex> lock(indexMutex);
-    
-    size_t count = userIDToOffsetMap.size();
-    indexFile.write(reinterpret_cast<const char*>(&count), sizeof(count));
-    
+// Fold the log into a fresh snapshot written from memory
+void UserStorage::compactIndex() {
+    vector<IndexLog::Entry> entries;
+    entries.reserve(userIDToOffsetMap.size());
     for (const auto& [userID, offset] : userIDToOffsetMap) {
-        // Write userID length
-        size_t idLen = userID.size();
-        indexFile.write(reinterpret_cast<const char*>(&idLen), sizeof(idLen));
-        
-        // Write userID
-        indexFile.write(userID.c_str(), idLen);
-        
-        // Write offset
-        indexFile.write(reinterpret_cast<const char*>(&offset), sizeof(offset));
+        IndexLog::Entry e;
+        e.name = userID;
+        e.offset = offset;
+        entries.push_back(e);
     }
-    
-    indexFile.close();
+    indexLog.compact(std::move(entries));
 }
 
 // NEW: Rebuild index from data file
 void UserStorage::rebuildIndex() {
     userIDToOffsetMap.clear();
-    
-    const size_t recSize = sizeof(UserRecord);
-    ifstream f("data/users.dat", ios::binary | ios::ate);
-    if (!f) return;
-    
-    size_t fileSize = (size_t)f.tellg();
-    f.close();
-    
-    // Scan through file and build index
-    for (size_t rawOff = 0; rawOff + recSize <= fileSize; rawOff += recSize) {
-        UserRecord rec;
-        storage.read(rawOff, &rec, recSize);
-        
-        User u = User::fromRecord(rec);
-        DiskOffset storedOff = static_cast<DiskOffset>(rawOff) + 1;
-        
-        userIDToOffsetMap[u.getUserID()] = storedOff;
-    }
-    
+
+    // Scan the head slots; an ID too long for its head slot is read
+    // through the chain once the scan is done
+    vector<DiskOffset> spilled;
+    storage.scan(SLOT, [&](DiskOffset rawOff, const void* p) {
+        const UserSlot& slot = *static_cast<const UserSlot*>(p);
+        if (slot.kind != USER_SLOT_HEAD || slot.used < 2) return;
+        size_t idLen = (uint8_t)slot.payload[1];
+        if (2 + idLen <= slot.used) {
+            userIDToOffsetMap[string(slot.payload + 2, idLen)] = rawOff + 1;
+        } else {
+            spilled.push_back(rawOff + 1);
+        }
+    });
+
+    vector<char> payload;
+    for (DiskOffset offset : spilled) {
+        if (!readChain(offset, payload) || payload.size() < 2) continue;
+        size_t idLen = (uint8_t)payload[1];
+        if (2 + idLen > payload.size()) continue;
+        userIDToOffsetMap[string(payload.data() + 2, idLen)] = offset;
+    }
+
     cout << "Rebuilt user index: " << userIDToOffsetMap.size() << " users.\n";
-    
+
     // Save the rebuilt index
-    saveIndex();
-}
\ No newline at end of file
+    compactIndex();
+}
@@ -4,16 +4,80 @@
 #include "../core/User.h"
 #include "StorageManager.h"
 #include "DiskTypes.h"
+#include "IndexLog.h"
 #include <unordered_map>
 #include <string>
 #include <vector>
 #include <mutex>
+#include <functional>
 
 using namespace std;
 
+// data/users.dat, format v2: an array of 64-byte slots. Slot 0 is the file
+// header; every user is a chain of slots (a head slot, then overflow slots
+// for large portfolios) holding the user's compact payload
+// (User::toCompact). A user with a handful of holdings fits in one slot.
+//
+// save() diffs the new payload against what is on disk and writes only the
+// byte runs that changed, so a balance change is one small write rather
+// than a whole record. Chains grow by appending slots and never shrink;
+// unused tail slots just carry used = 0.
+//
+// The old fixed-size UserRecord file is migrated on first open and kept
+// as users.dat.v1.
+//
+// The engine only writes a user every flush interval, so each cash or
+// share change is also logged right away as a UserChange in
+// data/users.log, in the same journal stream as the order and trade
+// writes that follow it. A change carries the balances after it, not the
+// amount, so replaying one twice does no harm. Each flush records the
+// last change its users include (the applied mark, in the header slot);
+// on open, changes after the mark are applied to the stored users. Once a
+// flush covers every change the log starts over from offset 0; sequence
+// numbers keep counting, so a replay stops at the first record that does
+// not follow the one before it.
+struct UserSlot {
+    uint32_t next;      // next slot of the chain (slot index), 0 = last
+    uint16_t used;      // payload bytes in this slot
+    uint8_t kind;       // USER_SLOT_*
+    uint8_t reserved;
+    char payload[56];
+};
+static_assert(sizeof(UserSlot) == 64, "UserSlot is one 64-byte slot");
+
+struct UserChange {
+    uint64_t seq;
+    uint32_t userKey;     // userTable() key
+    uint32_t symbolKey;   // symbolTable() key of the holding, 0 = cash only
+    int64_t cash;         // cash balance after the change (Money)
+    int32_t shares;       // quantity of symbolKey after the change
+    uint32_t reserved;
+};
+static_assert(sizeof(UserChange) == 32, "UserChange is 32 bytes");
+
+enum UserSlotKind : uint8_t {
+    USER_SLOT_FILE = 0x46,      // slot 0
+    USER_SLOT_HEAD = 0x48,
+    USER_SLOT_OVERFLOW = 0x4F
+};
+
 class UserStorage {
 private:
+    static constexpr uint32_t FILE_MAGIC = 0x32525355;   // "USR2"
+    static constexpr uint32_t FILE_VERSION = 2;
+    static constexpr size_t MERGE_GAP = 16;   // changed runs closer than this go out as one write
+    static constexpr size_t CHANGE_LOG_BYTES = 1u << 20;   // see changeLogFull()
+    static constexpr uint16_t HEADER_BYTES = 16;   // header slot payload
+
+    // Set before storage opens the file: an old-format users.dat was
+    // moved aside to users.dat.v1 and gets migrated in the constructor
+    bool migrating;
+    static bool moveLegacyAside(const string& path);
+
     StorageManager storage;
+
+    // users.idx snapshot + users.idx.log, appended when a user is created
+    IndexLog indexLog;
     
     // CHANGED: Only keep index in memory, not full user objects
     unordered_map<string, DiskOffset> userIDToOffsetMap;  // username -> offset (INDEX ONLY)
@@ -23,6 +87,27 @@ private:
     
     mutable mutex indexMutex;  // NEW: Thread safety for index
 
+    // Bytes handed to storage by persist/save, for measuring write volume
+    uint64_t bytesWritten;
+
+    // data/users.log, guarded by changeMutex
+    StorageManager changeLog;
+    mutable mutex changeMutex;
+    uint64_t changeSeq;       // last change logged
+    DiskOffset changeEnd;     // where the next one goes
+    uint64_t appliedSeq;      // last change the stored users include
+
+    // Slot chain access; callers hold indexMutex (or are the constructor)
+    bool readChain(DiskOffset offset, vector<char>& payload, vector<uint32_t>* slots = nullptr);
+    DiskOffset appendChain(const vector<char>& payload, UserSlotKind firstKind = USER_SLOT_HEAD);
+    void writeChain(DiskOffset offset, const vector<char>& payload);
+    void writeSlotDiff(uint32_t slot, const UserSlot& current, const UserSlot& wanted);
+    void writeHeader(uint64_t applied);
+    DiskOffset walkChanges(const function<void(const UserChange&)>& visit);
+    size_t replayChanges();
+    User loadLocked(DiskOffset offset);
+    size_t migrateLegacy(const string& path);
+
 public:
     UserStorage();
     UserStorage(const UserStorage&) = delete;
@@ -33,6 +118,9 @@ public:
     DiskOffset persist(const User& user);
     User load(DiskOffset offset);
     void save(const User& user, DiskOffset offset);
+    // Write an already encoded payload (User::toCompact) over the user's
+    // stored one, found by the ID inside it; false if never persisted
+    bool saveCompact(const vector<char>& payload);
     
     // Lookup operations
     DiskOffset getOffsetForUser(const string& userID);
@@ -47,11 +135,26 @@ public:
     
     // Quick update operations
     void updateUser(const User& user);
+
+    // Change log (see above). logChange is called with the change already
+    // made to user and does not wait for the journal commit, so callers
+    // can hold their own locks; the durable-mode user flush that follows
+    // is logged after it and does wait. markApplied(seq) is called once
+    // every change up to getChangeSeq() == seq is saved.
+    uint64_t logChange(uint32_t userKey, const User& user, uint32_t symbolKey = 0);
+    uint64_t getChangeSeq() const;
+    void markApplied(uint64_t seq);
+    // The log can only start over once a flush covers all of it; past
+    // CHANGE_LOG_BYTES the engine flushes with its users locked so one does
+    bool changeLogFull() const;
+
+    uint64_t getBytesWritten() const;
+    size_t getFileSize() { return storage.getFileSize(); }
     
 private:
     // NEW: Index management
     void loadIndex();
-    void saveIndex();
+    void compactIndex();   // caller holds indexMutex (or is the constructor)
     void rebuildIndex();
 };
 
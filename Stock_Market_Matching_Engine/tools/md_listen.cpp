@@ -0,0 +1,179 @@
+#include <iostream>
+#include <iomanip>
+#include <string>
+#include <map>
+#include <chrono>
+#include <cstring>
+#include <cstdlib>
+#include <functional>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include "../engine/MarketDataPublisher.h"
+
+using namespace std;
+
+/* ============== MARKET DATA LISTENER ==============
+   Connects to a MarketDataPublisher socket, rebuilds
+   each symbol's depth from the snapshot + incremental
+   stream and prints the top levels once a second.
+   Also a reference for writing a subscriber:
+     - start from a snapshot, skip events with seq at
+       or below the snapshot's seq
+     - LEVEL carries new totals; 0 orders = level gone
+     - CLEAR wipes the symbol, levels follow
+   ================================================== */
+
+struct Level {
+    int64_t quantity;
+    int32_t orders;
+};
+
+struct Book {
+    map<Price, Level, greater<Price>> bids;
+    map<Price, Level> asks;
+    Price lastPrice = 0;
+    int64_t lastQty = 0;
+    uint64_t trades = 0;
+};
+
+struct ListenConfig {
+    string socketPath = "data/marketdata.sock";
+    int depth = 5;
+    bool printTrades = false;
+};
+
+static void usage() {
+    cout << "\nUsage:\n";
+    cout << "  ./md_listen [--socket data/marketdata.sock] [--depth N] [--trades]\n";
+}
+
+static void setLevel(Book& book, const MarketDataMessage& m) {
+    bool gone = m.orders <= 0 || m.quantity <= 0;
+    if (m.side) {
+        if (gone) book.bids.erase(m.price);
+        else book.bids[m.price] = Level{m.quantity, m.orders};
+    } else {
+        if (gone) book.asks.erase(m.price);
+        else book.asks[m.price] = Level{m.quantity, m.orders};
+    }
+}
+
+static void printBooks(const map<string, Book>& books, int depth, uint64_t seq) {
+    cout << "---- seq " << seq << " ----\n";
+    for (const auto& [sym, book] : books) {
+        cout << sym << "  last " << fixed << setprecision(2) << toDouble(book.lastPrice)
+             << " x " << book.lastQty << "  (" << book.trades << " trades)\n";
+        auto bid = book.bids.begin();
+        auto ask = book.asks.begin();
+        for (int i = 0; i < depth && (bid != book.bids.end() || ask != book.asks.end()); i++) {
+            if (bid != book.bids.end()) {
+                cout << "  " << setw(8) << bid->second.quantity << " (" << setw(3) << bid->second.orders
+                     << ") " << setw(10) << toDouble(bid->first);
+                ++bid;
+            } else {
+                cout << string(30, ' ');
+            }
+            cout << "  |  ";
+            if (ask != book.asks.end()) {
+                cout << setw(10) << toDouble(ask->first) << " " << setw(8) << ask->second.quantity
+                     << " (" << setw(3) << ask->second.orders << ")";
+                ++ask;
+            }
+            cout << "\n";
+        }
+    }
+}
+
+int main(int argc, char* argv[]) {
+    ListenConfig cfg;
+    for (int i = 1; i < argc; i++) {
+        string a = argv[i];
+        if (a == "--socket" && i + 1 < argc) cfg.socketPath = argv[++i];
+        else if (a == "--depth" && i + 1 < argc) cfg.depth = atoi(argv[++i]);
+        else if (a == "--trades") cfg.printTrades = true;
+        else { usage(); return 1; }
+    }
+
+    int fd = ::socket(AF_UNIX, SOCK_STREAM, 0);
+    sockaddr_un addr{};
+    addr.sun_family = AF_UNIX;
+    strncpy(addr.sun_path, cfg.socketPath.c_str(), sizeof(addr.sun_path) - 1);
+    if (fd < 0 || ::connect(fd, (sockaddr*)&addr, sizeof(addr)) != 0) {
+        cout << "Cannot connect to " << cfg.socketPath << "\n";
+        return 1;
+    }
+
+    map<string, Book> books;
+    uint64_t seq = 0;           // last applied incremental event
+    bool synced = false;        // seen a full snapshot yet
+    char buf[sizeof(MarketDataMessage) * 256];
+    size_t have = 0;
+    auto nextPrint = chrono::steady_clock::now();
+
+    while (true) {
+        ssize_t n = ::read(fd, buf + have, sizeof(buf) - have);
+        if (n <= 0) break;
+        have += n;
+
+        size_t pos = 0;
+        for (; pos + sizeof(MarketDataMessage) <= have; pos += sizeof(MarketDataMessage)) {
+            MarketDataMessage m;
+            memcpy(&m, buf + pos, sizeof(m));
+            string sym(m.symbol, strnlen(m.symbol, sizeof(m.symbol)));
+
+            switch (m.type) {
+            case MarketDataEvent::SNAPSHOT_BEGIN:
+                books[sym].bids.clear();
+                books[sym].asks.clear();
+                break;
+            case MarketDataEvent::SNAPSHOT_LEVEL:
+                setLevel(books[sym], m);
+                break;
+            case MarketDataEvent::SNAPSHOT_END:
+                seq = m.seq;
+                synced = true;
+                break;
+            default:
+                if (!synced || m.seq <= seq) break;   // already in our snapshot
+                if (m.seq != seq + 1) {
+                    cout << "Gap: expected seq " << seq + 1 << ", got " << m.seq << "\n";
+                }
+                seq = m.seq;
+
+                if (m.type == MarketDataEvent::LEVEL) {
+                    setLevel(books[sym], m);
+                } else if (m.type == MarketDataEvent::CLEAR) {
+                    books[sym].bids.clear();
+                    books[sym].asks.clear();
+                } else if (m.type == MarketDataEvent::TRADE) {
+                    Book& b = books[sym];
+                    b.lastPrice = m.price;
+                    b.lastQty = m.quantity;
+                    b.trades++;
+                    if (cfg.printTrades) {
+                        cout << "TRADE " << sym << " " << (m.side ? "BUY " : "SELL ") << m.quantity
+                             << " @ " << fixed << setprecision(2) << toDouble(m.price) << "\n";
+                    }
+                }
+                break;
+            }
+        }
+        memmove(buf, buf + pos, have - pos);
+        have -= pos;
+
+        auto now = chrono::steady_clock::now();
+        if (synced && now >= nextPrint) {
+            printBooks(books, cfg.depth, seq);
+            nextPrint = now + chrono::seconds(1);
+        }
+    }
+
+    cout << "Publisher closed the connection\n";
+    ::close(fd);
+    return 0;
+}
+
+//g++ -O2 -std=c++17 \
+    Stock_Market_Matching_Engine/tools/md_listen.cpp \
+    -o md_listen
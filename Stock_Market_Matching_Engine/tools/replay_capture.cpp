@@ -0,0 +1,404 @@
+#include <iostream>
+#include <iomanip>
+#include <string>
+#include <vector>
+#include <random>
+#include <chrono>
+#include <thread>
+#include <cstdlib>
+#include <filesystem>
+#include <unistd.h>
+#include "../engine/MatchingEngine.h"
+#include "../engine/PersistentMatchingEngine.h"
+#include "../storage/CommandCapture.h"
+#include "../core/Log.h"
+#include "../bench/LatencyHistogram.h"
+
+using namespace std;
+
+/* ============== CAPTURE RECORD / REPLAY TOOL ==============
+   record: drive a synthetic flow through an engine with
+           capturing on and write the capture file.
+   replay: feed a capture into a fresh engine (empty data dir),
+           at full speed or at the recorded pace, time every
+           command and check the trades it produces are
+           byte-identical to the ones in the capture.
+   ========================================================== */
+
+struct ReplayConfig {
+    string mode;
+    string capturePath;
+    string outPath;              // replay: where to write the replay's own capture
+    string engine = "matching";  // matching | persistent
+    int threads = 0;             // matching engine shards
+    bool paced = false;
+
+    // record only
+    int orders = 20000;
+    int users = 32;
+    int symbols = 4;
+    double cancelRatio = 0.25;
+    unsigned seed = 7;
+    int batch = 1;               // > 1: orders go in through placeOrders
+};
+
+static void usage() {
+    cout << "\nUsage:\n";
+    cout << "  ./replay_capture record <file> [--engine matching|persistent] [--threads N]\n";
+    cout << "                   [--orders N] [--users N] [--symbols N] [--cancel-ratio R] [--seed S]\n";
+    cout << "                   [--batch N]\n";
+    cout << "  ./replay_capture replay <file> [--engine matching|persistent] [--threads N]\n";
+    cout << "                   [--paced] [--out replay.cap]\n";
+}
+
+static bool parseArgs(int argc, char* argv[], ReplayConfig& cfg) {
+    if (argc < 3) { usage(); return false; }
+    cfg.mode = argv[1];
+    cfg.capturePath = argv[2];
+    if (cfg.mode != "record" && cfg.mode != "replay") { usage(); return false; }
+
+    for (int i = 3; i < argc; i++) {
+        string a = argv[i];
+        auto next = [&]() -> const char* {
+            if (i + 1 >= argc) { cout << "Missing value for " << a << "\n"; exit(1); }
+            return argv[++i];
+        };
+
+        if (a == "--engine") cfg.engine = next();
+        else if (a == "--threads") cfg.threads = atoi(next());
+        else if (a == "--paced") cfg.paced = true;
+        else if (a == "--out") cfg.outPath = next();
+        else if (a == "--orders") cfg.orders = atoi(next());
+        else if (a == "--users") cfg.users = atoi(next());
+        else if (a == "--symbols") cfg.symbols = atoi(next());
+        else if (a == "--cancel-ratio") cfg.cancelRatio = atof(next());
+        else if (a == "--seed") cfg.seed = (unsigned)atoi(next());
+        else if (a == "--batch") cfg.batch = atoi(next());
+        else { usage(); return false; }
+    }
+    if (cfg.engine != "matching" && cfg.engine != "persistent") { usage(); return false; }
+    if (cfg.users < 2 || cfg.symbols < 1 || cfg.batch < 1) { usage(); return false; }
+    return true;
+}
+
+// Engines print a line per order; keep that out of the timings
+class NullBuffer : public streambuf {
+protected:
+    int overflow(int c) override { return c; }
+};
+
+class QuietCout {
+private:
+    NullBuffer sink;
+    streambuf* saved;
+public:
+    QuietCout() { saved = cout.rdbuf(&sink); }
+    ~QuietCout() { cout.rdbuf(saved); }
+};
+
+// Engines keep their files under data/ relative to the cwd
+class ScratchDir {
+private:
+    string path;
+public:
+    ScratchDir() {
+        char tmpl[] = "/tmp/smreplay.XXXXXX";
+        char* dir = mkdtemp(tmpl);
+        if (!dir) return;
+        path = dir;
+        filesystem::create_directory(path + "/data");
+        if (chdir(path.c_str()) != 0) path.clear();
+    }
+    ~ScratchDir() {
+        if (!path.empty() && chdir("/") == 0) filesystem::remove_all(path);
+    }
+    bool ok() const { return !path.empty(); }
+    const string& getPath() const { return path; }
+};
+
+/* ================= engine adapters ================= */
+
+static MatchingEngine* makeEngine(MatchingEngine*, int threads) { return new MatchingEngine(threads); }
+static PersistentMatchingEngine* makeEngine(PersistentMatchingEngine*, int) { return new PersistentMatchingEngine(); }
+
+static bool reduce(MatchingEngine& e, int orderID, const string& user, int qty) {
+    return e.reduceOrder(orderID, user, qty);
+}
+static bool reduce(PersistentMatchingEngine&, int, const string&, int) {
+    return false;   // not supported by this engine
+}
+
+static vector<Order*> placeBatch(MatchingEngine& e, const vector<OrderRequest>& reqs) {
+    return e.placeOrders(reqs);
+}
+static vector<Order*> placeBatch(PersistentMatchingEngine& e, const vector<OrderRequest>& reqs) {
+    vector<Order*> placed;   // no batch API: one at a time
+    for (const OrderRequest& r : reqs) placed.push_back(e.placeOrder(r.userID, r.symbol, r.side, r.price, r.quantity));
+    return placed;
+}
+
+static void cancelBatch(MatchingEngine& e, const vector<CancelRequest>& reqs) {
+    e.cancelOrders(reqs);
+}
+static void cancelBatch(PersistentMatchingEngine& e, const vector<CancelRequest>& reqs) {
+    for (const CancelRequest& r : reqs) e.cancelOrder(r.orderID, r.userID);
+}
+
+/* ================= record ================= */
+
+template <typename Engine>
+static int record(const ReplayConfig& cfg, const string& capturePath) {
+    CommandCapture capture(capturePath);
+    if (!capture.isOpen()) return 1;
+
+    mt19937_64 rng(cfg.seed);
+    uniform_real_distribution<double> unit(0.0, 1.0);
+
+    vector<string> symbols, users;
+    for (int i = 0; i < cfg.symbols; i++) symbols.push_back("SYM" + to_string(i));
+    for (int i = 0; i < cfg.users; i++) users.push_back("trader" + to_string(i));
+
+    vector<pair<int, string>> placed;   // (orderID, owner) for cancels
+    size_t rejected = 0;
+
+    {
+        QuietCout quiet;
+        Engine* engine = makeEngine((Engine*)nullptr, cfg.threads);
+        engine->setCapture(&capture);
+
+        for (const string& s : symbols) engine->addStock(s, "admin123");
+        for (const string& u : users) {
+            engine->createUser(u, 1e7);
+            for (const string& s : symbols) engine->depositStock(u, s, 100000);
+        }
+
+        // --batch: orders queue up and go in together; a cancel sends the
+        // queue first so it only ever targets orders the engine has seen
+        vector<OrderRequest> pending;
+        auto sendPending = [&]() {
+            if (pending.empty()) return;
+            vector<Order*> out = placeBatch(*engine, pending);
+            for (size_t k = 0; k < out.size(); k++) {
+                if (!out[k]) { rejected++; continue; }
+                if (!out[k]->isFilled()) placed.push_back({out[k]->orderID, pending[k].userID});
+            }
+            pending.clear();
+        };
+
+        for (int i = 0; i < cfg.orders; i++) {
+            if (cfg.batch > 1 && !pending.empty() && unit(rng) < cfg.cancelRatio) sendPending();
+            if (!placed.empty() && unit(rng) < cfg.cancelRatio) {
+                size_t k = (size_t)(unit(rng) * placed.size()) % placed.size();
+                engine->cancelOrder(placed[k].first, placed[k].second);
+                placed[k] = placed.back();
+                placed.pop_back();
+                continue;
+            }
+
+            const string& user = users[(size_t)(unit(rng) * users.size()) % users.size()];
+            const string& sym = symbols[(size_t)(unit(rng) * symbols.size()) % symbols.size()];
+            bool buy = unit(rng) < 0.5;
+            // Prices straddle 100.00 so a good share of orders cross
+            double price = 100.0 + (int)((unit(rng) - (buy ? 0.45 : 0.55)) * 40) * 0.01;
+            int qty = 1 + (int)(unit(rng) * 100);
+
+            if (cfg.batch > 1) {
+                pending.push_back(OrderRequest{user, sym, buy ? "BUY" : "SELL", price, qty});
+                if ((int)pending.size() >= cfg.batch) sendPending();
+                continue;
+            }
+
+            Order* o = engine->placeOrder(user, sym, buy ? "BUY" : "SELL", price, qty);
+            if (!o) { rejected++; continue; }
+            if (!o->isFilled()) placed.push_back({o->orderID, user});
+        }
+        sendPending();
+
+        engine->setCapture(nullptr);
+        delete engine;
+    }
+
+    capture.flush();
+    cout << "Recorded " << capture.getRecordCount() << " records (" << rejected
+         << " rejected orders) to " << capturePath << "\n";
+    return 0;
+}
+
+/* ================= replay ================= */
+
+struct ReplayStats {
+    LatencyHistogram place, cancel, other;
+    uint64_t commands = 0;
+    double seconds = 0;
+};
+
+template <typename Engine>
+static bool replay(const ReplayConfig& cfg, const vector<CaptureEvent>& events,
+                   const string& outPath, ReplayStats& stats) {
+    CommandCapture capture(outPath);
+    if (!capture.isOpen()) return false;
+
+    QuietCout quiet;
+    Engine* engine = makeEngine((Engine*)nullptr, cfg.threads);
+    engine->setCapture(&capture);
+
+    auto t0 = chrono::steady_clock::now();
+    for (size_t e = 0; e < events.size(); e++) {
+        const CaptureEvent& ev = events[e];
+        if (ev.type == CaptureType::TRADE) continue;
+
+        if (cfg.paced) this_thread::sleep_until(t0 + chrono::nanoseconds(ev.timestampNs));
+
+        // A batch goes back in as one call; each of its commands is
+        // charged an equal share of the call's time
+        if (ev.type == CaptureType::BATCH) {
+            vector<OrderRequest> places;
+            vector<CancelRequest> cancels;
+            size_t count = 0;
+            for (; count < (size_t)max(ev.quantity, 0) && e + 1 < events.size(); count++) {
+                const CaptureEvent& c = events[++e];
+                if (c.type == CaptureType::PLACE_ORDER) {
+                    places.push_back(OrderRequest{c.userID, c.symbol, c.side, c.amount, c.quantity});
+                } else if (c.type == CaptureType::CANCEL_ORDER) {
+                    cancels.push_back(CancelRequest{c.orderID, c.userID});
+                }
+            }
+
+            auto s = chrono::steady_clock::now();
+            if (ev.batchOf == CaptureType::PLACE_ORDER) placeBatch(*engine, places);
+            else cancelBatch(*engine, cancels);
+            uint64_t ns = chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now() - s).count();
+
+            LatencyHistogram& h = ev.batchOf == CaptureType::PLACE_ORDER ? stats.place : stats.cancel;
+            for (size_t k = 0; k < count; k++) h.record(ns / max<size_t>(count, 1));
+            stats.commands += count;
+            continue;
+        }
+
+        auto s = chrono::steady_clock::now();
+        switch (ev.type) {
+        case CaptureType::CREATE_USER:   engine->createUser(ev.userID, ev.amount); break;
+        case CaptureType::ADD_STOCK:     engine->addStock(ev.symbol, ev.userID, ev.amount); break;
+        case CaptureType::DEPOSIT_STOCK: engine->depositStock(ev.userID, ev.symbol, ev.quantity); break;
+        case CaptureType::PLACE_ORDER:   engine->placeOrder(ev.userID, ev.symbol, ev.side, ev.amount, ev.quantity); break;
+        case CaptureType::CANCEL_ORDER:  engine->cancelOrder(ev.orderID, ev.userID); break;
+        case CaptureType::REDUCE_ORDER:  reduce(*engine, ev.orderID, ev.userID, ev.quantity); break;
+        default: break;
+        }
+        uint64_t ns = chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now() - s).count();
+
+        if (ev.type == CaptureType::PLACE_ORDER) stats.place.record(ns);
+        else if (ev.type == CaptureType::CANCEL_ORDER) stats.cancel.record(ns);
+        else stats.other.record(ns);
+        stats.commands++;
+    }
+    stats.seconds = chrono::duration<double>(chrono::steady_clock::now() - t0).count();
+
+    engine->setCapture(nullptr);
+    delete engine;
+    capture.flush();
+    return true;
+}
+
+static vector<const CaptureEvent*> tradesOf(const vector<CaptureEvent>& events) {
+    vector<const CaptureEvent*> trades;
+    for (const CaptureEvent& ev : events) {
+        if (ev.type == CaptureType::TRADE) trades.push_back(&ev);
+    }
+    return trades;
+}
+
+// Returns true if both trade streams are byte-identical
+static bool compareTrades(const vector<CaptureEvent>& expected, const vector<CaptureEvent>& actual) {
+    vector<const CaptureEvent*> a = tradesOf(expected);
+    vector<const CaptureEvent*> b = tradesOf(actual);
+
+    size_t n = min(a.size(), b.size());
+    for (size_t i = 0; i < n; i++) {
+        if (a[i]->payload != b[i]->payload) {
+            cout << "  MISMATCH at trade #" << i << "\n";
+            cout << "    captured: " << a[i]->trade.toString() << "\n";
+            cout << "    replayed: " << b[i]->trade.toString() << "\n";
+            return false;
+        }
+    }
+    if (a.size() != b.size()) {
+        cout << "  MISMATCH: captured " << a.size() << " trades, replay produced " << b.size() << "\n";
+        return false;
+    }
+    cout << "  trades: " << a.size() << " byte-identical\n";
+    return true;
+}
+
+static void printRow(const string& name, const LatencyHistogram& h) {
+    if (h.count() == 0) return;
+    cout << "  " << left << setw(10) << name << right
+         << setw(10) << h.count()
+         << setw(10) << h.percentile(50)
+         << setw(10) << h.percentile(99)
+         << setw(10) << h.percentile(99.9)
+         << setw(12) << h.max()
+         << setw(12) << fixed << setprecision(1) << h.mean() << "\n";
+}
+
+int main(int argc, char* argv[]) {
+    ReplayConfig cfg;
+    if (!parseArgs(argc, argv, cfg)) return 1;
+
+#if LOG_LEVEL <= LOG_LEVEL_DEBUG
+    cerr << "Warning: built with debug logging; build with -O2 -DNDEBUG for real numbers\n";
+#endif
+
+    // Resolve paths before moving into the scratch dir
+    string capturePath = filesystem::absolute(cfg.capturePath).string();
+    string outPath = cfg.outPath.empty() ? string() : filesystem::absolute(cfg.outPath).string();
+
+    if (cfg.mode == "record") {
+        ScratchDir dir;
+        if (!dir.ok()) { cerr << "Could not create scratch dir\n"; return 1; }
+        return cfg.engine == "persistent" ? record<PersistentMatchingEngine>(cfg, capturePath)
+                                          : record<MatchingEngine>(cfg, capturePath);
+    }
+
+    ReplayStats stats;
+    vector<CaptureEvent> events, produced;
+    {
+        ScratchDir dir;
+        if (!dir.ok()) { cerr << "Could not create scratch dir\n"; return 1; }
+
+        // Reading interns the captured trades' names, so the tables are
+        // attached to the scratch data/ first, same as the engine will
+        attachInternTables();
+        events = CaptureReader::readAll(capturePath);
+        if (events.empty()) {
+            cerr << "Nothing to replay in " << capturePath << "\n";
+            return 1;
+        }
+        if (outPath.empty()) outPath = dir.getPath() + "/replay.cap";
+
+        bool ok = cfg.engine == "persistent"
+            ? replay<PersistentMatchingEngine>(cfg, events, outPath, stats)
+            : replay<MatchingEngine>(cfg, events, outPath, stats);
+        if (!ok) return 1;
+        produced = CaptureReader::readAll(outPath);
+    }
+
+    cout << "\nReplay of " << cfg.capturePath << " (" << cfg.engine
+         << (cfg.engine == "matching" ? ", " + to_string(cfg.threads) + " shards" : string())
+         << (cfg.paced ? ", paced" : ", full speed") << ")\n";
+    cout << "  " << left << setw(10) << "command" << right
+         << setw(10) << "count" << setw(10) << "p50 ns" << setw(10) << "p99 ns"
+         << setw(10) << "p99.9 ns" << setw(12) << "max ns" << setw(12) << "mean ns" << "\n";
+    printRow("place", stats.place);
+    printRow("cancel", stats.cancel);
+    printRow("other", stats.other);
+    cout << "  throughput: " << fixed << setprecision(0) << (stats.commands / stats.seconds)
+         << " commands/s over " << setprecision(3) << stats.seconds << " s\n";
+
+    return compareTrades(events, produced) ? 0 : 2;
+}
+
+//g++ -O2 -DNDEBUG -std=c++17 -pthread \
+    Stock_Market_Matching_Engine/tools/replay_capture.cpp \
+    Stock_Market_Matching_Engine/{core,data_structures,engine,storage}/*.cpp \
+    -o replay_capture